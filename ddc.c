@@ -0,0 +1,206 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ddc.h"
+
+#define T   DDC_TAPS_PER_PHASE
+
+/* windowed sinc at the output Nyquist frequency, unity gain at DC, as iq_decimator */
+static void design(float *coef, int factor) {
+    int n = T * factor, k, p, j;
+    double *h = malloc(n * sizeof(double)), fc = 0.5 / factor, x, sum = 0.0;
+
+    for (k = 0; k < n; k++) {
+        x = k - (n - 1) / 2.0;
+        h[k] = x == 0.0 ? 2.0 * fc : sin(2.0 * M_PI * fc * x) / (M_PI * x);
+        h[k] *= 0.42 - 0.5 * cos(2.0 * M_PI * k / (n - 1)) + 0.08 * cos(4.0 * M_PI * k / (n - 1));
+        sum += h[k];
+    }
+    for (p = 0; p < factor; p++) {
+        for (j = 0; j < T; j++)
+            coef[p * T + j] = (float) (h[j * factor + p] / sum);
+    }
+    free(h);
+}
+
+static void set_lanes(struct ddc *d) {
+    int l;
+
+    for (l = 0; l < DDC_LANES; l++) {
+        d->nco_re[l] = (float) cos(d->phase + l * d->dphi);
+        d->nco_im[l] = (float) sin(d->phase + l * d->dphi);
+    }
+    d->step_re = (float) cos(DDC_LANES * d->dphi);
+    d->step_im = (float) sin(DDC_LANES * d->dphi);
+}
+
+int ddc_init(struct ddc *d, uint32_t in_rate, double offset_hz, int factor, int max_pairs) {
+    int hist;
+
+    memset(d, 0, sizeof(*d));
+    if (factor < 1 || max_pairs < 1)
+        return -1;
+    d->in_rate = in_rate;
+    d->factor = factor;
+    d->max_pairs = max_pairs;
+
+    /* (T - 1) * factor samples of history, less than factor left over, then the chunk */
+    hist = factor > 1 ? T * factor : 0;
+    d->stride = T + d->max_pairs / factor;
+    d->xi = calloc(hist + d->max_pairs, sizeof(float));
+    d->xq = calloc(hist + d->max_pairs, sizeof(float));
+    if (!d->xi || !d->xq)
+        goto fail;
+    if (factor > 1) {
+        d->coef = malloc(T * factor * sizeof(float));
+        d->pi = malloc((size_t) factor * d->stride * sizeof(float));
+        d->pq = malloc((size_t) factor * d->stride * sizeof(float));
+        d->yi = malloc((d->max_pairs / factor + 1) * sizeof(float));
+        d->yq = malloc((d->max_pairs / factor + 1) * sizeof(float));
+        if (!d->coef || !d->pi || !d->pq || !d->yi || !d->yq)
+            goto fail;
+        design(d->coef, factor);
+    }
+
+    ddc_retune(d, offset_hz);
+    return 0;
+
+fail:
+    ddc_free(d);
+    return -1;
+}
+
+void ddc_retune(struct ddc *d, double offset_hz) {
+    /* the channel at +offset comes down to 0 Hz */
+    d->dphi = -2.0 * M_PI * offset_hz / d->in_rate;
+    set_lanes(d);
+}
+
+/* x = iq * nco, DDC_LANES samples per step of the phasors */
+static void mix(struct ddc *d, const short *iq, int pairs, float *xi, float *xq) {
+    float *re = d->nco_re, *im = d->nco_im, a, b, t;
+    int k = 0, l;
+
+    for (; k + DDC_LANES <= pairs; k += DDC_LANES) {
+        for (l = 0; l < DDC_LANES; l++) {
+            a = iq[2 * (k + l)];
+            b = iq[2 * (k + l) + 1];
+            xi[k + l] = a * re[l] - b * im[l];
+            xq[k + l] = a * im[l] + b * re[l];
+        }
+        for (l = 0; l < DDC_LANES; l++) {
+            t = re[l] * d->step_re - im[l] * d->step_im;
+            im[l] = re[l] * d->step_im + im[l] * d->step_re;
+            re[l] = t;
+        }
+    }
+    for (l = 0; k < pairs; k++, l++) {
+        a = iq[2 * k];
+        b = iq[2 * k + 1];
+        xi[k] = a * re[l] - b * im[l];
+        xq[k] = a * im[l] + b * re[l];
+    }
+
+    /* the float recurrence drifts, restart it from the exact phase every chunk */
+    d->phase = fmod(d->phase + pairs * d->dphi, 2.0 * M_PI);
+    set_lanes(d);
+}
+
+static void to_bytes(const float *i, const float *q, int n, uint8_t *out) {
+    float a, b;
+    int k;
+
+    for (k = 0; k < n; k++) {
+        a = i[k] > 32767.0f ? 32767.0f : i[k] < -32768.0f ? -32768.0f : i[k];
+        b = q[k] > 32767.0f ? 32767.0f : q[k] < -32768.0f ? -32768.0f : q[k];
+        out[2 * k] = (unsigned char) ((short) a >> 8);
+        out[2 * k + 1] = (unsigned char) ((short) b >> 8);
+    }
+}
+
+int ddc_run_float(struct ddc *d, const short *iq, int pairs, const float **i, const float **q) {
+    int factor = d->factor, hist = (T - 1) * factor, total = d->fill + pairs, m = total / factor, p, j, k, n;
+    const float *si, *sq;
+    float c, *pi, *pq;
+
+    if (factor == 1) {
+        mix(d, iq, pairs, d->xi, d->xq);
+        *i = d->xi;
+        *q = d->xq;
+        return pairs;
+    }
+
+    mix(d, iq, pairs, d->xi + hist + d->fill, d->xq + hist + d->fill);
+
+    /* phase p holds x[j * factor + p], so output k is sum_p sum_j coef[p][j] * phase_p[k + j] */
+    n = T - 1 + m;
+    for (p = 0; p < factor; p++) {
+        pi = d->pi + p * d->stride;
+        pq = d->pq + p * d->stride;
+        for (j = 0; j < n; j++) {
+            pi[j] = d->xi[j * factor + p];
+            pq[j] = d->xq[j * factor + p];
+        }
+    }
+
+    memset(d->yi, 0, m * sizeof(float));
+    memset(d->yq, 0, m * sizeof(float));
+    for (p = 0; p < factor; p++) {
+        for (j = 0; j < T; j++) {
+            c = d->coef[p * T + j];
+            si = d->pi + p * d->stride + j;
+            sq = d->pq + p * d->stride + j;
+            for (k = 0; k < m; k++) {
+                d->yi[k] += c * si[k];
+                d->yq[k] += c * sq[k];
+            }
+        }
+    }
+
+    /* the history of the next outputs and the samples short of one */
+    d->fill = total - m * factor;
+    memmove(d->xi, d->xi + m * factor, (hist + d->fill) * sizeof(float));
+    memmove(d->xq, d->xq + m * factor, (hist + d->fill) * sizeof(float));
+
+    *i = d->yi;
+    *q = d->yq;
+    return m;
+}
+
+int ddc_run(struct ddc *d, const short *iq, int pairs, uint8_t *out) {
+    const float *i, *q;
+    int m = ddc_run_float(d, iq, pairs, &i, &q);
+
+    to_bytes(i, q, m, out);
+    return m;
+}
+
+void ddc_free(struct ddc *d) {
+    free(d->coef);
+    free(d->xi);
+    free(d->xq);
+    free(d->pi);
+    free(d->pq);
+    free(d->yi);
+    free(d->yq);
+    memset(d, 0, sizeof(*d));
+}
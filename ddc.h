@@ -0,0 +1,73 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  ddc: digital downconverter, one narrow channel out of a wideband
+ *  capture (the virtual receivers of play_tcp -V, the channels of play_fm).
+ *
+ *  The input is mixed down by a numerically controlled oscillator and
+ *  decimated by a polyphase windowed sinc low pass. Both are written as
+ *  plain loops over float arrays that the compiler vectorises: the NCO
+ *  keeps DDC_LANES phasors one sample apart and turns them all by the same
+ *  step, and the filter runs one multiply-add pass over all outputs of a
+ *  chunk per coefficient. A channel costs about DDC_TAPS_PER_PHASE + 2
+ *  multiply-adds per input pair whatever the decimation.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DDC_H
+#define DDC_H
+
+#include <stdint.h>
+
+#define DDC_TAPS_PER_PHASE  8       /* filter length is this times the decimation */
+#define DDC_LANES           8       /* NCO phasors advanced together */
+
+struct ddc {
+    double in_rate;
+    int factor;                 /* decimation */
+    int max_pairs;              /* input pairs per ddc_run */
+    int fill;                   /* mixed pairs waiting for the rest of an output */
+    int stride;                 /* length of one polyphase input array */
+
+    float *coef;                /* coef[p * DDC_TAPS_PER_PHASE + j] = h[j * factor + p] */
+    float *xi, *xq;             /* mixed input, the filter history in front */
+    float *pi, *pq;             /* the same split into factor phases */
+    float *yi, *yq;
+
+    double phase, dphi;         /* exact NCO phase, the lanes are set from it per chunk */
+    float nco_re[DDC_LANES], nco_im[DDC_LANES];
+    float step_re, step_im;
+};
+
+/* factor 1 only shifts. Returns 0 on success. */
+int ddc_init(struct ddc *d, uint32_t in_rate, double offset_hz, int factor, int max_pairs);
+
+/* moves the channel to offset_hz from the centre of the input, keeps the filter state */
+void ddc_retune(struct ddc *d, double offset_hz);
+
+/*
+ * pairs (at most max_pairs) interleaved 16 bit I/Q pairs in, the output
+ * as 8 bit I/Q pairs like the rest of the stream; a remainder short of
+ * one output is kept for the next call. Returns the number of output pairs.
+ */
+int ddc_run(struct ddc *d, const short *iq, int pairs, uint8_t *out);
+
+/* the same with the output left in float, *i and *q valid until the next call */
+int ddc_run_float(struct ddc *d, const short *iq, int pairs, const float **i, const float **q);
+
+void ddc_free(struct ddc *d);
+
+#endif
@@ -0,0 +1,181 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "demod.h"
+
+#define FM_SCALE    (32767.0f / 3.14159265f)   /* +-pi rad per sample is full scale */
+#define AM_DC_ALPHA 0.05f                      /* per block */
+
+int demod_parse_disc(const char *name) {
+    if (strcmp(name, "fast") == 0)
+        return DISC_FAST;
+    if (strcmp(name, "std") == 0)
+        return DISC_STD;
+    if (strcmp(name, "polar") == 0)
+        return DISC_POLAR;
+    return -1;
+}
+
+int demod_init(struct demod *d, enum demod_mode mode, enum demod_disc disc, uint32_t channel_rate,
+               uint32_t audio_rate, double deemph_us, int max_in) {
+    memset(d, 0, sizeof(*d));
+    if (audio_rate == 0 || audio_rate > channel_rate || max_in < 1)
+        return -1;
+    d->mode = mode;
+    d->disc = disc;
+    d->max_in = max_in;
+    d->ratio = (double) channel_rate / audio_rate;
+    if (deemph_us > 0)
+        d->deemph_a = (float) (1.0 - exp(-1.0 / (channel_rate * deemph_us * 1e-6)));
+
+    d->xi = calloc(max_in + 1, sizeof(float));
+    d->xq = calloc(max_in + 1, sizeof(float));
+    d->re = malloc(max_in * sizeof(float));
+    d->im = malloc(max_in * sizeof(float));
+    d->audio = malloc(max_in * sizeof(float));
+    if (!d->xi || !d->xq || !d->re || !d->im || !d->audio) {
+        demod_free(d);
+        return -1;
+    }
+
+    return 0;
+}
+
+void demod_reset(struct demod *d) {
+    d->xi[0] = d->xq[0] = 0.0f;
+    d->deemph_y = 0.0f;
+    d->dc = 0.0f;
+}
+
+int demod_max_out(const struct demod *d, int n) {
+    return (int) (n / d->ratio) + 2;
+}
+
+/* |error| below 2e-6 rad, written with selects only so that the loop vectorises */
+static inline float fast_atan2(float y, float x) {
+    float ax = fabsf(x), ay = fabsf(y);
+    float mn = ax < ay ? ax : ay, mx = ax < ay ? ay : ax;
+    float a = mn / (mx + 1e-30f), s = a * a;
+    float r = ((((-0.0117212f * s + 0.05265332f) * s - 0.11643287f) * s + 0.19354346f) * s - 0.33262347f) * s * a
+              + 0.99997726f * a;
+
+    r = ay > ax ? 1.57079637f - r : r;
+    r = x < 0.0f ? 3.14159274f - r : r;
+    return y < 0.0f ? -r : r;
+}
+
+/* angle between neighbouring samples, in audio units */
+static void discriminate(struct demod *d, int n) {
+    const float *xi = d->xi, *xq = d->xq;
+    float *re = d->re, *im = d->im, *out = d->audio;
+    int k;
+
+    /* x[k] * conj(x[k - 1]), x[-1] is the last sample of the previous block */
+    for (k = 0; k < n; k++) {
+        re[k] = xi[k + 1] * xi[k] + xq[k + 1] * xq[k];
+        im[k] = xq[k + 1] * xi[k] - xi[k + 1] * xq[k];
+    }
+
+    switch (d->disc) {
+        case DISC_FAST:
+            for (k = 0; k < n; k++)
+                out[k] = fast_atan2(im[k], re[k]) * FM_SCALE;
+            break;
+        case DISC_STD:
+            for (k = 0; k < n; k++)
+                out[k] = atan2f(im[k], re[k]) * FM_SCALE;
+            break;
+        case DISC_POLAR:
+            /* im / |x[k]|^2 is sin of the angle times |x[k - 1]| / |x[k]|, ~1 */
+            for (k = 0; k < n; k++)
+                out[k] = im[k] / (xi[k + 1] * xi[k + 1] + xq[k + 1] * xq[k + 1] + 1e-30f) * FM_SCALE;
+            break;
+    }
+}
+
+static void envelope(struct demod *d, int n) {
+    const float *xi = d->xi + 1, *xq = d->xq + 1;
+    float *out = d->audio, sum = 0.0f;
+    int k;
+
+    for (k = 0; k < n; k++) {
+        out[k] = sqrtf(xi[k] * xi[k] + xq[k] * xq[k]);
+        sum += out[k];
+    }
+
+    /* the carrier is the slowly moving mean */
+    d->dc += AM_DC_ALPHA * (sum / n - d->dc);
+    for (k = 0; k < n; k++)
+        out[k] -= d->dc;
+}
+
+int demod_run(struct demod *d, const float *i, const float *q, int n, short *audio) {
+    float *x = d->audio, y, v;
+    int k, m = 0;
+
+    if (n <= 0)
+        return 0;
+
+    memcpy(d->xi + 1, i, n * sizeof(float));
+    memcpy(d->xq + 1, q, n * sizeof(float));
+
+    if (d->mode == DEMOD_AM)
+        envelope(d, n);
+    else
+        discriminate(d, n);
+    d->xi[0] = d->xi[n];
+    d->xq[0] = d->xq[n];
+
+    if (d->deemph_a > 0.0f) {
+        y = d->deemph_y;
+        for (k = 0; k < n; k++) {
+            y += d->deemph_a * (x[k] - y);
+            x[k] = y;
+        }
+        d->deemph_y = y;
+    }
+
+    /* average every ratio channel samples into one audio sample, as rtl_fm's low_pass_real */
+    for (k = 0; k < n; k++) {
+        d->acc += x[k];
+        d->count++;
+        d->pos += 1.0;
+        if (d->pos >= d->ratio) {
+            d->pos -= d->ratio;
+            v = d->acc / d->count;
+            audio[m++] = (short) (v > 32767.0f ? 32767.0f : v < -32768.0f ? -32768.0f : v);
+            d->acc = 0.0f;
+            d->count = 0;
+        }
+    }
+
+    return m;
+}
+
+void demod_free(struct demod *d) {
+    free(d->xi);
+    free(d->xq);
+    free(d->re);
+    free(d->im);
+    free(d->audio);
+    memset(d, 0, sizeof(*d));
+}
@@ -0,0 +1,81 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  demod: FM and AM demodulation of one channel (the output of a ddc)
+ *  down to 16 bit audio, as rtl_fm.
+ *
+ *  The discriminator works on whole blocks: the conjugate products of
+ *  neighbouring samples and their angle are computed in plain loops the
+ *  compiler vectorises, with a branch free polynomial arctangent (within
+ *  2e-6 rad) by default. De-emphasis is a one pole low pass, the audio
+ *  rate is reached by averaging over the fractional number of channel
+ *  samples per audio sample.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DEMOD_H
+#define DEMOD_H
+
+#include <stdint.h>
+
+enum demod_mode {
+    DEMOD_FM,
+    DEMOD_WBFM,
+    DEMOD_AM
+};
+
+enum demod_disc {
+    DISC_FAST,          /* polynomial atan2 of the conjugate product */
+    DISC_STD,           /* atan2f */
+    DISC_POLAR          /* (i dq - q di) / (i^2 + q^2), no arctangent, for well oversampled channels */
+};
+
+struct demod {
+    enum demod_mode mode;
+    enum demod_disc disc;
+    int max_in;
+
+    float *xi, *xq;             /* the previous sample, then the block */
+    float *re, *im;
+    float *audio;               /* at the channel rate */
+
+    float deemph_a, deemph_y;   /* one pole low pass, a = 0: off */
+    float dc;                   /* AM: carrier level, removed */
+
+    double ratio, pos;          /* channel samples per audio sample, position in the current one */
+    float acc;
+    int count;
+};
+
+/* deemph_us 0 for none. Returns 0 on success. */
+int demod_init(struct demod *d, enum demod_mode mode, enum demod_disc disc, uint32_t channel_rate,
+               uint32_t audio_rate, double deemph_us, int max_in);
+
+/* forgets the previous sample and filter states, e.g. after a retune */
+void demod_reset(struct demod *d);
+
+/* n (at most max_in) channel samples in, audio out. Returns the number of audio samples. */
+int demod_run(struct demod *d, const float *i, const float *q, int n, short *audio);
+
+/* audio samples demod_run gives at most for n channel samples */
+int demod_max_out(const struct demod *d, int n);
+
+void demod_free(struct demod *d);
+
+/* "fast", "std" or "polar", -1 when unknown */
+int demod_parse_disc(const char *name);
+
+#endif
@@ -0,0 +1,328 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dsppool.h"
+#include "trace.h"
+
+enum {
+    BLOCK_FREE,
+    BLOCK_FILLING,
+    BLOCK_QUEUED,
+    BLOCK_DONE
+};
+
+static void deque_push(struct dsp_deque *d, int capacity, int item) {
+    pthread_mutex_lock(&d->lock);
+    d->items[(d->head + d->count) % capacity] = item;
+    d->count++;
+    pthread_mutex_unlock(&d->lock);
+}
+
+/* the owner takes the oldest block, a thief the newest, so they rarely meet */
+static int deque_pop(struct dsp_deque *d, int capacity, int steal) {
+    int item = -1;
+
+    pthread_mutex_lock(&d->lock);
+    if (d->count) {
+        if (steal) {
+            item = d->items[(d->head + d->count - 1) % capacity];
+        } else {
+            item = d->items[d->head];
+            d->head = (d->head + 1) % capacity;
+        }
+        d->count--;
+    }
+    pthread_mutex_unlock(&d->lock);
+
+    return item;
+}
+
+static void process(struct dsp_worker *w, struct dsp_block *b) {
+    struct dsp_pool *pool = w->pool;
+    int head = b->skip * pool->decimation;
+
+    pipeline_restart(&w->pipe, b->seq * (uint64_t) pool->block_samples - head);
+    b->out_pairs = pipeline_run(&w->pipe, b->ibuf, b->qbuf, b->n, b->out) - b->skip;
+}
+
+static void *worker(void *arg) {
+    struct dsp_worker *w = arg;
+    struct dsp_pool *pool = w->pool;
+    int k, item;
+    uint64_t t;
+#ifdef __linux__
+    char name[16];
+
+    snprintf(name, sizeof(name), "dsp%d", w->index);
+    pthread_setname_np(pthread_self(), name);
+#endif
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        while (!pool->queued && !pool->stop)
+            pthread_cond_wait(&pool->work, &pool->lock);
+        if (!pool->queued) {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        /* there is a block in some deque for this worker now */
+        pool->queued--;
+        pthread_mutex_unlock(&pool->lock);
+
+        item = deque_pop(&w->deque, pool->nblocks, 0);
+        for (k = 1; item < 0; k++) {
+            item = deque_pop(&pool->workers[(w->index + k) % pool->threads].deque, pool->nblocks, 1);
+            if (item >= 0) {
+                w->stolen++;
+                trace_instant("stolen block", (int64_t) pool->blocks[item].seq);
+            }
+        }
+
+        t = trace_begin();
+        process(w, &pool->blocks[item]);
+        trace_end("dsp block", t, (int64_t) pool->blocks[item].seq);
+        w->blocks++;
+
+        pthread_mutex_lock(&pool->lock);
+        pool->blocks[item].state = BLOCK_DONE;
+        pthread_cond_broadcast(&pool->done);
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    return NULL;
+}
+
+int dsp_pool_open(struct dsp_pool *pool, const char *spec, uint32_t in_rate, int bits, int threads) {
+    int k, n, started = 0;
+
+    memset(pool, 0, sizeof(*pool));
+    pool->threads = threads;
+    pool->bits = bits;
+    pool->pair_bytes = bits == 8 ? 2 : 4;
+    pool->nblocks = threads * DSPPOOL_DEPTH;
+    pool->workers = calloc(threads, sizeof(struct dsp_worker));
+    pool->blocks = calloc(pool->nblocks, sizeof(struct dsp_block));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    for (k = 0; k < threads; k++) {
+        struct dsp_worker *w = &pool->workers[k];
+
+        w->pool = pool;
+        w->index = k;
+        if (pipeline_parse(&w->pipe, spec, in_rate, bits) != 0)
+            goto fail;
+        if (k == 0) {
+            pool->decimation = w->pipe.decimation;
+            pool->overlap = pipeline_overlap(&w->pipe);
+            pool->block_samples = DSPPOOL_BLOCK / pool->decimation * pool->decimation;
+            /* the next block's overlap comes out of this one */
+            if (pool->block_samples < pool->overlap)
+                pool->block_samples = pool->overlap;
+        }
+        if (pipeline_prepare(&w->pipe, pool->block_samples + pool->overlap) != 0)
+            goto fail;
+        w->deque.items = calloc(pool->nblocks, sizeof(int));
+        pthread_mutex_init(&w->deque.lock, NULL);
+    }
+
+    n = pool->block_samples + pool->overlap;
+    for (k = 0; k < pool->nblocks; k++) {
+        pool->blocks[k].ibuf = malloc(n * sizeof(short));
+        pool->blocks[k].qbuf = malloc(n * sizeof(short));
+        pool->blocks[k].out = malloc((n / pool->decimation + 1) * pool->pair_bytes);
+        if (!pool->blocks[k].ibuf || !pool->blocks[k].qbuf || !pool->blocks[k].out)
+            goto fail;
+    }
+
+    for (k = 0; k < threads; k++) {
+        if (pthread_create(&pool->workers[k].thread, NULL, worker, &pool->workers[k]) != 0) {
+            fprintf(stderr, "Failed to start DSP worker %d\n", k);
+            goto fail;
+        }
+        started++;
+    }
+
+    return 0;
+
+fail:
+    pool->threads = started;
+    dsp_pool_close(pool, NULL, NULL);
+    return -1;
+}
+
+/* hands out every finished block at the front, in order */
+static int emit_done(struct dsp_pool *pool, dsp_emit_fn emit, void *ctx) {
+    struct dsp_block *b;
+    int r = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        b = &pool->blocks[pool->emitted % pool->nblocks];
+        if (pool->emitted == pool->submitted || b->state != BLOCK_DONE)
+            break;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (emit && b->out_pairs > 0 && r == 0)
+            r = emit(ctx, (char *) b->out + b->skip * pool->pair_bytes, (size_t) b->out_pairs * pool->pair_bytes);
+
+        pthread_mutex_lock(&pool->lock);
+        b->state = BLOCK_FREE;
+        pool->emitted++;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return r;
+}
+
+/* waits until the oldest block in flight is done */
+static void wait_oldest(struct dsp_pool *pool) {
+    struct dsp_block *b = &pool->blocks[pool->emitted % pool->nblocks];
+    uint64_t t = trace_begin();
+
+    pthread_mutex_lock(&pool->lock);
+    while (b->state != BLOCK_DONE)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+    trace_end("dsp wait", t, (int64_t) b->seq);
+}
+
+/* takes the next block and copies the end of the previous input in front */
+static int start_block(struct dsp_pool *pool, dsp_emit_fn emit, void *ctx) {
+    struct dsp_block *b = &pool->blocks[pool->submitted % pool->nblocks], *prev;
+    int head = 0, r = 0;
+
+    while (b->state != BLOCK_FREE) {
+        wait_oldest(pool);
+        r |= emit_done(pool, emit, ctx);
+    }
+
+    if (pool->submitted > 0) {
+        prev = &pool->blocks[(pool->submitted + pool->nblocks - 1) % pool->nblocks];
+        head = pool->overlap;
+        /* prev is queued or later but nobody writes its input any more */
+        memcpy(b->ibuf, prev->ibuf + prev->n - head, head * sizeof(short));
+        memcpy(b->qbuf, prev->qbuf + prev->n - head, head * sizeof(short));
+    }
+    b->seq = pool->submitted;
+    b->n = head;
+    b->skip = head / pool->decimation;
+    b->state = BLOCK_FILLING;
+    pool->fill = 0;
+
+    return r;
+}
+
+static void submit_block(struct dsp_pool *pool) {
+    int item = (int) (pool->submitted % pool->nblocks);
+
+    pool->blocks[item].state = BLOCK_QUEUED;
+    deque_push(&pool->workers[pool->next_worker].deque, pool->nblocks, item);
+    pool->next_worker = (pool->next_worker + 1) % pool->threads;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->submitted++;
+    pool->queued++;
+    pthread_cond_signal(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+int dsp_pool_feed(struct dsp_pool *pool, const short *ibuf, const short *qbuf, int n, dsp_emit_fn emit, void *ctx) {
+    struct dsp_block *b;
+    int len, r = 0;
+
+    while (n > 0) {
+        b = &pool->blocks[pool->submitted % pool->nblocks];
+        if (b->state != BLOCK_FILLING)
+            r |= start_block(pool, emit, ctx);
+
+        len = pool->block_samples - pool->fill;
+        if (len > n)
+            len = n;
+        memcpy(b->ibuf + b->n, ibuf, len * sizeof(short));
+        memcpy(b->qbuf + b->n, qbuf, len * sizeof(short));
+        b->n += len;
+        pool->fill += len;
+        ibuf += len;
+        qbuf += len;
+        n -= len;
+
+        if (pool->fill == pool->block_samples)
+            submit_block(pool);
+    }
+
+    return r | emit_done(pool, emit, ctx);
+}
+
+int dsp_pool_close(struct dsp_pool *pool, dsp_emit_fn emit, void *ctx) {
+    struct dsp_block *b;
+    int k, r = 0;
+
+    if (pool->blocks && pool->workers && pool->threads) {
+        b = &pool->blocks[pool->submitted % pool->nblocks];
+        if (b->state == BLOCK_FILLING) {
+            /* a partial block, down to whole output samples */
+            b->n -= pool->fill % pool->decimation;
+            if (pool->fill >= pool->decimation)
+                submit_block(pool);
+            else
+                b->state = BLOCK_FREE;
+        }
+        while (pool->emitted < pool->submitted) {
+            wait_oldest(pool);
+            r |= emit_done(pool, emit, ctx);
+        }
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+    for (k = 0; k < pool->threads; k++)
+        pthread_join(pool->workers[k].thread, NULL);
+
+    if (pool->workers) {
+        for (k = 0; k < pool->nblocks / DSPPOOL_DEPTH; k++) {
+            pool->stolen += pool->workers[k].stolen;
+            pipeline_free(&pool->workers[k].pipe);
+            free(pool->workers[k].deque.items);
+        }
+    }
+    if (pool->blocks) {
+        for (k = 0; k < pool->nblocks; k++) {
+            free(pool->blocks[k].ibuf);
+            free(pool->blocks[k].qbuf);
+            free(pool->blocks[k].out);
+        }
+    }
+    free(pool->blocks);
+    free(pool->workers);
+    pool->blocks = NULL;
+    pool->workers = NULL;
+
+    return r;
+}
@@ -0,0 +1,108 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  dsppool: runs a processing pipeline (see pipeline.h) on several cores.
+ *  The capture thread copies its packets into fixed size blocks numbered
+ *  in order. Every block also carries the input that precedes it
+ *  (pipeline_overlap), so a worker can restart the pipeline at the block
+ *  start and fill the filters before the first output it keeps: blocks
+ *  are independent and any worker can take any of them.
+ *
+ *  Each worker has its own deque of blocks, filled round robin; a worker
+ *  whose deque runs empty steals from the others, so a slow or preempted
+ *  core does not hold up the rest. Finished blocks are handed back in
+ *  sequence order to the thread that feeds the pool, which writes them.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DSPPOOL_H
+#define DSPPOOL_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pipeline.h"
+
+#define DSPPOOL_BLOCK       16384   /* input samples per block, rounded down to the decimation */
+#define DSPPOOL_DEPTH       4       /* blocks in flight per worker */
+
+/* receives the output of one block, in order. Returns 0 on success. */
+typedef int (*dsp_emit_fn)(void *ctx, const void *data, size_t len);
+
+struct dsp_block {
+    uint64_t seq;
+    int state;
+    int n;                      /* input samples, overlap included */
+    short *ibuf, *qbuf;
+    void *out;
+    int out_pairs;
+    int skip;                   /* leading output pairs produced from the overlap */
+};
+
+struct dsp_deque {
+    int *items;                 /* block indices, oldest at head */
+    int head, count;
+    pthread_mutex_t lock;
+};
+
+struct dsp_worker {
+    struct dsp_pool *pool;
+    int index;
+    struct pipeline pipe;
+    struct dsp_deque deque;
+    uint64_t blocks, stolen;
+    pthread_t thread;
+};
+
+struct dsp_pool {
+    int threads;
+    int bits;
+    int block_samples;
+    int overlap;
+    int decimation;
+    int pair_bytes;
+
+    struct dsp_block *blocks;
+    int nblocks;
+    struct dsp_worker *workers;
+
+    uint64_t submitted;         /* sequence number of the block being filled */
+    uint64_t emitted;           /* next block to hand out */
+    int fill;                   /* samples in the block being filled, after its overlap */
+    int next_worker;
+    int queued;                 /* submitted, not yet taken by a worker */
+    int stop;
+    uint64_t stolen;            /* blocks a worker took from another's deque, set by dsp_pool_close */
+
+    pthread_mutex_t lock;
+    pthread_cond_t work;        /* a block was queued */
+    pthread_cond_t done;        /* a block was processed */
+};
+
+/* spec, in_rate, bits as pipeline_parse. Returns 0 on success. */
+int dsp_pool_open(struct dsp_pool *pool, const char *spec, uint32_t in_rate, int bits, int threads);
+
+/*
+ * Appends n samples. Hands every block finished so far to emit, in order;
+ * waits for the oldest block when all of them are in use.
+ */
+int dsp_pool_feed(struct dsp_pool *pool, const short *ibuf, const short *qbuf, int n, dsp_emit_fn emit, void *ctx);
+
+/* processes what is left (up to a multiple of the decimation), emits it and stops the workers */
+int dsp_pool_close(struct dsp_pool *pool, dsp_emit_fn emit, void *ctx);
+
+#endif
@@ -0,0 +1,185 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "fdout.h"
+
+/* two pipe sizes worth of blocks, at least four */
+static int ring_alloc(struct fd_output *o) {
+    size_t size = 4 * FDOUT_BLOCK_SIZE;
+    uint8_t *ring;
+
+    while (size < 2 * o->pipe_size)
+        size += FDOUT_BLOCK_SIZE;
+
+    ring = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring == MAP_FAILED)
+        return -1;
+
+    /* pages of the old ring still in the pipe keep their own references */
+    if (o->ring)
+        munmap(o->ring, o->ring_size);
+    o->ring = ring;
+    o->ring_size = size;
+    return 0;
+}
+
+/*
+ * At the start of the ring: the reader may have grown the pipe since, and
+ * the blocks about to be reused would still be in it. Grow the ring along,
+ * or give up on vmsplice when that fails.
+ */
+static void follow_pipe(struct fd_output *o) {
+#ifdef F_GETPIPE_SZ
+    int granted = fcntl(o->fd, F_GETPIPE_SZ);
+
+    if (granted <= 0 || 2 * (size_t) granted <= o->ring_size)
+        return;
+    o->pipe_size = (size_t) granted;
+    if (ring_alloc(o) != 0)
+        o->use_vmsplice = 0;
+#endif
+}
+
+int fd_output_open(struct fd_output *o, int fd, size_t pipe_size) {
+    struct stat st;
+    int granted;
+
+    memset(o, 0, sizeof(*o));
+    o->fd = fd;
+
+    if (fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode)) {
+        o->is_pipe = 1;
+        o->use_vmsplice = 1;
+#ifdef F_SETPIPE_SZ
+        if (fcntl(fd, F_SETPIPE_SZ, (int) pipe_size) < 0)
+            fprintf(stderr, "Cannot grow pipe to %zu bytes: %s (see /proc/sys/fs/pipe-max-size)\n",
+                    pipe_size, strerror(errno));
+        granted = fcntl(fd, F_GETPIPE_SZ);
+        o->pipe_size = granted > 0 ? (size_t) granted : 65536;
+#else
+        o->pipe_size = 65536;
+#endif
+    }
+
+    return ring_alloc(o);
+}
+
+static int write_all(int fd, const uint8_t *buf, size_t len) {
+    ssize_t n;
+
+    while (len > 0) {
+        n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+
+    return 0;
+}
+
+static int emit_block(struct fd_output *o, size_t len) {
+    struct iovec iov;
+    ssize_t n;
+
+    iov.iov_base = o->ring + o->head;
+    iov.iov_len = len;
+
+    while (o->use_vmsplice && iov.iov_len > 0) {
+        n = vmsplice(o->fd, &iov, 1, 0);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EPIPE)
+                return -1;
+            /* not supported here, plain writes from now on */
+            o->use_vmsplice = 0;
+            break;
+        }
+        iov.iov_base = (uint8_t *) iov.iov_base + n;
+        iov.iov_len -= n;
+    }
+
+    if (iov.iov_len > 0 && write_all(o->fd, iov.iov_base, iov.iov_len) != 0)
+        return -1;
+
+    o->bytes += len;
+    return 0;
+}
+
+int fd_output_write(struct fd_output *o, const void *buf, size_t len) {
+    const uint8_t *p = buf;
+    size_t chunk;
+
+    while (len > 0) {
+        chunk = FDOUT_BLOCK_SIZE - o->fill;
+        if (chunk > len)
+            chunk = len;
+        memcpy(o->ring + o->head + o->fill, p, chunk);
+        o->fill += chunk;
+        p += chunk;
+        len -= chunk;
+
+        if (o->fill == FDOUT_BLOCK_SIZE) {
+            if (emit_block(o, FDOUT_BLOCK_SIZE) != 0)
+                return -1;
+            o->head = (o->head + FDOUT_BLOCK_SIZE) % o->ring_size;
+            o->fill = 0;
+            if (o->head == 0 && o->use_vmsplice)
+                follow_pipe(o);
+        }
+    }
+
+    return 0;
+}
+
+int fd_output_flush(struct fd_output *o) {
+    int r = 0;
+
+    if (o->fill > 0) {
+        r = emit_block(o, o->fill);
+        o->head = (o->head + FDOUT_BLOCK_SIZE) % o->ring_size;
+        o->fill = 0;
+        if (o->head == 0 && o->use_vmsplice)
+            follow_pipe(o);
+    }
+
+    return r;
+}
+
+void fd_output_close(struct fd_output *o) {
+    if (o->ring)
+        munmap(o->ring, o->ring_size);
+    o->ring = NULL;
+}
@@ -0,0 +1,62 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  fdout: stdio-free output of sample blocks to a file descriptor.
+ *
+ *  Data is collected in page aligned blocks of a ring. When the descriptor
+ *  is a pipe, the pipe is enlarged with F_SETPIPE_SZ and full blocks are
+ *  handed to it with vmsplice(), so the kernel references the pages rather
+ *  than copying them. They are not gifted, the ring reuses them: it holds
+ *  twice the pipe size, so once a block is a full pipe size behind the
+ *  newest one the reader has consumed it. The pipe size is read again at
+ *  every wrap and the ring grows when the reader enlarged the pipe.
+ *  Anything else gets large plain write()s.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FDOUT_H
+#define FDOUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FDOUT_DEFAULT_PIPE_SIZE (1024 * 1024)
+#define FDOUT_BLOCK_SIZE        (64 * 1024)
+
+struct fd_output {
+    int fd;
+    int is_pipe;
+    int use_vmsplice;
+    size_t pipe_size;       /* as granted by the kernel */
+    uint8_t *ring;
+    size_t ring_size;
+    size_t head;            /* start of the block being filled */
+    size_t fill;
+    uint64_t bytes;
+};
+
+/* pipe_size: requested pipe buffer, only used when fd is a pipe. Returns 0 on success. */
+int fd_output_open(struct fd_output *o, int fd, size_t pipe_size);
+
+/* returns 0, or -1 when the reader went away / the write failed */
+int fd_output_write(struct fd_output *o, const void *buf, size_t len);
+
+/* writes out the partially filled block */
+int fd_output_flush(struct fd_output *o);
+
+void fd_output_close(struct fd_output *o);
+
+#endif
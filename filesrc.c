@@ -0,0 +1,162 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FILE_OFFSET_BITS
+#define _FILE_OFFSET_BITS 64
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "filesrc.h"
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int file_source_open(struct file_source *fs, const char *path, double speed, uint32_t samp_rate,
+                     uint32_t frequency) {
+    struct stat st;
+    char *indexname;
+
+    memset(fs, 0, sizeof(*fs));
+    fs->speed = speed;
+    fs->samp_rate = samp_rate;
+    fs->frequency = frequency;
+
+    fs->fd = open(path, O_RDONLY);
+    if (fs->fd < 0 || fstat(fs->fd, &st) != 0) {
+        fprintf(stderr, "Failed to open recording %s\n", path);
+        return -1;
+    }
+    fs->size = st.st_size & ~1ULL;
+
+    indexname = malloc(strlen(path) + 6);
+    sprintf(indexname, "%s.tidx", path);
+    if (access(indexname, R_OK) == 0 && tindex_map(&fs->index, indexname) == 0 && fs->index.count > 0) {
+        if (fs->index.hdr->pair_bytes != 2) {
+            fprintf(stderr, "%s is a 16 bit recording, rtl_tcp clients need 8 bit (play_sdr -x 8).\n", path);
+            tindex_unmap(&fs->index);
+            free(indexname);
+            close(fs->fd);
+            return -1;
+        }
+        if (fs->index.hdr->scaled)
+            fprintf(stderr, "%s was recorded with adaptive scaling (play_sdr -q), it is sent as recorded.\n",
+                    path);
+        fs->indexed = 1;
+        fs->samp_rate = fs->index.hdr->samp_rate;
+        fs->frequency = fs->index.entries[0].frequency;
+    }
+    free(indexname);
+
+    posix_fadvise(fs->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    file_source_rewind(fs);
+
+    return 0;
+}
+
+static void seek_to(struct file_source *fs, uint64_t offset) {
+    fs->offset = offset;
+    fs->pace_offset = offset;
+    fs->pace_start_ns = monotonic_ns();
+}
+
+void file_source_rewind(struct file_source *fs) {
+    seek_to(fs, 0);
+    if (fs->indexed)
+        fs->frequency = fs->index.entries[0].frequency;
+}
+
+int file_source_tune(struct file_source *fs, uint32_t frequency) {
+    const struct tindex_entry *e = fs->index.entries;
+    uint64_t i, n = fs->index.count, pos = fs->offset / 2;
+
+    if (!fs->indexed)
+        return -1;
+
+    /* forward from the segment being sent, then from the start */
+    for (i = 0; i < n; i++) {
+        if (e[i].sample >= pos && e[i].frequency == frequency)
+            break;
+    }
+    if (i == n) {
+        for (i = 0; i < n && e[i].frequency != frequency; i++)
+            ;
+    }
+    if (i == n)
+        return -1;
+
+    /* the segment starts where the frequency was first seen */
+    while (i > 0 && e[i - 1].frequency == frequency)
+        i--;
+
+    seek_to(fs, e[i].sample * 2);
+    fs->frequency = frequency;
+
+    return 0;
+}
+
+long file_source_send(struct file_source *fs, int sock) {
+    struct timespec due;
+    uint64_t chunk = fs->size - fs->offset;
+    uint64_t due_ns;
+    off_t off = (off_t) fs->offset;
+    ssize_t n;
+
+    if (chunk == 0)
+        return 0;
+    if (chunk > FILESRC_CHUNK)
+        chunk = FILESRC_CHUNK;
+
+    if (fs->speed > 0) {
+        due_ns = fs->pace_start_ns +
+                 (uint64_t) ((fs->offset - fs->pace_offset) / 2 * 1e9 / (fs->samp_rate * fs->speed));
+        due.tv_sec = due_ns / 1000000000ULL;
+        due.tv_nsec = due_ns % 1000000000ULL;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) == EINTR)
+            ;
+    }
+
+    do {
+        n = sendfile(sock, fs->fd, &off, chunk);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0)
+        return -1;
+
+    fs->offset = off;
+    return n;
+}
+
+void file_source_close(struct file_source *fs) {
+    if (fs->indexed)
+        tindex_unmap(&fs->index);
+    if (fs->fd >= 0)
+        close(fs->fd);
+    fs->fd = -1;
+}
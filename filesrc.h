@@ -0,0 +1,72 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  filesrc: replays an 8 bit play_sdr recording (the byte stream rtl_tcp
+ *  clients receive) to a socket with sendfile(), so the samples go from
+ *  the page cache to the socket without a userspace copy. Paced at the
+ *  original sample rate, a multiple of it, or as fast as the client reads.
+ *  With a time index (<file>.tidx, play_sdr -t) sample rate and frequency
+ *  come from the index and a tune request seeks to a matching segment.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FILESRC_H
+#define FILESRC_H
+
+#include <stdint.h>
+
+#include "tindex.h"
+
+#define FILESRC_CHUNK   (64 * 1024)     /* bytes per sendfile call */
+
+struct file_source {
+    int fd;
+    uint64_t size;
+    uint64_t offset;
+    uint32_t samp_rate;
+    uint32_t frequency;         /* of the segment being sent, 0 if unknown */
+    double speed;               /* 1 real time, 0 as fast as possible */
+
+    struct tindex_map index;
+    int indexed;
+
+    uint64_t pace_start_ns;     /* CLOCK_MONOTONIC at pace_offset */
+    uint64_t pace_offset;
+};
+
+/*
+ * samp_rate / frequency: used when there is no index, replaced by the
+ * indexed values otherwise. Returns 0 on success.
+ */
+int file_source_open(struct file_source *fs, const char *path, double speed, uint32_t samp_rate,
+                     uint32_t frequency);
+
+/* back to the start of the recording, pacing restarts */
+void file_source_rewind(struct file_source *fs);
+
+/*
+ * Seeks to the first indexed segment recorded at frequency, searching
+ * forward from the current position first. Returns 0 when found, -1 when
+ * there is no index or no such segment.
+ */
+int file_source_tune(struct file_source *fs, uint32_t frequency);
+
+/* waits until the next chunk is due and sends it. Returns bytes sent, 0 at the end, -1 on error */
+long file_source_send(struct file_source *fs, int sock);
+
+void file_source_close(struct file_source *fs);
+
+#endif
@@ -0,0 +1,383 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "iqdsp.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#define IQ_FULL_SCALE_POWER (32768.0 * 32768.0)
+
+/*
+ * sum of squares of one plane. The 16x16 products are paired by madd /
+ * vmull into 32 bit lanes (at most 2^31, so exact as unsigned) and
+ * widened into 64 bit accumulators, no overflow for any packet size.
+ */
+static uint64_t sum_squares(const short *x, int n) {
+    uint64_t acc = 0;
+    int i = 0;
+
+#if defined(__SSE2__)
+    __m128i zero = _mm_setzero_si128();
+    __m128i acc64 = _mm_setzero_si128();
+
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (x + i));
+        __m128i sq = _mm_madd_epi16(v, v);
+        acc64 = _mm_add_epi64(acc64, _mm_unpacklo_epi32(sq, zero));
+        acc64 = _mm_add_epi64(acc64, _mm_unpackhi_epi32(sq, zero));
+    }
+    {
+        uint64_t lanes[2];
+        _mm_storeu_si128((__m128i *) lanes, acc64);
+        acc = lanes[0] + lanes[1];
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    int64x2_t acc64 = vdupq_n_s64(0);
+
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t v = vld1q_s16(x + i);
+        acc64 = vpadalq_s32(acc64, vmull_s16(vget_low_s16(v), vget_low_s16(v)));
+        acc64 = vpadalq_s32(acc64, vmull_s16(vget_high_s16(v), vget_high_s16(v)));
+    }
+    acc = (uint64_t) (vgetq_lane_s64(acc64, 0) + vgetq_lane_s64(acc64, 1));
+#endif
+
+    for (; i < n; i++) {
+        acc += (uint64_t) ((int32_t) x[i] * x[i]);
+    }
+
+    return acc;
+}
+
+double iq_block_power(const short *ibuf, const short *qbuf, int n) {
+    if (n <= 0)
+        return 0.0;
+
+    return (double) (sum_squares(ibuf, n) + sum_squares(qbuf, n)) / ((double) n * IQ_FULL_SCALE_POWER);
+}
+
+double iq_power_to_dbfs(double power) {
+    if (power <= 1e-20)
+        return -200.0;
+
+    return 10.0 * log10(power);
+}
+
+double iq_dbfs_to_power(double dbfs) {
+    return pow(10.0, dbfs / 10.0);
+}
+
+int iq_decimator_init(struct iq_decimator *d, int factor, int taps_per_factor) {
+    double fc = 0.5 / factor, sum = 0, x, w;
+    int i, m;
+
+    memset(d, 0, sizeof(*d));
+    d->factor = factor;
+    d->ntaps = taps_per_factor * factor + 1;
+    d->taps = malloc(d->ntaps * sizeof(float));
+    d->hist_i = calloc(2 * d->ntaps, sizeof(float));
+    d->hist_q = calloc(2 * d->ntaps, sizeof(float));
+    if (!d->taps || !d->hist_i || !d->hist_q) {
+        iq_decimator_free(d);
+        return -1;
+    }
+
+    /* Blackman windowed sinc, unity gain at DC */
+    m = d->ntaps - 1;
+    for (i = 0; i <= m; i++) {
+        x = i - m / 2.0;
+        w = 0.42 - 0.5 * cos(2 * M_PI * i / m) + 0.08 * cos(4 * M_PI * i / m);
+        d->taps[i] = (float) (w * (x == 0 ? 2 * fc : sin(2 * M_PI * fc * x) / (M_PI * x)));
+        sum += d->taps[i];
+    }
+    for (i = 0; i <= m; i++)
+        d->taps[i] /= (float) sum;
+
+    return 0;
+}
+
+int iq_decimate(struct iq_decimator *d, const float *in_i, const float *in_q, int n, float *out_i, float *out_q) {
+    int ntaps = d->ntaps;
+    int i, k, out = 0;
+
+    for (i = 0; i < n; i++) {
+        d->hist_i[d->pos] = d->hist_i[d->pos + ntaps] = in_i[i];
+        d->hist_q[d->pos] = d->hist_q[d->pos + ntaps] = in_q[i];
+        if (++d->pos == ntaps)
+            d->pos = 0;
+
+        if (++d->phase == d->factor) {
+            /* the last ntaps samples, oldest first, start at pos */
+            const float *hi = d->hist_i + d->pos;
+            const float *hq = d->hist_q + d->pos;
+            float acc_i = 0, acc_q = 0;
+
+            d->phase = 0;
+            for (k = 0; k < ntaps; k++) {
+                acc_i += d->taps[k] * hi[k];
+                acc_q += d->taps[k] * hq[k];
+            }
+            out_i[out] = acc_i;
+            out_q[out] = acc_q;
+            out++;
+        }
+    }
+
+    return out;
+}
+
+void iq_decimator_free(struct iq_decimator *d) {
+    free(d->taps);
+    free(d->hist_i);
+    free(d->hist_q);
+    d->taps = d->hist_i = d->hist_q = NULL;
+}
+
+void iq_fft(float *re, float *im, int n) {
+    int i, j, k, len;
+    float t;
+
+    for (i = 1, j = 0; i < n; i++) {
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1)
+            j ^= bit;
+        j ^= bit;
+        if (i < j) {
+            t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+
+    for (len = 2; len <= n; len <<= 1) {
+        double ang = -2 * M_PI / len;
+        float wr = (float) cos(ang), wi = (float) sin(ang);
+
+        for (i = 0; i < n; i += len) {
+            float cr = 1, ci = 0;
+            for (k = 0; k < len / 2; k++) {
+                int a = i + k, b = i + k + len / 2;
+                float xr = re[b] * cr - im[b] * ci;
+                float xi = re[b] * ci + im[b] * cr;
+                re[b] = re[a] - xr;
+                im[b] = im[a] - xi;
+                re[a] += xr;
+                im[a] += xi;
+                t = cr * wr - ci * wi;
+                ci = cr * wi + ci * wr;
+                cr = t;
+            }
+        }
+    }
+}
+
+#define IQ_SCALE_HOLD_MS    100
+#define IQ_SCALE_RMS_OVER   4       /* headroom of the rms mode, 12 dB */
+
+/* largest |x| of one plane, -32768 counted as 32767 */
+static int peak_abs(const short *x, int n) {
+    int peak = 0, i = 0, k;
+
+#if defined(__SSE2__)
+    __m128i zero = _mm_setzero_si128();
+    __m128i mx = zero;
+    short lanes[8];
+
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (x + i));
+        mx = _mm_max_epi16(mx, _mm_max_epi16(v, _mm_subs_epi16(zero, v)));
+    }
+    _mm_storeu_si128((__m128i *) lanes, mx);
+    for (k = 0; k < 8; k++)
+        peak = lanes[k] > peak ? lanes[k] : peak;
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    int16x8_t mx = vdupq_n_s16(0);
+    short lanes[8];
+
+    for (; i + 8 <= n; i += 8)
+        mx = vmaxq_s16(mx, vqabsq_s16(vld1q_s16(x + i)));
+    vst1q_s16(lanes, mx);
+    for (k = 0; k < 8; k++)
+        peak = lanes[k] > peak ? lanes[k] : peak;
+#else
+    (void) k;
+#endif
+
+    for (; i < n; i++) {
+        int a = x[i] < 0 ? -x[i] : x[i];
+        peak = a > peak ? a : peak;
+    }
+
+    return peak > 32767 ? 32767 : peak;
+}
+
+/* the least shift that brings level into 7 bits */
+static int shift_for(int level) {
+    int shift = 0;
+
+    while (shift < 8 && (level >> shift) > 127)
+        shift++;
+    return shift;
+}
+
+int iq_scaler_parse(struct iq_scaler *s, const char *arg) {
+    const char *colon = strchr(arg, ':');
+    size_t len = colon ? (size_t) (colon - arg) : strlen(arg);
+
+    memset(s, 0, sizeof(*s));
+    s->shift = 8;
+    s->hold_ms = IQ_SCALE_HOLD_MS;
+    if (len == 4 && strncmp(arg, "peak", 4) == 0)
+        s->mode = IQ_SCALE_PEAK;
+    else if (len == 3 && strncmp(arg, "rms", 3) == 0)
+        s->mode = IQ_SCALE_RMS;
+    else
+        return -1;
+    if (colon) {
+        s->hold_ms = atoi(colon + 1);
+        if (s->hold_ms < 0 || colon[1] < '0' || colon[1] > '9')
+            return -1;
+    }
+    return 0;
+}
+
+void iq_scaler_reset(struct iq_scaler *s, uint32_t samp_rate) {
+    s->hold = (uint64_t) samp_rate * s->hold_ms / 1000;
+    s->blocks = s->changes = s->clipped = 0;
+    s->calm = 0;
+    s->calm_need = 0;
+    s->shift = 8;
+}
+
+int iq_scaler_update(struct iq_scaler *s, const short *ibuf, const short *qbuf, int n) {
+    int pi, pq, peak, need;
+
+    if (n <= 0)
+        return s->shift;
+
+    pi = peak_abs(ibuf, n);
+    pq = peak_abs(qbuf, n);
+    peak = pi > pq ? pi : pq;
+    if (s->mode == IQ_SCALE_PEAK)
+        need = shift_for(peak);
+    else
+        need = shift_for((int) (IQ_SCALE_RMS_OVER * sqrt(iq_block_power(ibuf, qbuf, n) / 2) * 32768.0));
+
+    /* the first block after a reset takes its own shift */
+    if (need > s->shift || s->hold == 0 || s->blocks == 0) {
+        if (need != s->shift)
+            s->changes++;
+        s->shift = need;
+        s->calm = 0;
+        s->calm_need = 0;
+    } else if (need < s->shift) {
+        /* the largest shift the hold time needed, taken once it is over */
+        s->calm += n;
+        s->calm_need = need > s->calm_need ? need : s->calm_need;
+        if (s->calm >= s->hold) {
+            s->shift = s->calm_need;
+            s->changes++;
+            s->calm = 0;
+            s->calm_need = 0;
+        }
+    } else {
+        s->calm = 0;
+        s->calm_need = 0;
+    }
+
+    s->blocks++;
+    if ((peak >> s->shift) > 127)
+        s->clipped++;
+    return s->shift;
+}
+
+void iq_to8_shift(const short *ibuf, const short *qbuf, int n, int shift, unsigned char *out) {
+    int i = 0;
+
+#if defined(__SSE2__)
+    __m128i count = _mm_cvtsi32_si128(shift);
+
+    /* shift, interleave, saturate to signed bytes: 8 pairs per round */
+    for (; i + 8 <= n; i += 8) {
+        __m128i vi = _mm_sra_epi16(_mm_loadu_si128((const __m128i *) (ibuf + i)), count);
+        __m128i vq = _mm_sra_epi16(_mm_loadu_si128((const __m128i *) (qbuf + i)), count);
+        __m128i packed = _mm_packs_epi16(_mm_unpacklo_epi16(vi, vq), _mm_unpackhi_epi16(vi, vq));
+        _mm_storeu_si128((__m128i *) (out + 2 * i), packed);
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    int16x8_t count = vdupq_n_s16((short) -shift);
+
+    for (; i + 8 <= n; i += 8) {
+        int8x8x2_t pair;
+        pair.val[0] = vqmovn_s16(vshlq_s16(vld1q_s16(ibuf + i), count));
+        pair.val[1] = vqmovn_s16(vshlq_s16(vld1q_s16(qbuf + i), count));
+        vst2_s8((int8_t *) (out + 2 * i), pair);
+    }
+#endif
+
+    for (; i < n; i++) {
+        int vi = ibuf[i] >> shift, vq = qbuf[i] >> shift;
+        out[2 * i] = (unsigned char) (vi > 127 ? 127 : vi < -128 ? -128 : vi);
+        out[2 * i + 1] = (unsigned char) (vq > 127 ? 127 : vq < -128 ? -128 : vq);
+    }
+}
+
+void iq_cs8_to_cf32(const unsigned char *in, int n, int gain_bits, float *out) {
+    float scale = 1.0f / (float) (128 << gain_bits);
+    int i = 0;
+
+#if defined(__SSE2__)
+    /* each byte to the top of a 32 bit lane, converted exactly and scaled back down: 8 pairs per round */
+    __m128 vscale = _mm_set1_ps(scale / 16777216.0f);
+    __m128i zero = _mm_setzero_si128();
+
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (in + 2 * i));
+        __m128i lo = _mm_unpacklo_epi8(zero, v), hi = _mm_unpackhi_epi8(zero, v);
+        float *o = out + 2 * i;
+
+        _mm_storeu_ps(o, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(zero, lo)), vscale));
+        _mm_storeu_ps(o + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(zero, lo)), vscale));
+        _mm_storeu_ps(o + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(zero, hi)), vscale));
+        _mm_storeu_ps(o + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(zero, hi)), vscale));
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; i + 8 <= n; i += 8) {
+        int8x16_t v = vld1q_s8((const int8_t *) (in + 2 * i));
+        int16x8_t lo = vmovl_s8(vget_low_s8(v)), hi = vmovl_s8(vget_high_s8(v));
+        float *o = out + 2 * i;
+
+        vst1q_f32(o, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(lo))), scale));
+        vst1q_f32(o + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(lo))), scale));
+        vst1q_f32(o + 8, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(hi))), scale));
+        vst1q_f32(o + 12, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(hi))), scale));
+    }
+#endif
+
+    for (; i < n; i++) {
+        out[2 * i] = (int8_t) in[2 * i] * scale;
+        out[2 * i + 1] = (int8_t) in[2 * i + 1] * scale;
+    }
+}
@@ -0,0 +1,105 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  iqdsp: small vectorised kernels working directly on the split
+ *  ibuf/qbuf packets returned by mir_sdr_ReadPacket.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IQDSP_H
+#define IQDSP_H
+
+#include <stdint.h>
+
+/*
+ * Mean power of one packet, sum(i*i + q*q) / n, normalised so that a
+ * full scale 16 bit sine reads 1.0 (0 dBFS).
+ */
+double iq_block_power(const short *ibuf, const short *qbuf, int n);
+
+/* power (as returned by iq_block_power) <-> dBFS */
+double iq_power_to_dbfs(double power);
+
+double iq_dbfs_to_power(double dbfs);
+
+/*
+ * Complex FIR decimator: windowed sinc low pass at the new Nyquist
+ * frequency, only evaluated for the samples that are kept.
+ */
+struct iq_decimator {
+    int factor;
+    int ntaps;
+    float *taps;
+    float *hist_i;          /* 2 * ntaps, every sample stored twice so the window is contiguous */
+    float *hist_q;
+    int pos;
+    int phase;
+};
+
+/* taps_per_factor * factor + 1 taps. Returns 0 on success. */
+int iq_decimator_init(struct iq_decimator *d, int factor, int taps_per_factor);
+
+/* returns the number of samples written to out_i / out_q, at most n / factor + 1 */
+int iq_decimate(struct iq_decimator *d, const float *in_i, const float *in_q, int n, float *out_i, float *out_q);
+
+void iq_decimator_free(struct iq_decimator *d);
+
+/* in place forward FFT, n a power of two */
+void iq_fft(float *re, float *im, int n);
+
+/*
+ * Block adaptive 8 bit output (play_sdr / play_tcp -q). Instead of always
+ * the top byte (a shift of 8) every block goes out shifted right by the
+ * least amount its peak, or 4 times its RMS, fits in: a weak signal keeps
+ * up to 8 more bits. A reader multiplies by 1 << shift. Louder blocks take
+ * a larger shift at once, a smaller one only after every block of the hold
+ * time made do with it, so the scale changes rarely.
+ */
+enum iq_scale_mode {
+    IQ_SCALE_PEAK,              /* never clips */
+    IQ_SCALE_RMS                /* 12 dB over the RMS, rare peaks saturate */
+};
+
+struct iq_scaler {
+    enum iq_scale_mode mode;
+    int hold_ms;
+    uint64_t hold;              /* samples, 0: every block takes its own shift */
+    uint64_t calm;              /* samples a smaller shift has sufficed */
+    int calm_need;              /* the largest shift needed meanwhile */
+    int shift;                  /* in force, 8 is the fixed top byte */
+    uint64_t blocks, changes, clipped;
+};
+
+/* "peak" or "rms", optionally ":hold_ms" (default 100). Returns -1 when malformed. */
+int iq_scaler_parse(struct iq_scaler *s, const char *arg);
+
+/* back to the top byte, the hold time counted at samp_rate */
+void iq_scaler_reset(struct iq_scaler *s, uint32_t samp_rate);
+
+/* looks at one block and returns the shift it goes out with */
+int iq_scaler_update(struct iq_scaler *s, const short *ibuf, const short *qbuf, int n);
+
+/* n pairs to interleaved 8 bit I/Q, each value >> shift and saturated; shift 8 is ibuf[i] >> 8 */
+void iq_to8_shift(const short *ibuf, const short *qbuf, int n, int shift, unsigned char *out);
+
+/*
+ * n interleaved signed 8 bit pairs, as play_tcp sends them, to interleaved
+ * float. 1.0 is full scale of the 16 bit samples they were cut from, the
+ * bytes << (8 - gain_bits), so scaled and unscaled frames line up.
+ */
+void iq_cs8_to_cf32(const unsigned char *in, int n, int gain_bits, float *out);
+
+#endif
@@ -0,0 +1,567 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FILE_OFFSET_BITS
+#define _FILE_OFFSET_BITS 64
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "iqz.h"
+
+#define IQZ_ESCAPE      24  /* unary quotients this long are followed by the raw value */
+#define IQZ_RAW_BITS    17  /* zigzag of a 16 bit delta */
+#define IQZ_MAX_K       16
+
+enum { SLOT_FREE, SLOT_FILLING, SLOT_READY, SLOT_BUSY, SLOT_DONE };
+
+struct iqz_slot {
+    int state;
+    uint64_t first_sample;
+    uint8_t *raw;
+    size_t raw_len;
+    uint32_t *zz;               /* scratch, both planes */
+    uint8_t *out;               /* block header + payload */
+    size_t out_len;
+};
+
+static void put_le32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t) v;
+    p[1] = (uint8_t) (v >> 8);
+    p[2] = (uint8_t) (v >> 16);
+    p[3] = (uint8_t) (v >> 24);
+}
+
+static void put_le64(uint8_t *p, uint64_t v) {
+    put_le32(p, (uint32_t) v);
+    put_le32(p + 4, (uint32_t) (v >> 32));
+}
+
+static uint32_t get_le32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static uint64_t get_le64(const uint8_t *p) {
+    return get_le32(p) | ((uint64_t) get_le32(p + 4) << 32);
+}
+
+/* ---- bit level coding ---- */
+
+struct bitw {
+    uint8_t *p;
+    uint64_t acc;
+    int n;
+};
+
+static inline void bw_put(struct bitw *b, uint32_t v, int nbits) {
+    b->acc = (b->acc << nbits) | v;
+    b->n += nbits;
+    while (b->n >= 8) {
+        b->n -= 8;
+        *b->p++ = (uint8_t) (b->acc >> b->n);
+    }
+}
+
+static inline void bw_flush(struct bitw *b) {
+    if (b->n > 0)
+        *b->p++ = (uint8_t) (b->acc << (8 - b->n));
+    b->n = 0;
+}
+
+struct bitr {
+    const uint8_t *p;
+    const uint8_t *end;
+    uint64_t acc;               /* next bits, msb first */
+    int n;
+};
+
+static inline void br_refill(struct bitr *b) {
+    while (b->n <= 56) {
+        if (b->p < b->end)
+            b->acc |= (uint64_t) *b->p++ << (56 - b->n);
+        b->n += 8; /* zeros past the end */
+    }
+}
+
+static inline uint32_t br_get(struct bitr *b, int nbits) {
+    uint32_t v;
+
+    if (nbits == 0)
+        return 0;
+    v = (uint32_t) (b->acc >> (64 - nbits));
+    b->acc <<= nbits;
+    b->n -= nbits;
+    return v;
+}
+
+static inline uint32_t zigzag(int32_t v) {
+    return ((uint32_t) v << 1) ^ (uint32_t) (v >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t v) {
+    return (int32_t) (v >> 1) ^ -(int32_t) (v & 1);
+}
+
+static inline int32_t sample_at(const uint8_t *raw, int bits, size_t i, int plane) {
+    if (bits == 8)
+        return raw[2 * i + plane];
+
+    return (int16_t) (raw[4 * i + 2 * plane] | (raw[4 * i + 2 * plane + 1] << 8));
+}
+
+/* compresses one block into slot->out, header included */
+static void iqz_encode(struct iqz_slot *slot, int bits, size_t pair_bytes) {
+    size_t pairs = slot->raw_len / pair_bytes;
+    uint8_t *hdr = slot->out;
+    struct bitw bw;
+    uint8_t k[2];
+    int plane;
+    size_t i;
+
+    for (plane = 0; plane < 2; plane++) {
+        uint32_t *zz = slot->zz + plane * pairs;
+        int32_t prev = 0, v;
+        uint64_t sum = 0;
+
+        for (i = 0; i < pairs; i++) {
+            v = sample_at(slot->raw, bits, i, plane);
+            zz[i] = zigzag(v - prev);
+            sum += zz[i];
+            prev = v;
+        }
+
+        k[plane] = 0;
+        while (k[plane] < IQZ_MAX_K && ((uint64_t) pairs << (k[plane] + 1)) <= sum)
+            k[plane]++;
+    }
+
+    bw.p = hdr + IQZ_BLOCK_HEADER_SIZE;
+    bw.acc = 0;
+    bw.n = 0;
+    for (plane = 0; plane < 2; plane++) {
+        const uint32_t *zz = slot->zz + plane * pairs;
+        int kp = k[plane];
+
+        for (i = 0; i < pairs; i++) {
+            uint32_t q = zz[i] >> kp;
+            if (q < IQZ_ESCAPE) {
+                bw_put(&bw, ((1u << q) - 1) << 1, q + 1);
+                if (kp)
+                    bw_put(&bw, zz[i] & ((1u << kp) - 1), kp);
+            } else {
+                bw_put(&bw, (1u << IQZ_ESCAPE) - 1, IQZ_ESCAPE);
+                bw_put(&bw, zz[i], IQZ_RAW_BITS);
+            }
+        }
+    }
+    bw_flush(&bw);
+
+    memcpy(hdr, "IQZB", 4);
+    put_le32(hdr + 8, (uint32_t) pairs);
+    hdr[12] = k[0];
+    hdr[13] = k[1];
+    hdr[15] = 0;
+
+    if ((size_t) (bw.p - hdr - IQZ_BLOCK_HEADER_SIZE) >= slot->raw_len) {
+        memcpy(hdr + IQZ_BLOCK_HEADER_SIZE, slot->raw, slot->raw_len);
+        put_le32(hdr + 4, (uint32_t) slot->raw_len);
+        hdr[14] = IQZ_FLAG_STORED;
+        slot->out_len = IQZ_BLOCK_HEADER_SIZE + slot->raw_len;
+    } else {
+        put_le32(hdr + 4, (uint32_t) (bw.p - hdr - IQZ_BLOCK_HEADER_SIZE));
+        hdr[14] = 0;
+        slot->out_len = bw.p - hdr;
+    }
+}
+
+static void iqz_decode(const uint8_t *payload, size_t len, size_t pairs, int bits, const uint8_t *k,
+                       uint8_t *out) {
+    struct bitr br;
+    int plane;
+    size_t i;
+
+    br.p = payload;
+    br.end = payload + len;
+    br.acc = 0;
+    br.n = 0;
+
+    for (plane = 0; plane < 2; plane++) {
+        int kp = k[plane];
+        int32_t v = 0;
+
+        for (i = 0; i < pairs; i++) {
+            uint32_t zz;
+            int ones;
+
+            br_refill(&br);
+            ones = (~br.acc == 0) ? 64 : __builtin_clzll(~br.acc);
+            if (ones >= IQZ_ESCAPE) {
+                br_get(&br, IQZ_ESCAPE);
+                zz = br_get(&br, IQZ_RAW_BITS);
+            } else {
+                br_get(&br, ones + 1);
+                zz = ((uint32_t) ones << kp) | br_get(&br, kp);
+            }
+            v += unzigzag(zz);
+
+            if (bits == 8) {
+                out[2 * i + plane] = (uint8_t) v;
+            } else {
+                out[4 * i + 2 * plane] = (uint8_t) v;
+                out[4 * i + 2 * plane + 1] = (uint8_t) (v >> 8);
+            }
+        }
+    }
+}
+
+/* ---- writer: capture thread fills, workers compress, writer thread writes in order ---- */
+
+static void *iqz_worker(void *arg) {
+    struct iqz_writer *w = arg;
+    struct iqz_slot *slot;
+
+    pthread_mutex_lock(&w->lock);
+    for (;;) {
+        while (w->next_compress < w->fill_seq &&
+               w->slots[w->next_compress % w->nslots].state == SLOT_READY) {
+            slot = &w->slots[w->next_compress % w->nslots];
+            slot->state = SLOT_BUSY;
+            w->next_compress++;
+            pthread_mutex_unlock(&w->lock);
+
+            iqz_encode(slot, w->bits, w->pair_bytes);
+
+            pthread_mutex_lock(&w->lock);
+            slot->state = SLOT_DONE;
+            pthread_cond_broadcast(&w->cond);
+        }
+        if (w->stop && w->next_compress == w->fill_seq)
+            break;
+        pthread_cond_wait(&w->cond, &w->lock);
+    }
+    pthread_mutex_unlock(&w->lock);
+
+    return NULL;
+}
+
+static void *iqz_write_thread(void *arg) {
+    struct iqz_writer *w = arg;
+    struct iqz_slot *slot;
+
+    pthread_mutex_lock(&w->lock);
+    for (;;) {
+        slot = &w->slots[w->next_write % w->nslots];
+        if (w->next_write < w->fill_seq && slot->state == SLOT_DONE) {
+            pthread_mutex_unlock(&w->lock);
+
+            if (!w->failed && fwrite(slot->out, 1, slot->out_len, w->file) != slot->out_len) {
+                fprintf(stderr, "Short write of compressed block, recording incomplete!\n");
+                w->failed = 1;
+            }
+            if (w->nindex % 1024 == 0)
+                w->index = realloc(w->index, (w->nindex + 1024) * sizeof(*w->index));
+            w->index[w->nindex].offset = w->offset;
+            w->index[w->nindex].sample = slot->first_sample;
+            w->nindex++;
+            w->offset += slot->out_len;
+
+            pthread_mutex_lock(&w->lock);
+            slot->state = SLOT_FREE;
+            w->next_write++;
+            pthread_cond_broadcast(&w->cond);
+            continue;
+        }
+        if (w->stop && w->next_write == w->fill_seq)
+            break;
+        pthread_cond_wait(&w->cond, &w->lock);
+    }
+    pthread_mutex_unlock(&w->lock);
+
+    return NULL;
+}
+
+int iqz_writer_open(struct iqz_writer *w, FILE *file, int bits, uint32_t samp_rate,
+                    uint32_t frequency, int threads) {
+    uint8_t hdr[IQZ_FILE_HEADER_SIZE];
+    size_t block_bytes;
+    int i;
+
+    memset(w, 0, sizeof(*w));
+    w->file = file;
+    w->bits = bits;
+    w->pair_bytes = bits == 8 ? 2 : 4;
+    w->threads = threads > 0 ? threads : 1;
+    w->nslots = 2 * w->threads + 2;
+
+    memset(hdr, 0, sizeof(hdr));
+    memcpy(hdr, "IQZ1", 4);
+    put_le32(hdr + 4, IQZ_VERSION);
+    put_le32(hdr + 8, bits);
+    put_le32(hdr + 12, samp_rate);
+    put_le32(hdr + 16, frequency);
+    put_le32(hdr + 20, IQZ_BLOCK_SAMPLES);
+    if (fwrite(hdr, 1, sizeof(hdr), file) != sizeof(hdr))
+        return -1;
+    w->offset = sizeof(hdr);
+
+    block_bytes = IQZ_BLOCK_SAMPLES * w->pair_bytes;
+    w->slots = calloc(w->nslots, sizeof(*w->slots));
+    for (i = 0; i < w->nslots; i++) {
+        w->slots[i].raw = malloc(block_bytes);
+        w->slots[i].zz = malloc(2 * IQZ_BLOCK_SAMPLES * sizeof(uint32_t));
+        /* worst case: every value escaped, or stored */
+        w->slots[i].out = malloc(IQZ_BLOCK_HEADER_SIZE + 2 * IQZ_BLOCK_SAMPLES * (IQZ_ESCAPE + IQZ_RAW_BITS) / 8 + 8);
+        if (!w->slots[i].raw || !w->slots[i].zz || !w->slots[i].out) {
+            fprintf(stderr, "Failed to allocate compression buffers.\n");
+            return -1;
+        }
+    }
+
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->cond, NULL);
+    w->workers = calloc(w->threads, sizeof(pthread_t));
+    for (i = 0; i < w->threads; i++)
+        pthread_create(&w->workers[i], NULL, iqz_worker, w);
+    pthread_create(&w->writer, NULL, iqz_write_thread, w);
+
+    return 0;
+}
+
+static void iqz_submit(struct iqz_writer *w) {
+    struct iqz_slot *slot = &w->slots[w->fill_seq % w->nslots];
+
+    pthread_mutex_lock(&w->lock);
+    slot->raw_len = w->fill;
+    slot->first_sample = w->samples;
+    slot->state = SLOT_READY;
+    w->samples += w->fill / w->pair_bytes;
+    w->fill_seq++;
+    w->fill = 0;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+}
+
+int iqz_writer_write(struct iqz_writer *w, const void *buf, size_t len) {
+    size_t block_bytes = IQZ_BLOCK_SAMPLES * w->pair_bytes;
+    const uint8_t *p = buf;
+    struct iqz_slot *slot;
+    size_t chunk;
+
+    while (len > 0) {
+        slot = &w->slots[w->fill_seq % w->nslots];
+        if (w->fill == 0) {
+            pthread_mutex_lock(&w->lock);
+            while (slot->state != SLOT_FREE && !w->failed)
+                pthread_cond_wait(&w->cond, &w->lock);
+            slot->state = SLOT_FILLING;
+            pthread_mutex_unlock(&w->lock);
+            if (w->failed)
+                return -1;
+        }
+
+        chunk = block_bytes - w->fill;
+        if (chunk > len)
+            chunk = len;
+        memcpy(slot->raw + w->fill, p, chunk);
+        w->fill += chunk;
+        w->raw_bytes += chunk;
+        p += chunk;
+        len -= chunk;
+
+        if (w->fill == block_bytes)
+            iqz_submit(w);
+    }
+
+    return w->failed ? -1 : 0;
+}
+
+int iqz_writer_close(struct iqz_writer *w) {
+    uint8_t entry[16];
+    uint64_t i, index_offset;
+    int n;
+
+    if (w->fill >= w->pair_bytes) {
+        w->fill -= w->fill % w->pair_bytes;
+        iqz_submit(w);
+    }
+
+    pthread_mutex_lock(&w->lock);
+    w->stop = 1;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+
+    for (n = 0; n < w->threads; n++)
+        pthread_join(w->workers[n], NULL);
+    pthread_join(w->writer, NULL);
+
+    index_offset = w->offset;
+    for (i = 0; i < w->nindex && !w->failed; i++) {
+        put_le64(entry, w->index[i].offset);
+        put_le64(entry + 8, w->index[i].sample);
+        if (fwrite(entry, 1, sizeof(entry), w->file) != sizeof(entry))
+            w->failed = 1;
+    }
+    memcpy(entry, "IQZI", 4);
+    put_le32(entry + 4, (uint32_t) w->nindex);
+    put_le64(entry + 8, index_offset);
+    if (!w->failed && fwrite(entry, 1, IQZ_FOOTER_SIZE, w->file) != IQZ_FOOTER_SIZE)
+        w->failed = 1;
+
+    for (n = 0; n < w->nslots; n++) {
+        free(w->slots[n].raw);
+        free(w->slots[n].zz);
+        free(w->slots[n].out);
+    }
+    free(w->slots);
+    free(w->workers);
+    free(w->index);
+    pthread_mutex_destroy(&w->lock);
+    pthread_cond_destroy(&w->cond);
+
+    return w->failed ? -1 : 0;
+}
+
+/* ---- reader ---- */
+
+static int iqz_scan(struct iqz_reader *rd) {
+    uint8_t hdr[IQZ_BLOCK_HEADER_SIZE];
+    off_t offset = IQZ_FILE_HEADER_SIZE;
+    off_t size;
+
+    fseeko(rd->file, 0, SEEK_END);
+    size = ftello(rd->file);
+
+    rd->nindex = 0;
+    rd->samples = 0;
+    fseeko(rd->file, offset, SEEK_SET);
+    while (fread(hdr, 1, sizeof(hdr), rd->file) == sizeof(hdr) && memcmp(hdr, "IQZB", 4) == 0) {
+        if (offset + IQZ_BLOCK_HEADER_SIZE + get_le32(hdr + 4) > size)
+            break; /* cut off while writing */
+        if (rd->nindex % 1024 == 0)
+            rd->index = realloc(rd->index, (rd->nindex + 1024) * sizeof(*rd->index));
+        rd->index[rd->nindex].offset = offset;
+        rd->index[rd->nindex].sample = rd->samples;
+        rd->nindex++;
+        rd->samples += get_le32(hdr + 8);
+        offset += IQZ_BLOCK_HEADER_SIZE + get_le32(hdr + 4);
+        if (fseeko(rd->file, offset, SEEK_SET) != 0)
+            break;
+    }
+
+    return 0;
+}
+
+int iqz_reader_open(struct iqz_reader *rd, FILE *file) {
+    uint8_t hdr[IQZ_FILE_HEADER_SIZE];
+    uint8_t footer[IQZ_FOOTER_SIZE];
+    uint8_t entry[16];
+    uint64_t i, index_offset;
+
+    memset(rd, 0, sizeof(*rd));
+    rd->file = file;
+
+    if (fread(hdr, 1, sizeof(hdr), file) != sizeof(hdr) || memcmp(hdr, "IQZ1", 4) != 0) {
+        fprintf(stderr, "Not an iqz recording.\n");
+        return -1;
+    }
+    rd->bits = (int) get_le32(hdr + 8);
+    rd->pair_bytes = rd->bits == 8 ? 2 : 4;
+    rd->samp_rate = get_le32(hdr + 12);
+    rd->frequency = get_le32(hdr + 16);
+    rd->block_samples = get_le32(hdr + 20);
+
+    if (fseeko(file, -IQZ_FOOTER_SIZE, SEEK_END) == 0 &&
+        fread(footer, 1, sizeof(footer), file) == sizeof(footer) && memcmp(footer, "IQZI", 4) == 0) {
+        rd->nindex = get_le32(footer + 4);
+        index_offset = get_le64(footer + 8);
+        rd->index = malloc((rd->nindex + 1) * sizeof(*rd->index));
+        fseeko(file, (off_t) index_offset, SEEK_SET);
+        for (i = 0; i < rd->nindex; i++) {
+            if (fread(entry, 1, sizeof(entry), file) != sizeof(entry))
+                break;
+            rd->index[i].offset = get_le64(entry);
+            rd->index[i].sample = get_le64(entry + 8);
+        }
+        if (i == rd->nindex) {
+            rd->indexed = 1;
+            rd->samples = 0;
+            if (rd->nindex > 0) {
+                uint8_t bhdr[IQZ_BLOCK_HEADER_SIZE];
+                fseeko(file, (off_t) rd->index[rd->nindex - 1].offset, SEEK_SET);
+                if (fread(bhdr, 1, sizeof(bhdr), file) == sizeof(bhdr))
+                    rd->samples = rd->index[rd->nindex - 1].sample + get_le32(bhdr + 8);
+            }
+            return 0;
+        }
+    }
+
+    /* no (complete) index, the recorder did not exit cleanly */
+    return iqz_scan(rd);
+}
+
+uint64_t iqz_find_block(struct iqz_reader *rd, uint64_t sample) {
+    uint64_t lo = 0, hi = rd->nindex;
+
+    while (hi - lo > 1) {
+        uint64_t mid = (lo + hi) / 2;
+        if (rd->index[mid].sample <= sample)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+long iqz_read_block(struct iqz_reader *rd, uint64_t blk, uint8_t *out) {
+    uint8_t hdr[IQZ_BLOCK_HEADER_SIZE];
+    uint8_t *payload;
+    uint32_t len, pairs;
+
+    if (blk >= rd->nindex || fseeko(rd->file, (off_t) rd->index[blk].offset, SEEK_SET) != 0 ||
+        fread(hdr, 1, sizeof(hdr), rd->file) != sizeof(hdr) || memcmp(hdr, "IQZB", 4) != 0)
+        return -1;
+
+    len = get_le32(hdr + 4);
+    pairs = get_le32(hdr + 8);
+    if (pairs > rd->block_samples || len > 2 * rd->block_samples * (IQZ_ESCAPE + IQZ_RAW_BITS) / 8 + 8)
+        return -1;
+
+    if (hdr[14] & IQZ_FLAG_STORED) {
+        if (len != pairs * rd->pair_bytes || fread(out, 1, len, rd->file) != len)
+            return -1;
+        return pairs;
+    }
+
+    payload = malloc(len);
+    if (fread(payload, 1, len, rd->file) != len) {
+        free(payload);
+        return -1;
+    }
+    iqz_decode(payload, len, pairs, rd->bits, hdr + 12, out);
+    free(payload);
+
+    return pairs;
+}
+
+void iqz_reader_close(struct iqz_reader *rd) {
+    free(rd->index);
+    rd->index = NULL;
+}
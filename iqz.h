@@ -0,0 +1,120 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  iqz: streaming lossless compression of interleaved I/Q recordings.
+ *
+ *  The stream is cut into blocks of IQZ_BLOCK_SAMPLES I/Q pairs. Each block
+ *  is split into an I and a Q plane, delta coded and Rice coded with one
+ *  parameter per plane and block (blocks that do not shrink are stored).
+ *  Blocks are compressed in parallel by a pool of worker threads and
+ *  written in order by a writer thread, so the capture loop only copies.
+ *
+ *  File layout, all integers little endian:
+ *    file header    "IQZ1", version, bits (8/16), samp_rate, frequency, block_samples, 2 x reserved
+ *    blocks         "IQZB", payload bytes, I/Q pairs, k_i, k_q, flags, reserved, payload
+ *    index          per block: u64 file offset, u64 first I/Q pair
+ *    footer         "IQZI", number of blocks, u64 offset of the index
+ *  A file without index (recorder killed) is still readable by scanning
+ *  the block headers.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IQZ_H
+#define IQZ_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define IQZ_VERSION             1
+#define IQZ_BLOCK_SAMPLES       65536
+#define IQZ_FILE_HEADER_SIZE    32
+#define IQZ_BLOCK_HEADER_SIZE   16
+#define IQZ_FOOTER_SIZE         16
+
+#define IQZ_FLAG_STORED         1   /* payload is the raw interleaved block */
+
+struct iqz_index_entry {
+    uint64_t offset;
+    uint64_t sample;
+};
+
+struct iqz_slot;
+
+struct iqz_writer {
+    FILE *file;
+    int bits;
+    size_t pair_bytes;
+
+    int threads;
+    pthread_t *workers;
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int stop;
+    int failed;
+
+    struct iqz_slot *slots;
+    int nslots;
+    uint64_t fill_seq;          /* block being filled by the capture thread */
+    uint64_t next_compress;
+    uint64_t next_write;
+    size_t fill;                /* bytes in the block being filled */
+
+    struct iqz_index_entry *index;
+    uint64_t nindex;
+    uint64_t offset;            /* bytes written to file */
+    uint64_t samples;
+    uint64_t raw_bytes;
+};
+
+/* bits: 8 or 16 bit interleaved I/Q. Returns 0 on success. */
+int iqz_writer_open(struct iqz_writer *w, FILE *file, int bits, uint32_t samp_rate,
+                    uint32_t frequency, int threads);
+
+/* appends interleaved samples, blocks only when all workers are behind */
+int iqz_writer_write(struct iqz_writer *w, const void *buf, size_t len);
+
+/* flushes the last block, writes index and footer, stops the pool */
+int iqz_writer_close(struct iqz_writer *w);
+
+struct iqz_reader {
+    FILE *file;
+    int bits;
+    size_t pair_bytes;
+    uint32_t samp_rate;
+    uint32_t frequency;
+    uint32_t block_samples;
+    struct iqz_index_entry *index;
+    uint64_t nindex;
+    uint64_t samples;
+    int indexed;                /* 0: index rebuilt by scanning */
+};
+
+int iqz_reader_open(struct iqz_reader *rd, FILE *file);
+
+/*
+ * Decodes block number blk into out (block_samples * pair_bytes bytes).
+ * Returns the number of I/Q pairs, -1 on a corrupt block.
+ */
+long iqz_read_block(struct iqz_reader *rd, uint64_t blk, uint8_t *out);
+
+/* block holding I/Q pair number sample */
+uint64_t iqz_find_block(struct iqz_reader *rd, uint64_t sample);
+
+void iqz_reader_close(struct iqz_reader *rd);
+
+#endif
@@ -0,0 +1,79 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "lathist.h"
+
+void lathist_reset(struct lathist *h) {
+    memset(h, 0, sizeof(*h));
+}
+
+/* below 8 us one bucket per us, above that the top 3 bits after the leading one pick the bucket */
+static int bucket(uint64_t us) {
+    int octave = 63 - __builtin_clzll(us | 1);
+    int idx;
+
+    if (us < LATHIST_SUB)
+        return (int) us;
+    idx = (octave - 2) * LATHIST_SUB + (int) ((us >> (octave - 3)) & (LATHIST_SUB - 1));
+
+    return idx < LATHIST_BUCKETS ? idx : LATHIST_BUCKETS - 1;
+}
+
+static uint64_t bucket_top_ns(int idx) {
+    int octave = idx / LATHIST_SUB + 2;
+
+    if (idx < LATHIST_SUB)
+        return (uint64_t) (idx + 1) * 1000;
+
+    return ((uint64_t) (LATHIST_SUB + 1 + idx % LATHIST_SUB) << (octave - 3)) * 1000;
+}
+
+void lathist_add(struct lathist *h, uint64_t ns) {
+    h->count[bucket(ns / 1000)]++;
+    h->n++;
+    if (ns > h->max_ns)
+        h->max_ns = ns;
+}
+
+uint64_t lathist_percentile(const struct lathist *h, double p) {
+    uint64_t want, seen = 0, top;
+    int i;
+
+    if (h->n == 0)
+        return 0;
+
+    want = (uint64_t) (p / 100.0 * h->n);
+    if (want >= h->n)
+        want = h->n - 1;
+    for (i = 0; i < LATHIST_BUCKETS; i++) {
+        seen += h->count[i];
+        if (seen > want)
+            break;
+    }
+    top = bucket_top_ns(i < LATHIST_BUCKETS ? i : LATHIST_BUCKETS - 1);
+
+    return top < h->max_ns ? top : h->max_ns;
+}
+
+void lathist_print(const struct lathist *h, const char *label, FILE *f) {
+    fprintf(f, "%s: p50 %.2f p90 %.2f p99 %.2f p99.9 %.2f max %.2f ms, %llu packets\n", label,
+            lathist_percentile(h, 50) / 1e6, lathist_percentile(h, 90) / 1e6, lathist_percentile(h, 99) / 1e6,
+            lathist_percentile(h, 99.9) / 1e6, h->max_ns / 1e6, (unsigned long long) h->n);
+}
@@ -0,0 +1,49 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  lathist: latency histogram with 8 logarithmic buckets per octave from
+ *  1 us to about two minutes, so recording a value is a few instructions and
+ *  percentiles come out within 1/8 of an octave (about 9%).
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LATHIST_H
+#define LATHIST_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define LATHIST_SUB         8       /* buckets per octave */
+#define LATHIST_OCTAVES     26
+#define LATHIST_BUCKETS     (LATHIST_SUB * LATHIST_OCTAVES)
+
+struct lathist {
+    uint64_t count[LATHIST_BUCKETS];
+    uint64_t n;
+    uint64_t max_ns;
+};
+
+void lathist_reset(struct lathist *h);
+
+void lathist_add(struct lathist *h, uint64_t ns);
+
+/* upper edge of the bucket holding the p-th percentile (0..100), ns */
+uint64_t lathist_percentile(const struct lathist *h, double p);
+
+/* one line: label, p50 p90 p99 p99.9 and max in ms, number of values */
+void lathist_print(const struct lathist *h, const char *label, FILE *f);
+
+#endif
@@ -0,0 +1,339 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "modes.h"
+
+#define CRC_POLY            0xfff409u   /* Mode S, x^24 + ... + 1 without the top bit */
+#define PULSE_OVER_NOISE    3.0f        /* pulse mean against the mean magnitude of the block, ~10 dB */
+#define FULL_SCALE          32768.0
+
+struct syndrome {
+    uint32_t s;
+    int16_t b1, b2;                     /* bits to flip, b2 -1 for one; b1 -1: ambiguous */
+};
+
+static uint32_t crc_table[256];
+
+static void crc_init(void) {
+    uint32_t c;
+    int i, j;
+
+    for (i = 0; i < 256; i++) {
+        c = (uint32_t) i << 16;
+        for (j = 0; j < 8; j++)
+            c = c & 0x800000 ? (c << 1) ^ CRC_POLY : c << 1;
+        crc_table[i] = c & 0xffffff;
+    }
+}
+
+/* the CRC of all but the last 24 bits xor those: 0, the interrogator code or the address */
+static uint32_t syndrome_of(const uint8_t *msg, int bits) {
+    int n = bits / 8 - 3, i;
+    uint32_t c = 0;
+
+    for (i = 0; i < n; i++)
+        c = ((c << 8) ^ crc_table[((c >> 16) ^ msg[i]) & 0xff]) & 0xffffff;
+    return c ^ ((uint32_t) msg[n] << 16 | (uint32_t) msg[n + 1] << 8 | msg[n + 2]);
+}
+
+static inline void flip(uint8_t *msg, int bit) {
+    msg[bit >> 3] ^= 0x80 >> (bit & 7);
+}
+
+static int syndrome_cmp(const void *a, const void *b) {
+    uint32_t x = ((const struct syndrome *) a)->s, y = ((const struct syndrome *) b)->s;
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * the syndromes of all one and two bit errors in a long message, past the
+ * DF field (an error there would have sent it down another path). The CRC
+ * is linear, so they are those of a zero message with the bits set.
+ */
+static int syndromes_init(struct modes *m) {
+    uint8_t msg[MODES_LONG_BITS / 8];
+    int first = 5, n = 0, i, j, k;
+    int count = MODES_LONG_BITS - first;
+
+    if (m->max_fix == 0)
+        return 0;
+    if (m->max_fix > 1)
+        count += count * (count - 1) / 2;
+    m->syndromes = malloc(count * sizeof(struct syndrome));
+    if (!m->syndromes)
+        return -1;
+
+    memset(msg, 0, sizeof(msg));
+    for (i = first; i < MODES_LONG_BITS; i++) {
+        flip(msg, i);
+        m->syndromes[n].s = syndrome_of(msg, MODES_LONG_BITS);
+        m->syndromes[n].b1 = i;
+        m->syndromes[n++].b2 = -1;
+        if (m->max_fix > 1) {
+            for (j = i + 1; j < MODES_LONG_BITS; j++) {
+                flip(msg, j);
+                m->syndromes[n].s = syndrome_of(msg, MODES_LONG_BITS);
+                m->syndromes[n].b1 = i;
+                m->syndromes[n++].b2 = j;
+                flip(msg, j);
+            }
+        }
+        flip(msg, i);
+    }
+
+    qsort(m->syndromes, n, sizeof(struct syndrome), syndrome_cmp);
+    for (k = 1; k < n; k++) {
+        if (m->syndromes[k].s == m->syndromes[k - 1].s)
+            m->syndromes[k].b1 = m->syndromes[k - 1].b1 = -1;
+    }
+    m->nsyndromes = n;
+    return 0;
+}
+
+/* number of bits repaired, -1 when the syndrome is not that of a known error */
+static int repair(const struct modes *m, uint8_t *msg, uint32_t s) {
+    struct syndrome key, *hit;
+
+    if (m->nsyndromes == 0)
+        return -1;
+    key.s = s;
+    hit = bsearch(&key, m->syndromes, m->nsyndromes, sizeof(struct syndrome), syndrome_cmp);
+    if (!hit || hit->b1 < 0)
+        return -1;
+    flip(msg, hit->b1);
+    if (hit->b2 < 0)
+        return 1;
+    flip(msg, hit->b2);
+    return 2;
+}
+
+static inline uint32_t icao_slot(uint32_t addr) {
+    return (addr * 0x9e3779b1u) >> (32 - 12) & (MODES_ICAO_SLOTS - 1);
+}
+
+static void icao_add(struct modes *m, uint32_t addr, int64_t now) {
+    uint32_t h = icao_slot(addr), k, oldest = h;
+
+    for (k = 0; k < 8; k++) {
+        uint32_t s = (h + k) & (MODES_ICAO_SLOTS - 1);
+        if (m->icao[s] == (addr | 1u << 24) || m->icao[s] == 0) {
+            oldest = s;
+            break;
+        }
+        if (m->icao_seen[s] < m->icao_seen[oldest])
+            oldest = s;
+    }
+    m->icao[oldest] = addr | 1u << 24;
+    m->icao_seen[oldest] = now;
+}
+
+static int icao_known(const struct modes *m, uint32_t addr, int64_t now) {
+    uint32_t h = icao_slot(addr), k;
+
+    for (k = 0; k < 8; k++) {
+        uint32_t s = (h + k) & (MODES_ICAO_SLOTS - 1);
+        if (m->icao[s] == 0)
+            return 0;
+        if (m->icao[s] == (addr | 1u << 24))
+            return now - m->icao_seen[s] < (int64_t) MODES_ICAO_SECONDS * MODES_RATE;
+    }
+    return 0;
+}
+
+int modes_init(struct modes *m, int block, int max_fix) {
+    memset(m, 0, sizeof(*m));
+    if (block < 1 || max_fix < 0 || max_fix > 2)
+        return -1;
+    m->block = block;
+    m->max_fix = max_fix;
+    m->base = -MODES_HISTORY;
+    m->resume = 0;
+    crc_init();
+
+    m->mag = calloc(MODES_HISTORY + block, sizeof(float));
+    m->flag = malloc(block);
+    if (!m->mag || !m->flag || syndromes_init(m) < 0) {
+        modes_free(m);
+        return -1;
+    }
+    return 0;
+}
+
+/* the finer checks of dump1090 on the pulse shape, p at a flagged position */
+static int preamble_shape(const float *p) {
+    float high;
+    int k;
+
+    if (!(p[0] > p[1] && p[1] < p[2] && p[2] > p[3] && p[3] < p[0] && p[4] < p[0] && p[5] < p[0] &&
+          p[6] < p[0] && p[7] > p[8] && p[8] < p[9] && p[9] > p[6]))
+        return 0;
+    high = (p[0] + p[2] + p[7] + p[9]) / 6.0f;
+    if (p[4] >= high || p[5] >= high)
+        return 0;
+    for (k = 11; k <= 14; k++) {
+        if (p[k] >= high)
+            return 0;
+    }
+    return 1;
+}
+
+/* 1 if msg is a message to pass on, repaired in place where needed */
+static int check(struct modes *m, struct modes_msg *msg, int64_t now) {
+    uint32_t s = syndrome_of(msg->data, msg->bits);
+    int fixed = 0;
+
+    switch (msg->df) {
+        case 17:
+        case 18:
+            if (s != 0 && (fixed = repair(m, msg->data, s)) < 0)
+                return 0;
+            break;
+        case 11:
+            /* the low 7 bits carry the interrogator code */
+            if (s & 0xffff80)
+                return 0;
+            break;
+        case 0:
+        case 4:
+        case 5:
+        case 16:
+        case 20:
+        case 21:
+            /* address/parity: the syndrome is the address */
+            if (!icao_known(m, s, now))
+                return 0;
+            break;
+        default:
+            return 0;
+    }
+
+    /* only messages with a clean CRC vouch for an address */
+    if ((msg->df == 11 && s == 0) || msg->df == 17 || msg->df == 18)
+        icao_add(m, (uint32_t) msg->data[1] << 16 | (uint32_t) msg->data[2] << 8 | msg->data[3], now);
+    msg->fixed = fixed;
+    return 1;
+}
+
+/* bits at 2 samples each after the preamble at p, a late first half means 1 */
+static void slice(const float *p, uint8_t *data, int bits) {
+    int k;
+
+    p += MODES_PREAMBLE;
+    memset(data, 0, MODES_LONG_BITS / 8);
+    for (k = 0; k < bits; k++) {
+        if (p[2 * k] > p[2 * k + 1])
+            data[k >> 3] |= 0x80 >> (k & 7);
+    }
+}
+
+void modes_feed(struct modes *m, const short *ibuf, const short *qbuf, int n, modes_msg_fn fn, void *ctx) {
+    float *mag = m->mag, *x = m->mag + MODES_HISTORY;
+    uint8_t *flag = m->flag;
+    float acc[8] = {0}, sum = 0.0f, limit;
+    struct modes_msg msg;
+    int k, j;
+
+    if (n > m->block)
+        n = m->block;
+
+    for (k = 0; k < n; k++)
+        x[k] = sqrtf((float) ibuf[k] * ibuf[k] + (float) qbuf[k] * qbuf[k]);
+
+    /* eight partial sums, so that this vectorises without -ffast-math */
+    for (k = 0; k + 8 <= n; k += 8) {
+        for (j = 0; j < 8; j++)
+            acc[j] += x[k + j];
+    }
+    for (; k < n; k++)
+        sum += x[k];
+    for (j = 0; j < 8; j++)
+        sum += acc[j];
+    limit = 4.0f * PULSE_OVER_NOISE * sum / n;
+
+    /*
+     * every position of the history and the block but the last MODES_HISTORY,
+     * which still lack the rest of a message: the four pulses p against the
+     * six gaps g, pulse mean above twice the gap mean and above the floor
+     */
+    for (k = 0; k < n; k++) {
+        const float *q = mag + k;
+        float p = q[0] + q[2] + q[7] + q[9];
+        float g = q[1] + q[3] + q[4] + q[5] + q[6] + q[8];
+        flag[k] = (3.0f * p > 4.0f * g) & (p > limit);
+    }
+
+    m->stats.samples += n;
+    for (k = 0; k < n; k++) {
+        uint64_t word;
+        int64_t at;
+
+        /* most of the block fails, skip it eight at a time */
+        if ((k & 7) == 0 && k + 8 <= n) {
+            memcpy(&word, flag + k, 8);
+            if (word == 0) {
+                k += 7;
+                continue;
+            }
+        }
+        if (!flag[k])
+            continue;
+        at = m->base + k;
+        if (at < m->resume)
+            continue;
+
+        m->stats.candidates++;
+        if (!preamble_shape(mag + k))
+            continue;
+        m->stats.preambles++;
+
+        slice(mag + k, msg.data, MODES_LONG_BITS);
+        msg.df = msg.data[0] >> 3;
+        if (msg.df >= 24)
+            msg.df = 24;
+        msg.bits = msg.df & 0x10 ? MODES_LONG_BITS : MODES_SHORT_BITS;
+        msg.sample = (uint64_t) at;
+        if (!check(m, &msg, at)) {
+            m->stats.bad_crc++;
+            continue;
+        }
+
+        msg.level = (mag[k] + mag[k + 2] + mag[k + 7] + mag[k + 9]) / (4.0 * FULL_SCALE);
+        if (msg.level > 1.0)
+            msg.level = 1.0;
+        m->stats.good++;
+        m->stats.fixed[msg.fixed]++;
+        m->stats.by_df[msg.df]++;
+        fn(ctx, &msg);
+
+        m->resume = at + MODES_PREAMBLE + 2 * msg.bits;
+    }
+
+    memmove(mag, mag + n, MODES_HISTORY * sizeof(float));
+    m->base += n;
+}
+
+void modes_free(struct modes *m) {
+    free(m->mag);
+    free(m->flag);
+    free(m->syndromes);
+    memset(m, 0, sizeof(*m));
+}
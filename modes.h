@@ -0,0 +1,99 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  modes: Mode S / ADS-B (1090 MHz) detection and decoding at 2 MS/s, as
+ *  rtl_adsb, for play_adsb.
+ *
+ *  Every block goes through two passes. The first, over all samples, is
+ *  plain loops the compiler vectorises: the magnitude, then the preamble
+ *  correlation at every position (the four pulses at 0, 1, 3.5 and 4.5 us
+ *  against the gaps between them) and its comparison with the noise
+ *  floor of the block, leaving one flag byte per position. The second
+ *  only visits the flagged positions: shape checks, bit decisions and the
+ *  CRC. DF17/18 messages with up to max_fix wrong bits are repaired from
+ *  a table of error syndromes; DF11 must check out apart from the
+ *  interrogator code, and the address/parity formats (DF0/4/5/16/20/21)
+ *  are only kept for aircraft recently heard in DF11/17/18.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MODES_H
+#define MODES_H
+
+#include <stdint.h>
+
+#define MODES_RATE          2000000
+#define MODES_PREAMBLE      16      /* samples, 8 us */
+#define MODES_LONG_BITS     112
+#define MODES_SHORT_BITS    56
+#define MODES_MSG_SAMPLES   (MODES_PREAMBLE + 2 * MODES_LONG_BITS)
+#define MODES_HISTORY       256     /* samples kept from the previous block, at least a message */
+#define MODES_ICAO_SLOTS    4096    /* recently heard aircraft, a power of two */
+#define MODES_ICAO_SECONDS  60
+
+struct modes_msg {
+    uint8_t data[MODES_LONG_BITS / 8];
+    int bits;
+    int df;
+    int fixed;                  /* bits repaired */
+    uint64_t sample;            /* of the start of the preamble */
+    double level;               /* mean pulse magnitude, 0..1 of full scale */
+};
+
+struct modes_stats {
+    uint64_t samples;
+    uint64_t candidates;        /* positions past the vectorised preamble test */
+    uint64_t preambles;         /* ... and the shape checks */
+    uint64_t good;              /* messages out, by CRC or known address */
+    uint64_t fixed[3];          /* of those, with 0, 1 or 2 bits repaired */
+    uint64_t bad_crc;
+    uint64_t by_df[32];
+};
+
+struct syndrome;
+
+struct modes {
+    int max_fix;                /* bits repaired in DF17/18, 0 to 2 */
+    int block;
+
+    float *mag;                 /* MODES_HISTORY samples of the previous block, then the block */
+    uint8_t *flag;              /* preamble test passed at mag[k] */
+    int64_t base;               /* sample number of mag[0], the first block starts at 0 */
+    int64_t resume;             /* no preamble before this one, it is inside the last message */
+
+    struct syndrome *syndromes;
+    int nsyndromes;
+
+    uint32_t icao[MODES_ICAO_SLOTS];
+    int64_t icao_seen[MODES_ICAO_SLOTS];   /* sample number, icao[] holds the address | 1 << 24 */
+
+    struct modes_stats stats;
+};
+
+typedef void (*modes_msg_fn)(void *ctx, const struct modes_msg *msg);
+
+/* block: samples per modes_feed at most. Returns 0 on success. */
+int modes_init(struct modes *m, int block, int max_fix);
+
+/*
+ * n split 16 bit I/Q samples at 2 MS/s, contiguous with the previous
+ * call. Every message found is handed to fn, in order.
+ */
+void modes_feed(struct modes *m, const short *ibuf, const short *qbuf, int n, modes_msg_fn fn, void *ctx);
+
+void modes_free(struct modes *m);
+
+#endif
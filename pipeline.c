@@ -0,0 +1,343 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pipeline.h"
+
+#define DEFAULT_DC_ALPHA    0.0001f
+
+static int run_dc(struct pipe_stage *st, float *i, float *q, int n) {
+    float a = st->alpha, mi = st->dc_i, mq = st->dc_q;
+    int k;
+
+    if (st->warm && n > 0) {
+        mi = mq = 0;
+        for (k = 0; k < n; k++) {
+            mi += i[k];
+            mq += q[k];
+        }
+        mi /= n;
+        mq /= n;
+        st->warm = 0;
+    }
+
+    for (k = 0; k < n; k++) {
+        mi += a * (i[k] - mi);
+        mq += a * (q[k] - mq);
+        i[k] -= mi;
+        q[k] -= mq;
+    }
+    st->dc_i = mi;
+    st->dc_q = mq;
+
+    return n;
+}
+
+static int run_swap(struct pipe_stage *st, float *i, float *q, int n) {
+    float t;
+    int k;
+
+    (void) st;
+    for (k = 0; k < n; k++) {
+        t = i[k];
+        i[k] = q[k];
+        q[k] = t;
+    }
+
+    return n;
+}
+
+static int run_scale(struct pipe_stage *st, float *i, float *q, int n) {
+    float g = st->gain;
+    int k;
+
+    for (k = 0; k < n; k++) {
+        i[k] *= g;
+        q[k] *= g;
+    }
+
+    return n;
+}
+
+static int run_shift(struct pipe_stage *st, float *i, float *q, int n) {
+    /* phasor recurrence from an exact start value every call, no drift across calls */
+    double cr = cos(st->phase), ci = sin(st->phase);
+    double rr = cos(st->dphi), ri = sin(st->dphi);
+    double t;
+    float xi, xq;
+    int k;
+
+    for (k = 0; k < n; k++) {
+        xi = i[k];
+        xq = q[k];
+        i[k] = (float) (xi * cr - xq * ci);
+        q[k] = (float) (xi * ci + xq * cr);
+        t = cr * rr - ci * ri;
+        ci = cr * ri + ci * rr;
+        cr = t;
+    }
+    st->phase = fmod(st->phase + n * st->dphi, 2 * M_PI);
+
+    return n;
+}
+
+static int run_decim(struct pipe_stage *st, float *i, float *q, int n) {
+    /* in place is safe, output k is written after input k * factor was read */
+    return iq_decimate(&st->dec, i, q, n, i, q);
+}
+
+static int add_stage(struct pipeline *p, const char *name, const char *arg, double *rate) {
+    struct pipe_stage *st;
+
+    if (p->nstages == PIPE_MAX_STAGES) {
+        fprintf(stderr, "Too many pipeline stages, at most %d\n", PIPE_MAX_STAGES);
+        return -1;
+    }
+    st = &p->stages[p->nstages];
+    memset(st, 0, sizeof(*st));
+    st->elementwise = 1;
+    st->div = p->decimation;
+
+    if (strcmp(name, "dc") == 0) {
+        st->name = "dc";
+        st->run = run_dc;
+        st->alpha = arg ? (float) atof(arg) : DEFAULT_DC_ALPHA;
+        if (st->alpha <= 0 || st->alpha >= 1)
+            return -1;
+    } else if (strcmp(name, "swap") == 0) {
+        st->name = "swap";
+        st->run = run_swap;
+    } else if (strcmp(name, "scale") == 0 && arg) {
+        st->name = "scale";
+        st->run = run_scale;
+        st->gain = (float) atof(arg);
+    } else if (strcmp(name, "shift") == 0 && arg) {
+        st->name = "shift";
+        st->run = run_shift;
+        st->dphi = -2 * M_PI * atof(arg) / *rate;
+    } else if (strcmp(name, "decim") == 0 && arg) {
+        int factor = atoi(arg);
+
+        if (factor < 2 || iq_decimator_init(&st->dec, factor, 6) != 0)
+            return -1;
+        st->name = "decim";
+        st->run = run_decim;
+        st->elementwise = 0;
+        p->decimation *= factor;
+        *rate /= factor;
+    } else {
+        return -1;
+    }
+
+    p->nstages++;
+    return 0;
+}
+
+static void build_groups(struct pipeline *p) {
+    struct pipe_group *g;
+    int s, start = 0;
+
+    p->ngroups = 0;
+    for (s = 0; s <= p->nstages; s++) {
+        if (s < p->nstages && p->stages[s].elementwise)
+            continue;
+
+        /* element-wise run [start, s), possibly empty when it only loads or stores */
+        if (s > start || p->ngroups == 0 || s == p->nstages) {
+            g = &p->groups[p->ngroups++];
+            g->first = start;
+            g->last = s;
+            g->elementwise = 1;
+            g->load = p->ngroups == 1;
+            g->store = s == p->nstages;
+        }
+        if (s < p->nstages) {
+            g = &p->groups[p->ngroups++];
+            g->first = s;
+            g->last = s + 1;
+            g->elementwise = 0;
+            g->load = g->store = 0;
+        }
+        start = s + 1;
+    }
+}
+
+int pipeline_parse(struct pipeline *p, const char *spec, uint32_t in_rate, int bits) {
+    char *copy = strdup(spec), *tok, *save = NULL, *arg;
+    double rate = in_rate;
+
+    memset(p, 0, sizeof(*p));
+    p->bits = bits;
+    p->decimation = 1;
+    p->fuse = 1;
+
+    for (tok = strtok_r(copy, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        arg = strchr(tok, ':');
+        if (arg)
+            *arg++ = '\0';
+        if (add_stage(p, tok, arg, &rate) != 0) {
+            fprintf(stderr, "Invalid pipeline stage '%s%s%s'\n", tok, arg ? ":" : "", arg ? arg : "");
+            free(copy);
+            pipeline_free(p);
+            return -1;
+        }
+    }
+    free(copy);
+
+    build_groups(p);
+    return 0;
+}
+
+int pipeline_prepare(struct pipeline *p, int max_samples) {
+    p->max_samples = max_samples;
+    p->i = malloc(max_samples * sizeof(float));
+    p->q = malloc(max_samples * sizeof(float));
+
+    return p->i && p->q ? 0 : -1;
+}
+
+static void load(const short *ibuf, const short *qbuf, float *i, float *q, int n) {
+    int k;
+
+    for (k = 0; k < n; k++) {
+        i[k] = ibuf[k];
+        q[k] = qbuf[k];
+    }
+}
+
+/* saturating round to nearest, written so that the store loops vectorise */
+static inline short clamp16(float v) {
+    v = v > 32767.0f ? 32767.0f : v;
+    v = v < -32768.0f ? -32768.0f : v;
+    return (short) (v < 0 ? v - 0.5f : v + 0.5f);
+}
+
+/* same formats as the unprocessed recording */
+static void store(int bits, const float *i, const float *q, int n, void *out, int offset) {
+    int k;
+
+    if (bits == 8) {
+        uint8_t *o = (uint8_t *) out + 2 * offset;
+        for (k = 0; k < n; k++) {
+            o[2 * k] = (unsigned char) (clamp16(i[k]) >> 8);
+            o[2 * k + 1] = (unsigned char) (clamp16(q[k]) >> 8);
+        }
+    } else {
+        short *o = (short *) out + 2 * offset;
+        for (k = 0; k < n; k++) {
+            o[2 * k] = clamp16(i[k]);
+            o[2 * k + 1] = clamp16(q[k]);
+        }
+    }
+}
+
+int pipeline_run(struct pipeline *p, const short *ibuf, const short *qbuf, int n, void *out) {
+    int g, s, off, len, tile;
+
+    for (g = 0; g < p->ngroups; g++) {
+        const struct pipe_group *gr = &p->groups[g];
+
+        if (!gr->elementwise) {
+            n = p->stages[gr->first].run(&p->stages[gr->first], p->i, p->q, n);
+            continue;
+        }
+
+        tile = p->fuse ? PIPE_TILE : n;
+        for (off = 0; off < n; off += tile) {
+            len = n - off < tile ? n - off : tile;
+            if (gr->load)
+                load(ibuf + off, qbuf + off, p->i + off, p->q + off, len);
+            for (s = gr->first; s < gr->last; s++)
+                p->stages[s].run(&p->stages[s], p->i + off, p->q + off, len);
+            if (gr->store)
+                store(p->bits, p->i + off, p->q + off, len, out, off);
+        }
+    }
+
+    return n;
+}
+
+int pipeline_overlap(const struct pipeline *p) {
+    int s, overlap = 0, dc = 0;
+
+    for (s = 0; s < p->nstages; s++) {
+        if (!p->stages[s].elementwise)
+            overlap += p->stages[s].dec.ntaps * p->stages[s].div;
+        else if (p->stages[s].run == run_dc)
+            dc = 1;
+    }
+    /* some samples for the dc estimate to start from */
+    if (dc && overlap < PIPE_DC_WARMUP)
+        overlap = PIPE_DC_WARMUP;
+
+    return (overlap + p->decimation - 1) / p->decimation * p->decimation;
+}
+
+void pipeline_restart(struct pipeline *p, uint64_t sample) {
+    struct pipe_stage *st;
+    int s;
+
+    for (s = 0; s < p->nstages; s++) {
+        st = &p->stages[s];
+        if (st->run == run_dc) {
+            st->warm = 1;
+        } else if (st->run == run_shift) {
+            st->phase = fmod(st->dphi * (double) (sample / st->div), 2 * M_PI);
+        } else if (!st->elementwise) {
+            memset(st->dec.hist_i, 0, 2 * st->dec.ntaps * sizeof(float));
+            memset(st->dec.hist_q, 0, 2 * st->dec.ntaps * sizeof(float));
+            st->dec.pos = 0;
+            st->dec.phase = 0;
+        }
+    }
+}
+
+void pipeline_describe(const struct pipeline *p, FILE *f) {
+    int g, s;
+
+    for (g = 0; g < p->ngroups; g++) {
+        const struct pipe_group *gr = &p->groups[g];
+
+        if (!gr->elementwise) {
+            fprintf(f, "%s%s", g ? " -> " : "", p->stages[gr->first].name);
+            continue;
+        }
+        fprintf(f, "%s[%s", g ? " -> " : "", gr->load ? "load" : "");
+        for (s = gr->first; s < gr->last; s++)
+            fprintf(f, "%s%s", s > gr->first || gr->load ? " " : "", p->stages[s].name);
+        fprintf(f, "%s%s]", gr->store && (gr->last > gr->first || gr->load) ? " " : "",
+                gr->store ? (p->bits == 8 ? "store8" : "store16") : "");
+    }
+    fprintf(f, "\n");
+}
+
+void pipeline_free(struct pipeline *p) {
+    int s;
+
+    for (s = 0; s < p->nstages; s++) {
+        if (!p->stages[s].elementwise)
+            iq_decimator_free(&p->stages[s].dec);
+    }
+    free(p->i);
+    free(p->q);
+    p->i = p->q = NULL;
+    p->nstages = 0;
+}
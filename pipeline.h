@@ -0,0 +1,113 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  pipeline: block processing between mir_sdr_ReadPacket and the output,
+ *  chosen on the command line as a comma separated list of stages:
+ *
+ *    dc[:alpha]      remove DC with a one pole tracker (default alpha 0.0001)
+ *    swap            exchange I and Q
+ *    scale:gain      multiply by gain
+ *    shift:hz        shift the spectrum by hz (a signal at +hz ends up at 0)
+ *    decim:n         low pass and keep every n-th sample
+ *
+ *  Samples are converted to float planes, run through the stages in place
+ *  and converted to the output format (8 or 16 bit interleaved, as the
+ *  recording). Stages that work sample by sample are fused: the group,
+ *  including the input and output conversion, runs over one small tile
+ *  that stays in L1 before moving to the next, so a group costs one pass
+ *  over memory however many stages it has. Decimation splits groups.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "iqdsp.h"
+
+#define PIPE_MAX_STAGES 16
+#define PIPE_TILE       256     /* samples, 2 planes of floats stay well inside L1 */
+#define PIPE_DC_WARMUP  PIPE_TILE /* samples the dc estimate of a restarted run starts from */
+
+struct pipe_stage {
+    const char *name;
+    int elementwise;
+    int (*run)(struct pipe_stage *st, float *i, float *q, int n);
+
+    int div;                    /* decimation before this stage */
+
+    float gain;                 /* scale */
+    float alpha;                /* dc */
+    float dc_i, dc_q;
+    int warm;                   /* dc: start from the mean of the next call, see pipeline_restart */
+    double dphi, phase;         /* shift */
+    struct iq_decimator dec;    /* decim */
+};
+
+struct pipe_group {
+    int first, last;            /* stages [first, last) */
+    int elementwise;
+    int load;                   /* converts the input, first group */
+    int store;                  /* converts to the output, last group */
+};
+
+struct pipeline {
+    struct pipe_stage stages[PIPE_MAX_STAGES];
+    int nstages;
+    struct pipe_group groups[2 * PIPE_MAX_STAGES + 1];
+    int ngroups;
+
+    int bits;                   /* output: 8 or 16 bit interleaved */
+    int decimation;             /* product of all decim stages */
+    int fuse;                   /* 0: one sweep per stage, for comparison */
+
+    float *i;
+    float *q;
+    int max_samples;
+};
+
+/* parses spec, in_rate is the sample rate entering the first stage. Returns 0 on success. */
+int pipeline_parse(struct pipeline *p, const char *spec, uint32_t in_rate, int bits);
+
+/* buffers for packets of up to max_samples. Returns 0 on success. */
+int pipeline_prepare(struct pipeline *p, int max_samples);
+
+/* processes one packet into out, returns the number of I/Q pairs written */
+int pipeline_run(struct pipeline *p, const short *ibuf, const short *qbuf, int n, void *out);
+
+/*
+ * Input samples a run must start before its first wanted output so the
+ * filters are filled: every output after that many is the same as in a
+ * continuous run. A multiple of the decimation.
+ */
+int pipeline_overlap(const struct pipeline *p);
+
+/*
+ * Forgets all state for a run starting at input sample number sample (a
+ * multiple of the decimation), so blocks can be processed independently:
+ * shift picks up the phase it has there, decimators start empty and dc
+ * starts from the mean of the first call instead of the running estimate.
+ */
+void pipeline_restart(struct pipeline *p, uint64_t sample);
+
+/* prints the stages, fused groups in brackets */
+void pipeline_describe(const struct pipeline *p, FILE *f);
+
+void pipeline_free(struct pipeline *p);
+
+#endif
@@ -0,0 +1,289 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pktqueue.h"
+#include "trace.h"
+
+static const char *policy_names[] = {"oldest", "newest", "decimate", "block"};
+
+int pktq_parse_policy(const char *name) {
+    int i;
+
+    for (i = 0; i < (int) (sizeof(policy_names) / sizeof(policy_names[0])); i++) {
+        if (strcmp(name, policy_names[i]) == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+const char *pktq_policy_name(enum pktq_policy policy) {
+    return policy_names[policy];
+}
+
+void pktq_init(struct pkt_queue *q, enum pktq_policy policy, size_t max_bytes, unsigned int max_latency_ms) {
+    memset(q, 0, sizeof(*q));
+    q->policy = policy;
+    q->max_bytes = max_bytes;
+    q->max_latency_ns = (uint64_t) max_latency_ms * 1000000;
+    q->decimation = 1;
+    pthread_mutex_init(&q->mutex, NULL);
+    pthread_cond_init(&q->data, NULL);
+    pthread_cond_init(&q->space, NULL);
+}
+
+static uint64_t realtime_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* a packet of len bytes read at now does not fit */
+static int over(const struct pkt_queue *q, size_t len, uint64_t now) {
+    if (!q->head)
+        return 0;
+    if (q->bytes + len > q->max_bytes)
+        return 1;
+
+    return q->max_latency_ns && now - q->head->time_ns > q->max_latency_ns;
+}
+
+static void drop_oldest(struct pkt_queue *q) {
+    struct llist *old = q->head;
+    uint32_t pairs = old->dropped + (uint32_t) (old->len / 2) * old->decimation;
+
+    q->head = old->next;
+    if (q->head)
+        q->head->dropped += pairs;
+    else {
+        q->tail = NULL;
+        q->pending_drop += pairs;
+    }
+    q->bytes -= old->len;
+    q->stats.dropped_packets++;
+    q->stats.dropped_bytes += old->len;
+    trace_instant("dropped oldest", (int64_t) old->len);
+
+    free(old->data);
+    free(old);
+}
+
+/*
+ * averages factor pairs into one, in place. The stream holds two's complement bytes, see sdrplay_rx.
+ * Pairs short of a last full average are left out, pktq_push accounts for them.
+ */
+static size_t average_pairs(char *data, size_t len, uint32_t factor) {
+    const signed char *in = (const signed char *) data;
+    size_t pairs = len / 2 / factor, k;
+    uint32_t j;
+    int si, sq;
+
+    for (k = 0; k < pairs; k++) {
+        si = sq = 0;
+        for (j = 0; j < factor; j++) {
+            si += in[2 * (k * factor + j)];
+            sq += in[2 * (k * factor + j) + 1];
+        }
+        data[2 * k] = (char) (si / (int) factor);
+        data[2 * k + 1] = (char) (sq / (int) factor);
+    }
+
+    return pairs * 2;
+}
+
+static void wait_for_space(struct pkt_queue *q, size_t len, uint64_t now) {
+    struct timespec deadline;
+    uint64_t until, start = realtime_ns(), t = trace_begin();
+
+    /* as long as the oldest packet stays within the latency bound (1 s without one) */
+    until = q->max_latency_ns ? q->head->time_ns + q->max_latency_ns : now + 1000000000ULL;
+    deadline.tv_sec = (time_t) (until / 1000000000ULL);
+    deadline.tv_nsec = (long) (until % 1000000000ULL);
+
+    while (over(q, len, now)) {
+        if (pthread_cond_timedwait(&q->space, &q->mutex, &deadline) == ETIMEDOUT)
+            break;
+        now = realtime_ns();
+    }
+    q->stats.blocked_ns += realtime_ns() - start;
+    trace_end("blocked", t, 0);
+}
+
+void pktq_push(struct pkt_queue *q, const unsigned char *buf, size_t len, uint64_t sample, uint64_t time_ns,
+               int shift) {
+    struct llist *rpt;
+    uint32_t leftover = 0;
+    uint64_t t = trace_begin();
+
+    pthread_mutex_lock(&q->mutex);
+    trace_end("queue lock", t, 0);
+    q->stats.packets++;
+
+    switch (q->policy) {
+        case PKTQ_DROP_NEWEST:
+            if (over(q, len, time_ns)) {
+                q->pending_drop += (uint32_t) (len / 2);
+                q->stats.dropped_packets++;
+                q->stats.dropped_bytes += len;
+                pthread_mutex_unlock(&q->mutex);
+                trace_instant("dropped newest", (int64_t) len);
+                return;
+            }
+            break;
+        case PKTQ_DECIMATE:
+            /* halve the rate while over half full, back up below an eighth */
+            if (q->bytes > q->max_bytes / 2 && q->decimation < PKTQ_MAX_DECIMATION) {
+                q->decimation *= 2;
+                trace_instant("decimation", q->decimation);
+            } else if (q->bytes < q->max_bytes / 8 && q->decimation > 1) {
+                q->decimation /= 2;
+                trace_instant("decimation", q->decimation);
+            }
+            break;
+        case PKTQ_BLOCK:
+            if (over(q, len, time_ns))
+                wait_for_space(q, len, time_ns);
+            break;
+        default:
+            break;
+    }
+
+    rpt = malloc(sizeof(struct llist));
+    rpt->data = malloc(len);
+    memcpy(rpt->data, buf, len);
+    rpt->len = len;
+    rpt->sample = sample;
+    rpt->time_ns = time_ns;
+    rpt->decimation = 1;
+    rpt->shift = (uint32_t) shift;
+    if (q->policy == PKTQ_DECIMATE && q->decimation > 1) {
+        rpt->len = average_pairs(rpt->data, len, q->decimation);
+        rpt->decimation = q->decimation;
+        leftover = (uint32_t) (len / 2 % q->decimation);
+        q->stats.decimated_packets++;
+    }
+    if (rpt->len == 0) {
+        /* shorter than one average, nothing to queue: all of it is missing before the next packet */
+        q->pending_drop += leftover;
+        q->stats.dropped_bytes += 2 * leftover;
+        free(rpt->data);
+        free(rpt);
+        pthread_mutex_unlock(&q->mutex);
+        return;
+    }
+    rpt->next = NULL;
+
+    while (over(q, rpt->len, time_ns))
+        drop_oldest(q);
+
+    rpt->dropped = q->pending_drop;
+    /* the pairs the average left out are missing right before the next packet */
+    q->pending_drop = leftover;
+    q->stats.dropped_bytes += 2 * leftover;
+    if (q->tail)
+        q->tail->next = rpt;
+    else
+        q->head = rpt;
+    q->tail = rpt;
+    q->bytes += rpt->len;
+    if (q->bytes > q->stats.peak_bytes)
+        q->stats.peak_bytes = q->bytes;
+
+    pthread_cond_signal(&q->data);
+    pthread_mutex_unlock(&q->mutex);
+}
+
+struct llist *pktq_take(struct pkt_queue *q, size_t max_bytes, int timeout_ms) {
+    struct llist *list, *last;
+    struct timespec deadline;
+    uint64_t until;
+    size_t taken;
+
+    pthread_mutex_lock(&q->mutex);
+    if (!q->head && timeout_ms > 0) {
+        until = realtime_ns() + (uint64_t) timeout_ms * 1000000;
+        deadline.tv_sec = (time_t) (until / 1000000000ULL);
+        deadline.tv_nsec = (long) (until % 1000000000ULL);
+        while (!q->head) {
+            if (pthread_cond_timedwait(&q->data, &q->mutex, &deadline) == ETIMEDOUT)
+                break;
+        }
+    }
+
+    list = q->head;
+    if (!list) {
+        pthread_mutex_unlock(&q->mutex);
+        return NULL;
+    }
+
+    last = list;
+    taken = list->len;
+    while (last->next && (max_bytes == 0 || taken + last->next->len <= max_bytes)) {
+        last = last->next;
+        taken += last->len;
+    }
+    q->head = last->next;
+    if (!q->head)
+        q->tail = NULL;
+    last->next = NULL;
+    q->bytes -= taken;
+
+    pthread_cond_signal(&q->space);
+    pthread_mutex_unlock(&q->mutex);
+
+    return list;
+}
+
+void pktq_release(struct llist *list) {
+    struct llist *next;
+
+    while (list) {
+        next = list->next;
+        free(list->data);
+        free(list);
+        list = next;
+    }
+}
+
+void pktq_clear(struct pkt_queue *q) {
+    struct llist *list;
+
+    pthread_mutex_lock(&q->mutex);
+    list = q->head;
+    q->head = q->tail = NULL;
+    q->bytes = 0;
+    q->decimation = 1;
+    q->pending_drop = 0;
+    memset(&q->stats, 0, sizeof(q->stats));
+    pthread_mutex_unlock(&q->mutex);
+
+    pktq_release(list);
+}
+
+void pktq_destroy(struct pkt_queue *q) {
+    pktq_clear(q);
+    pthread_mutex_destroy(&q->mutex);
+    pthread_cond_destroy(&q->data);
+    pthread_cond_destroy(&q->space);
+}
@@ -0,0 +1,113 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  pktqueue: the packet queue between a capture thread and the thread
+ *  sending to a client. Its memory is capped in bytes and the age of the
+ *  oldest packet in milliseconds; what happens when a slow client lets it
+ *  fill is a policy chosen per receiver:
+ *
+ *    oldest     drop the oldest packets to make room (default)
+ *    newest     drop the incoming packets
+ *    decimate   average pairs of samples while the queue is over half
+ *               full, halving the rate each step (down to 1/16), drop
+ *               the oldest when that is not enough
+ *    block      hold the capture thread until there is room or the oldest
+ *               packet reaches the latency bound, then drop the oldest
+ *
+ *  Every drop is counted. A packet remembers how many I/Q pairs were
+ *  dropped right before it, so the sender can tell the client where the
+ *  gaps are.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PKTQUEUE_H
+#define PKTQUEUE_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define PKTQ_MAX_DECIMATION     16
+
+enum pktq_policy {
+    PKTQ_DROP_OLDEST,
+    PKTQ_DROP_NEWEST,
+    PKTQ_DECIMATE,
+    PKTQ_BLOCK
+};
+
+struct llist {
+    char *data;
+    size_t len;
+    uint64_t sample;        /* number of the first I/Q pair since capture start */
+    uint64_t time_ns;       /* CLOCK_REALTIME when the packet was read */
+    uint32_t dropped;       /* I/Q pairs dropped by the queue right before this packet */
+    uint32_t decimation;    /* 1, or the factor the packet was averaged down by */
+    uint32_t shift;         /* the bytes are the 16 bit samples >> shift, 8 unless scaled (play_tcp -q) */
+    struct llist *next;
+};
+
+struct pktq_stats {
+    uint64_t packets;           /* pushed */
+    uint64_t dropped_packets;
+    uint64_t dropped_bytes;
+    uint64_t decimated_packets;
+    uint64_t blocked_ns;        /* capture thread time spent waiting (block) */
+    size_t peak_bytes;
+};
+
+struct pkt_queue {
+    struct llist *head, *tail;
+    size_t bytes;
+
+    enum pktq_policy policy;
+    size_t max_bytes;
+    uint64_t max_latency_ns;    /* 0: no bound */
+    uint32_t decimation;        /* current factor of the decimate policy */
+    uint32_t pending_drop;      /* pairs dropped since the last queued packet */
+
+    struct pktq_stats stats;
+    pthread_mutex_t mutex;
+    pthread_cond_t data;        /* signalled on push */
+    pthread_cond_t space;       /* signalled on take, block policy */
+};
+
+/* "oldest", "newest", "decimate" or "block", -1 if unknown */
+int pktq_parse_policy(const char *name);
+
+const char *pktq_policy_name(enum pktq_policy policy);
+
+void pktq_init(struct pkt_queue *q, enum pktq_policy policy, size_t max_bytes, unsigned int max_latency_ms);
+
+/* copies one packet of 8 bit I/Q pairs into the queue, applying the policy */
+void pktq_push(struct pkt_queue *q, const unsigned char *buf, size_t len, uint64_t sample, uint64_t time_ns,
+               int shift);
+
+/*
+ * Detaches the oldest packets, at least one and at most max_bytes (all
+ * of them when 0). Waits up to timeout_ms for data, NULL if none came.
+ */
+struct llist *pktq_take(struct pkt_queue *q, size_t max_bytes, int timeout_ms);
+
+/* frees a list returned by pktq_take */
+void pktq_release(struct llist *list);
+
+/* drops everything queued and resets the statistics, for a new client */
+void pktq_clear(struct pkt_queue *q);
+
+void pktq_destroy(struct pkt_queue *q);
+
+#endif
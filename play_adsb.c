@@ -0,0 +1,595 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  play_adsb, a Mode S / ADS-B receiver in the spirit of rtl_adsb: the RSP
+ *  captures 2 MS/s at 1090 MHz, modes finds and checks the messages, they
+ *  go out as AVR text ("*8D4840D6...;") or Beast binary frames to a file,
+ *  stdout or the TCP clients of -p, as dump1090 and its feeders expect.
+ *
+ *  -i decodes a recording of play_sdr (8 or 16 bit, -x) as fast as it can
+ *  instead, and tells how many messages it found and how much faster than
+ *  real time that went.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "modes.h"
+#include "rt.h"
+#include "trace.h"
+
+#ifndef _WIN32
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "mirsdrapi-rsp.h"
+
+#else
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#include "mir_sdr.h"
+#endif
+
+#define DEFAULT_FREQUENCY   1090000000
+#define DEFAULT_GAIN        40
+#define BLOCK_PAIRS         16384   /* decoded at once, 8 ms */
+#define MAX_CLIENTS         16
+#define OUT_CLIENT_MAX      (256 * 1024)    /* a client this far behind is dropped */
+
+enum format {
+    FORMAT_AVR,                 /* *hex; */
+    FORMAT_AVRMLAT,             /* @timestamp hex; */
+    FORMAT_BEAST
+};
+
+struct output {
+    enum format format;
+    FILE *file;                 /* NULL with -p */
+    char *buf;
+    size_t len, cap;
+    int listen_fd;
+    int clients[MAX_CLIENTS];
+    int nclients;
+};
+
+static int do_exit = 0;
+
+double atofs(char *s)
+/* standard suffixes */
+{
+    char last;
+    int len;
+    double suff = 1.0;
+    len = strlen(s);
+    last = s[len - 1];
+    s[len - 1] = '\0';
+    switch (last) {
+        case 'g':
+        case 'G':
+            suff *= 1e3;
+        case 'm':
+        case 'M':
+            suff *= 1e3;
+        case 'k':
+        case 'K':
+            suff *= 1e3;
+            suff *= atof(s);
+            s[len - 1] = last;
+            return suff;
+    }
+    s[len - 1] = last;
+    return atof(s);
+}
+
+void usage(void) {
+    fprintf(stderr,
+            "play_adsb, a Mode S / ADS-B decoder for SDRplay RSP receivers (rtl_adsb port)\n\n"
+                    "Usage:\t[-f frequency (default: 1090000000 Hz)]\n"
+                    "\t[-F output format: avr (*hex;), avrmlat (@timestamp hex;) or beast (default: avr)]\n"
+                    "\t[-e bits repaired in DF17/18 messages, 0 to 2 (default: 1)]\n"
+                    "\t[-p port: serve the messages to TCP clients instead of writing them out\n"
+                    "\t    (avr usually on 30002, beast on 30005)]\n"
+                    "\t[-i file: decode a 2 MS/s play_sdr recording instead of the RSP, as fast as possible]\n"
+                    "\t[-x bit resolution of the -i recording (default: 8, possible values: 8 16)]\n"
+                    "\t[-g gain reduction (default: 40)]\n"
+                    "\t[-L RSP LNA enable (default: 0, disabled)]\n"
+                    "\t[-v Verbose mode, prints debug information. Default 0, 1 = enabled\n"
+                    "\t[-E trace.json[:seconds] record what each thread spends its time on, for chrome://tracing or\n"
+                    "\t    ui.perfetto.dev (default: off)]\n"
+                    "\t[filename (a '-' or none writes to stdout)]\n\n");
+    exit(1);
+}
+
+#ifdef _WIN32
+BOOL WINAPI
+sighandler(int signum)
+{
+    if (CTRL_C_EVENT == signum) {
+        fprintf(stderr, "Signal caught, exiting!\n");
+        do_exit = 1;
+        return TRUE;
+    }
+    return FALSE;
+}
+#else
+
+static void sighandler(int signum) {
+    fprintf(stderr, "Signal (%d) caught, exiting!\n", signum);
+    do_exit = 1;
+}
+
+#endif
+
+static int reserve(struct output *out, size_t n) {
+    char *p;
+    size_t cap;
+
+    if (out->len + n <= out->cap)
+        return 0;
+    cap = out->cap ? out->cap * 2 : 4096;
+    while (cap < out->len + n)
+        cap *= 2;
+    p = realloc(out->buf, cap);
+    if (!p)
+        return -1;
+    out->buf = p;
+    out->cap = cap;
+    return 0;
+}
+
+/* Beast frames mark their start with 0x1a, one in the payload is doubled */
+static void beast_put(struct output *out, uint8_t c) {
+    out->buf[out->len++] = (char) c;
+    if (c == 0x1a)
+        out->buf[out->len++] = (char) c;
+}
+
+static void on_message(void *ctx, const struct modes_msg *msg) {
+    static const char hex[] = "0123456789ABCDEF";
+    struct output *out = ctx;
+    int bytes = msg->bits / 8, k;
+    /* the 12 MHz clock of the Beast and of dump1090's MLAT timestamps */
+    uint64_t ts = msg->sample * (12000000 / MODES_RATE);
+
+    if (reserve(out, 2 * (2 + 6 + 1 + MODES_LONG_BITS / 8) + 2) != 0)
+        return;
+
+    switch (out->format) {
+        case FORMAT_AVRMLAT:
+            out->buf[out->len++] = '@';
+            for (k = 44; k >= 0; k -= 4)
+                out->buf[out->len++] = hex[ts >> k & 0xf];
+        /* fall through */
+        case FORMAT_AVR:
+            if (out->format == FORMAT_AVR)
+                out->buf[out->len++] = '*';
+            for (k = 0; k < bytes; k++) {
+                out->buf[out->len++] = hex[msg->data[k] >> 4];
+                out->buf[out->len++] = hex[msg->data[k] & 0xf];
+            }
+            out->buf[out->len++] = ';';
+            out->buf[out->len++] = '\n';
+            break;
+        case FORMAT_BEAST:
+            out->buf[out->len++] = 0x1a;
+            out->buf[out->len++] = bytes == 7 ? '2' : '3';
+            for (k = 40; k >= 0; k -= 8)
+                beast_put(out, (uint8_t) (ts >> k));
+            beast_put(out, (uint8_t) (msg->level * 255.0));
+            for (k = 0; k < bytes; k++)
+                beast_put(out, msg->data[k]);
+            break;
+    }
+}
+
+#ifndef _WIN32
+
+static int serve(struct output *out, int port) {
+    struct sockaddr_in local;
+    int r = 1;
+
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_port = htons(port);
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    out->listen_fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    setsockopt(out->listen_fd, SOL_SOCKET, SO_REUSEADDR, (char *) &r, sizeof(int));
+    if (bind(out->listen_fd, (struct sockaddr *) &local, sizeof(local)) != 0 || listen(out->listen_fd, 4) != 0) {
+        fprintf(stderr, "Failed to listen on port %d\n", port);
+        close(out->listen_fd);
+        return -1;
+    }
+    r = fcntl(out->listen_fd, F_GETFL, 0);
+    fcntl(out->listen_fd, F_SETFL, r | O_NONBLOCK);
+    fprintf(stderr, "Serving %s on port %d\n", out->format == FORMAT_BEAST ? "beast" : "avr", port);
+    return 0;
+}
+
+static void drop_client(struct output *out, int k, const char *why) {
+    fprintf(stderr, "[client %d] %s, closed\n", out->clients[k], why);
+    close(out->clients[k]);
+    out->clients[k] = out->clients[--out->nclients];
+}
+
+/* new clients in, the block's messages out; a client that cannot take them is dropped */
+static void send_clients(struct output *out) {
+    int s, k, r = 0;
+    ssize_t sent;
+
+    while ((s = accept(out->listen_fd, NULL, NULL)) >= 0) {
+        if (out->nclients == MAX_CLIENTS) {
+            fprintf(stderr, "[client %d] turned away, %d already\n", s, MAX_CLIENTS);
+            close(s);
+            continue;
+        }
+        r = OUT_CLIENT_MAX;
+        setsockopt(s, SOL_SOCKET, SO_SNDBUF, (char *) &r, sizeof(r));
+        out->clients[out->nclients++] = s;
+        fprintf(stderr, "[client %d] connected\n", s);
+    }
+
+    for (k = 0; k < out->nclients; k++) {
+        if (out->len == 0)
+            break;
+        sent = send(out->clients[k], out->buf, out->len, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent == (ssize_t) out->len)
+            continue;
+        drop_client(out, k--, sent < 0 && errno != EAGAIN ? "gone" : "too slow");
+    }
+}
+
+#endif
+
+/* the messages of one block; returns -1 once the output is gone */
+static int flush_output(struct output *out) {
+    int r = 0;
+
+    if (out->file) {
+        if (out->len && fwrite(out->buf, 1, out->len, out->file) != out->len)
+            r = -1;
+        fflush(out->file);
+    }
+#ifndef _WIN32
+    else {
+        send_clients(out);
+    }
+#endif
+    out->len = 0;
+    return r;
+}
+
+static void print_stats(const struct modes_stats *s, int max_fix) {
+    int df;
+
+    fprintf(stderr, "%.1f s of signal: %lu preambles (%lu past the first test), %lu messages, %lu failed the CRC\n",
+            (double) s->samples / MODES_RATE, (unsigned long) s->preambles, (unsigned long) s->candidates,
+            (unsigned long) s->good, (unsigned long) s->bad_crc);
+    if (max_fix > 0)
+        fprintf(stderr, "repaired: %lu with one bit, %lu with two\n", (unsigned long) s->fixed[1],
+                (unsigned long) s->fixed[2]);
+    for (df = 0; df < 32; df++) {
+        if (s->by_df[df])
+            fprintf(stderr, "  DF%-2d %lu\n", df, (unsigned long) s->by_df[df]);
+    }
+}
+
+/* a recording of play_sdr, interleaved I/Q; the rate is taken for granted */
+static int replay(const char *path, int bits, struct modes *m, struct output *out) {
+    FILE *in;
+    void *raw;
+    short *ibuf, *qbuf;
+    size_t got;
+    uint64_t start, t, elapsed;
+    int k, r = 0;
+
+    in = strcmp(path, "-") == 0 ? stdin : fopen(path, "rb");
+    if (!in) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return -1;
+    }
+    raw = malloc((size_t) BLOCK_PAIRS * 2 * (bits / 8));
+    ibuf = malloc(BLOCK_PAIRS * sizeof(short));
+    qbuf = malloc(BLOCK_PAIRS * sizeof(short));
+
+    start = trace_now();
+    while (!do_exit) {
+        got = fread(raw, 2 * (bits / 8), BLOCK_PAIRS, in);
+        if (got == 0)
+            break;
+        t = trace_begin();
+        if (bits == 8) {
+            const int8_t *b = raw;
+            for (k = 0; k < (int) got; k++) {
+                ibuf[k] = (short) (b[2 * k] * 256);
+                qbuf[k] = (short) (b[2 * k + 1] * 256);
+            }
+        } else {
+            const short *s = raw;
+            for (k = 0; k < (int) got; k++) {
+                ibuf[k] = s[2 * k];
+                qbuf[k] = s[2 * k + 1];
+            }
+        }
+        modes_feed(m, ibuf, qbuf, (int) got, on_message, out);
+        trace_end("decode", t, got);
+        if (flush_output(out) != 0) {
+            r = -1;
+            break;
+        }
+    }
+    elapsed = trace_now() - start;
+
+    fprintf(stderr, "decoded in %.2f s, %.1f times real time, %.0f messages/s of signal\n", elapsed / 1e9,
+            elapsed ? (double) m->stats.samples / MODES_RATE / (elapsed / 1e9) : 0.0,
+            m->stats.samples ? m->stats.good / ((double) m->stats.samples / MODES_RATE) : 0.0);
+
+    free(raw);
+    free(ibuf);
+    free(qbuf);
+    if (in != stdin)
+        fclose(in);
+    return r;
+}
+
+int main(int argc, char **argv) {
+#ifndef _WIN32
+    struct sigaction sigact, sigign;
+#endif
+    char *filename = NULL, *replayPath = NULL;
+    mir_sdr_ErrT r;
+    int opt;
+    int gain = DEFAULT_GAIN;
+    int rspLNA = 0;
+    int verbose = 0;
+    char *traceSpec = NULL;
+    uint32_t frequency = DEFAULT_FREQUENCY;
+    int maxFix = 1, port = 0, fileBits = 8;
+    struct output out;
+    struct modes m;
+
+    short *ibuf, *qbuf, *bi, *bq;
+    int samplesPerPacket, grChanged, fsChanged, rfChanged;
+    unsigned int firstSample, nextSample = 0;
+    unsigned long packets = 0, lossEvents = 0, lostSamples = 0;
+    int fill = 0, blockPairs;
+    uint64_t t, busy = 0, start;
+
+    memset(&out, 0, sizeof(out));
+    out.format = FORMAT_AVR;
+    out.listen_fd = -1;
+
+    while ((opt = getopt(argc, argv, "f:F:e:p:i:x:g:L:v:E:")) != -1) {
+        switch (opt) {
+            case 'f':
+                frequency = (uint32_t) atofs(optarg);
+                break;
+            case 'F':
+                if (strcmp(optarg, "avr") == 0)
+                    out.format = FORMAT_AVR;
+                else if (strcmp(optarg, "avrmlat") == 0)
+                    out.format = FORMAT_AVRMLAT;
+                else if (strcmp(optarg, "beast") == 0)
+                    out.format = FORMAT_BEAST;
+                else {
+                    fprintf(stderr, "Invalid output format (-F) !\n");
+                    usage();
+                }
+                break;
+            case 'e':
+                maxFix = atoi(optarg);
+                if (maxFix < 0 || maxFix > 2) {
+                    fprintf(stderr, "Invalid bits to repair (-e) !\n");
+                    usage();
+                }
+                break;
+            case 'p':
+                port = atoi(optarg);
+                if (port <= 0 || port > 65535) {
+                    fprintf(stderr, "Invalid port (-p) !\n");
+                    usage();
+                }
+                break;
+            case 'i':
+                replayPath = optarg;
+                break;
+            case 'x':
+                fileBits = atoi(optarg);
+                if (fileBits != 8 && fileBits != 16) {
+                    fprintf(stderr, "Invalid recording resolution (-x) !\n");
+                    usage();
+                }
+                break;
+            case 'g':
+                gain = (int) atof(optarg);
+                break;
+            case 'L':
+                rspLNA = atoi(optarg);
+                break;
+            case 'v':
+                verbose = atoi(optarg);
+                break;
+            case 'E':
+                traceSpec = optarg;
+                break;
+            default:
+                usage();
+                break;
+        }
+    }
+
+    if (argc > optind)
+        filename = argv[optind];
+    if (port && filename) {
+        fprintf(stderr, "Messages go either to the TCP clients (-p) or to a file.\n");
+        usage();
+    }
+
+    if (port) {
+#ifndef _WIN32
+        if (serve(&out, port) != 0)
+            exit(1);
+#else
+        fprintf(stderr, "TCP output (-p) is not supported on Windows.\n");
+        exit(1);
+#endif
+    } else if (!filename || strcmp(filename, "-") == 0) {
+        out.file = stdout;
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    } else {
+        out.file = fopen(filename, "wb");
+        if (!out.file) {
+            fprintf(stderr, "Failed to open %s\n", filename);
+            exit(1);
+        }
+    }
+
+    if (modes_init(&m, BLOCK_PAIRS, maxFix) != 0) {
+        fprintf(stderr, "Failed to set up the decoder\n");
+        exit(1);
+    }
+
+#ifndef _WIN32
+    sigact.sa_handler = sighandler;
+    sigemptyset(&sigact.sa_mask);
+    sigact.sa_flags = 0;
+    sigign.sa_handler = SIG_IGN;
+    sigemptyset(&sigign.sa_mask);
+    sigign.sa_flags = 0;
+    sigaction(SIGINT, &sigact, NULL);
+    sigaction(SIGTERM, &sigact, NULL);
+    sigaction(SIGQUIT, &sigact, NULL);
+    /* a reader or client went away: the write fails instead */
+    sigaction(SIGPIPE, &sigign, NULL);
+#else
+    SetConsoleCtrlHandler( (PHANDLER_ROUTINE) sighandler, TRUE );
+#endif
+
+    if (traceSpec && trace_open(traceSpec) != 0) {
+        fprintf(stderr, "Invalid trace file (-E) !\n");
+        exit(1);
+    }
+
+    if (replayPath) {
+        replay(replayPath, fileBits, &m, &out);
+        print_stats(&m.stats, maxFix);
+        goto out;
+    }
+
+    mir_sdr_SetParam(201, 1);
+    mir_sdr_SetParam(202, rspLNA == 1 ? 0 : 1);
+    r = mir_sdr_Init(gain, MODES_RATE / 1e6, frequency / 1e6, mir_sdr_BW_1_536, mir_sdr_IF_Zero, &samplesPerPacket);
+    if (r != mir_sdr_Success) {
+        fprintf(stderr, "Failed to open SDRplay RSP device.\n");
+        exit(1);
+    }
+    mir_sdr_SetDcMode(4, 0);
+    mir_sdr_SetDcTrackTime(63);
+
+    /* whole packets per block */
+    blockPairs = BLOCK_PAIRS > samplesPerPacket ? BLOCK_PAIRS / samplesPerPacket * samplesPerPacket : samplesPerPacket;
+    if (blockPairs > BLOCK_PAIRS) {
+        modes_free(&m);
+        if (modes_init(&m, blockPairs, maxFix) != 0) {
+            fprintf(stderr, "Failed to set up the decoder\n");
+            exit(1);
+        }
+    }
+    ibuf = malloc(samplesPerPacket * sizeof(short));
+    qbuf = malloc(samplesPerPacket * sizeof(short));
+    bi = malloc(blockPairs * sizeof(short));
+    bq = malloc(blockPairs * sizeof(short));
+
+    rt_apply_thread(RT_CAPTURE, "play_adsb");
+
+    fprintf(stderr, "Receiving %u Hz at %d S/s, %d samples per block\n", frequency, MODES_RATE, blockPairs);
+    start = trace_now();
+    while (!do_exit) {
+        t = trace_begin();
+        r = mir_sdr_ReadPacket(ibuf, qbuf, &firstSample, &grChanged, &rfChanged, &fsChanged);
+        trace_end("ReadPacket", t, samplesPerPacket);
+
+        if (r != mir_sdr_Success) {
+            fprintf(stderr, "WARNING: ReadPacket failed.\n");
+            break;
+        }
+
+        /* the API numbers samples, a jump means the device buffers overflowed */
+        if (packets++ > 0 && firstSample != nextSample && !fsChanged) {
+            lossEvents++;
+            lostSamples += firstSample - nextSample;
+            trace_instant("samples lost", firstSample - nextSample);
+            if (verbose == 1)
+                fprintf(stderr, "[DEBUG] lost %u samples\n", firstSample - nextSample);
+        }
+        nextSample = firstSample + samplesPerPacket;
+
+        memcpy(bi + fill, ibuf, samplesPerPacket * sizeof(short));
+        memcpy(bq + fill, qbuf, samplesPerPacket * sizeof(short));
+        fill += samplesPerPacket;
+        if (fill < blockPairs)
+            continue;
+        fill = 0;
+
+        t = trace_now();
+        modes_feed(&m, bi, bq, blockPairs, on_message, &out);
+        busy += trace_now() - t;
+        if (trace_on)
+            trace_record('X', "decode", t, trace_now() - t, blockPairs);
+        if (flush_output(&out) != 0)
+            break;
+    }
+
+    mir_sdr_Uninit();
+
+    print_stats(&m.stats, maxFix);
+    if (trace_now() > start)
+        fprintf(stderr, "decoding took %.1f %% of the time\n", 100.0 * busy / (trace_now() - start));
+    fprintf(stderr, "%lu sample-loss events, %lu samples lost\n", lossEvents, lostSamples);
+
+    free(ibuf);
+    free(qbuf);
+    free(bi);
+    free(bq);
+
+out:
+    modes_free(&m);
+#ifndef _WIN32
+    for (fill = 0; fill < out.nclients; fill++)
+        close(out.clients[fill]);
+    if (out.listen_fd >= 0)
+        close(out.listen_fd);
+#endif
+    free(out.buf);
+    if (out.file && out.file != stdout)
+        fclose(out.file);
+
+    trace_close();
+    if (do_exit)
+        fprintf(stderr, "\nUser cancel, exiting...\n");
+    return 0;
+}
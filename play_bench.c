@@ -0,0 +1,168 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  play_bench, measures a processing pipeline (play_sdr -D) on synthetic
+ *  packets, once with the element-wise stages fused into one pass per
+ *  group and once with one memory sweep per stage. With -j, also through
+ *  the DSP worker pool (play_sdr -j) for each thread count in the list.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "dsppool.h"
+#include "pipeline.h"
+
+#define DEFAULT_SPEC    "dc,shift:250000,scale:2"
+#define DEFAULT_PACKET  336
+#define DEFAULT_SAMPLES 50000000
+
+void usage(void) {
+    fprintf(stderr,
+            "play_bench, throughput of a play_sdr processing pipeline\n\n"
+                    "Usage:\t[-p pipeline (default: " DEFAULT_SPEC ")]\n"
+                    "\t[-n samples per packet (default: 336, as the RSP)]\n"
+                    "\t[-N total samples per run (default: 50000000)]\n"
+                    "\t[-x output bits, 8 or 16 (default: 8)]\n"
+                    "\t[-j comma separated DSP thread counts to measure, e.g. 1,2,4 (default: none)]\n\n");
+    exit(1);
+}
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double run(const char *spec, int fuse, int packet, long total, int bits, short *ibuf, short *qbuf,
+                  void *out) {
+    struct pipeline p;
+    double start;
+    long done;
+    int sink = 0;
+
+    if (pipeline_parse(&p, spec, 2048000, bits) != 0 || pipeline_prepare(&p, packet) != 0)
+        exit(1);
+    p.fuse = fuse;
+    if (fuse)
+        pipeline_describe(&p, stderr);
+
+    start = now();
+    for (done = 0; done < total; done += packet)
+        sink += pipeline_run(&p, ibuf, qbuf, packet, out);
+    start = now() - start;
+
+    pipeline_free(&p);
+    return sink ? total / start / 1e6 : 0;
+}
+
+static int count_bytes(void *ctx, const void *data, size_t len) {
+    (void) data;
+    *(size_t *) ctx += len;
+    return 0;
+}
+
+static double run_pool(const char *spec, int threads, int packet, long total, int bits, short *ibuf, short *qbuf) {
+    struct dsp_pool pool;
+    size_t bytes = 0;
+    double start;
+    long done;
+
+    if (dsp_pool_open(&pool, spec, 2048000, bits, threads) != 0)
+        exit(1);
+
+    start = now();
+    for (done = 0; done < total; done += packet)
+        dsp_pool_feed(&pool, ibuf, qbuf, packet, count_bytes, &bytes);
+    dsp_pool_close(&pool, count_bytes, &bytes);
+    start = now() - start;
+
+    fprintf(stderr, "%d threads: blocks of %d samples plus %d overlap, %llu stolen\n", threads,
+            pool.block_samples, pool.overlap, (unsigned long long) pool.stolen);
+    return bytes ? total / start / 1e6 : 0;
+}
+
+int main(int argc, char **argv) {
+    const char *spec = DEFAULT_SPEC;
+    char *threadList = NULL, *tok, *save = NULL;
+    int packet = DEFAULT_PACKET;
+    long total = DEFAULT_SAMPLES;
+    int bits = 8;
+    short *ibuf, *qbuf;
+    void *out;
+    double fused, unfused, pooled;
+    int opt, k, threads;
+
+    while ((opt = getopt(argc, argv, "p:n:N:x:j:")) != -1) {
+        switch (opt) {
+            case 'p':
+                spec = optarg;
+                break;
+            case 'n':
+                packet = atoi(optarg);
+                break;
+            case 'N':
+                total = atol(optarg);
+                break;
+            case 'x':
+                bits = atoi(optarg);
+                break;
+            case 'j':
+                threadList = optarg;
+                break;
+            default:
+                usage();
+                break;
+        }
+    }
+    if (packet < 1 || total < packet || (bits != 8 && bits != 16))
+        usage();
+
+    ibuf = malloc(packet * sizeof(short));
+    qbuf = malloc(packet * sizeof(short));
+    out = malloc(packet * 2 * sizeof(short));
+    for (k = 0; k < packet; k++) {
+        ibuf[k] = (short) (8000 * cos(0.1 * k) + (rand() % 64) - 32);
+        qbuf[k] = (short) (8000 * sin(0.1 * k) + (rand() % 64) - 32);
+    }
+
+    unfused = run(spec, 0, packet, total, bits, ibuf, qbuf, out);
+    fused = run(spec, 1, packet, total, bits, ibuf, qbuf, out);
+
+    printf("%d samples per packet: one sweep per stage %.1f MS/s, fused %.1f MS/s (%.2fx)\n", packet, unfused,
+           fused, fused / unfused);
+
+    for (tok = threadList ? strtok_r(threadList, ",", &save) : NULL; tok; tok = strtok_r(NULL, ",", &save)) {
+        threads = atoi(tok);
+        if (threads < 1 || threads > 64) {
+            fprintf(stderr, "Invalid number of DSP threads (-j) !\n");
+            usage();
+        }
+        pooled = run_pool(spec, threads, packet, total, bits, ibuf, qbuf);
+        printf("%d DSP threads: %.1f MS/s (%.2fx the fused single thread)\n", threads, pooled, pooled / fused);
+    }
+
+    free(ibuf);
+    free(qbuf);
+    free(out);
+    return 0;
+}
@@ -0,0 +1,326 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  play_extract, cuts a time range out of a raw play_sdr recording using the
+ *  time index written with 'play_sdr -t'. The index and the recording are
+ *  mapped, so the range is found without reading the file up to it.
+ *
+ *  -w widens an 8 bit recording to 16 bit on the way out, undoing the
+ *  per-packet shifts of adaptive scaling (play_sdr -q) kept in the index.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* strptime */
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "iqz.h"
+#include "tindex.h"
+
+void usage(void) {
+    fprintf(stderr,
+            "play_extract, extracts a time range of a play_sdr recording made with -t\n\n"
+                    "Usage:\t[-s start time (default: start of the recording)]\n"
+                    "\t[-e end time (default: end of the recording)]\n"
+                    "\t[-d duration in seconds, instead of -e]\n"
+                    "\t[-x time index file (default: recording.tidx)]\n"
+                    "\t[-i list the index entries of the range instead of extracting]\n"
+                    "\t[-w write 16 bit samples, scaled back with the shifts of play_sdr -q (8 bit recordings)]\n"
+                    "\trecording [output_filename (default: '-' dumps samples to stdout)]\n\n"
+                    "Times: HH:MM[:SS[.frac]] local time on the day of the recording,\n"
+                    "       'YYYY-MM-DD HH:MM:SS[.frac]', +seconds from the start, or @unix_seconds\n\n");
+    exit(1);
+}
+
+/* returns -1 on a malformed time */
+static int parse_time(const char *s, int64_t start_ns, int64_t *out) {
+    struct tm tm, day;
+    const char *rest;
+    double frac = 0;
+    time_t t, start = (time_t) (start_ns / 1000000000);
+
+    if (s[0] == '+') {
+        *out = start_ns + (int64_t) (atof(s + 1) * 1e9);
+        return 0;
+    }
+    if (s[0] == '@') {
+        *out = (int64_t) (atof(s + 1) * 1e9);
+        return 0;
+    }
+
+    localtime_r(&start, &day);
+    memset(&tm, 0, sizeof(tm));
+    if ((rest = strptime(s, "%Y-%m-%d %H:%M:%S", &tm)) == NULL &&
+        (rest = strptime(s, "%Y-%m-%dT%H:%M:%S", &tm)) == NULL) {
+        memset(&tm, 0, sizeof(tm));
+        if ((rest = strptime(s, "%H:%M:%S", &tm)) == NULL && (rest = strptime(s, "%H:%M", &tm)) == NULL)
+            return -1;
+        tm.tm_year = day.tm_year;
+        tm.tm_mon = day.tm_mon;
+        tm.tm_mday = day.tm_mday;
+    }
+    if (*rest == '.')
+        frac = atof(rest);
+    else if (*rest != '\0')
+        return -1;
+
+    tm.tm_isdst = -1;
+    t = mktime(&tm);
+    /* a time of day before the start means the day after (recording ran past midnight) */
+    if (strchr(s, '-') == NULL && t < start)
+        t += 24 * 3600;
+
+    *out = (int64_t) t * 1000000000 + (int64_t) (frac * 1e9);
+    return 0;
+}
+
+static void print_time(FILE *f, int64_t ns) {
+    time_t t = (time_t) (ns / 1000000000);
+    struct tm tm;
+    char buf[32];
+
+    localtime_r(&t, &tm);
+    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+    fprintf(f, "%s.%03d", buf, (int) (ns % 1000000000 / 1000000));
+}
+
+static void print_entry(const struct tindex_entry *e) {
+    print_time(stderr, e->time_ns);
+    fprintf(stderr, "  sample %llu  device %llu  %u Hz  gain %d", (unsigned long long) e->sample,
+            (unsigned long long) e->device_sample, e->frequency, e->gain);
+    if (e->flags & TINDEX_START)
+        fprintf(stderr, "  start");
+    if (e->flags & TINDEX_GAP)
+        fprintf(stderr, "  gap of %llu samples", (unsigned long long) e->lost);
+    if (e->flags & TINDEX_GAIN)
+        fprintf(stderr, "  gain changed");
+    if (e->flags & TINDEX_FREQUENCY)
+        fprintf(stderr, "  frequency changed");
+    if (e->flags & TINDEX_SAMPLE_RATE)
+        fprintf(stderr, "  sample rate changed");
+    if (e->flags & TINDEX_SCALE)
+        fprintf(stderr, "  shift %u", e->shift);
+    fprintf(stderr, "\n");
+}
+
+#define WIDEN_PAIRS 65536
+
+/* samples first to last as 16 bit, each stretch with the shift of the entry it starts at */
+static int write_wide(const struct tindex_map *m, const uint8_t *data, uint64_t from, uint64_t first,
+                      uint64_t last, FILE *out) {
+    short buf[2 * WIDEN_PAIRS];
+    uint64_t i = from, pos = first, end, k, n;
+    int shift;
+
+    while (pos < last) {
+        while (i + 1 < m->count && m->entries[i + 1].sample <= pos)
+            i++;
+        shift = m->hdr->scaled ? (int) m->entries[i].shift : 8;
+        end = i + 1 < m->count && m->entries[i + 1].sample < last ? m->entries[i + 1].sample : last;
+        for (; pos < end; pos += n) {
+            n = end - pos < WIDEN_PAIRS ? end - pos : WIDEN_PAIRS;
+            for (k = 0; k < 2 * n; k++)
+                buf[k] = (short) ((int8_t) data[2 * pos + k] * (1 << shift));
+            if (fwrite(buf, 4, n, out) != n)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    struct tindex_map m;
+    struct stat st;
+    const uint8_t *data = NULL;
+    const char *startArg = NULL, *endArg = NULL;
+    char *indexname = NULL;
+    FILE *out;
+    uint64_t first, last, total, i, lost = 0;
+    int64_t start_ns, end_ns, rec_start, rec_end;
+    double duration = 0;
+    size_t pair_bytes, page = (size_t) sysconf(_SC_PAGESIZE);
+    uint64_t advise_from;
+    int opt, fd;
+    int info = 0;
+    int compressed = 0;
+    int widen = 0;
+
+    while ((opt = getopt(argc, argv, "s:e:d:x:iw")) != -1) {
+        switch (opt) {
+            case 's':
+                startArg = optarg;
+                break;
+            case 'e':
+                endArg = optarg;
+                break;
+            case 'd':
+                duration = atof(optarg);
+                break;
+            case 'x':
+                indexname = optarg;
+                break;
+            case 'i':
+                info = 1;
+                break;
+            case 'w':
+                widen = 1;
+                break;
+            default:
+                usage();
+                break;
+        }
+    }
+
+    if (argc <= optind)
+        usage();
+
+    if (!indexname) {
+        indexname = malloc(strlen(argv[optind]) + 6);
+        sprintf(indexname, "%s.tidx", argv[optind]);
+    }
+    if (tindex_map(&m, indexname) != 0 || m.count == 0) {
+        fprintf(stderr, "No usable time index, record with play_sdr -t.\n");
+        exit(1);
+    }
+    pair_bytes = m.hdr->pair_bytes;
+    if (widen && pair_bytes != 2) {
+        fprintf(stderr, "The recording has 16 bit samples already (-w).\n");
+        exit(1);
+    }
+
+    fd = open(argv[optind], O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "Failed to open %s\n", argv[optind]);
+        exit(1);
+    }
+    total = st.st_size / pair_bytes;
+
+    if (st.st_size >= 4) {
+        struct iqz_reader rd;
+        char magic[4];
+        FILE *f;
+
+        if (pread(fd, magic, 4, 0) == 4 && memcmp(magic, "IQZ1", 4) == 0 && (f = fdopen(dup(fd), "rb"))) {
+            if (iqz_reader_open(&rd, f) == 0) {
+                compressed = 1;
+                total = rd.samples;
+                iqz_reader_close(&rd);
+            }
+            fclose(f);
+        }
+    }
+
+    rec_start = m.entries[0].time_ns;
+    rec_end = m.entries[m.count - 1].time_ns +
+              (int64_t) ((total - m.entries[m.count - 1].sample) * 1e9 / m.hdr->samp_rate);
+
+    start_ns = rec_start;
+    end_ns = rec_end;
+    if (startArg && parse_time(startArg, rec_start, &start_ns) != 0) {
+        fprintf(stderr, "Invalid start time (-s) !\n");
+        usage();
+    }
+    if (endArg && parse_time(endArg, rec_start, &end_ns) != 0) {
+        fprintf(stderr, "Invalid end time (-e) !\n");
+        usage();
+    }
+    if (duration > 0)
+        end_ns = start_ns + (int64_t) (duration * 1e9);
+
+    if (end_ns <= start_ns || start_ns >= rec_end || end_ns <= rec_start) {
+        fprintf(stderr, "Range is outside the recording (");
+        print_time(stderr, rec_start);
+        fprintf(stderr, " to ");
+        print_time(stderr, rec_end);
+        fprintf(stderr, ").\n");
+        exit(1);
+    }
+
+    first = tindex_sample_at(&m, start_ns);
+    last = end_ns >= rec_end ? total : tindex_sample_at(&m, end_ns);
+    if (last > total)
+        last = total;
+
+    for (i = tindex_find_time(&m, start_ns); i < m.count && m.entries[i].sample <= last; i++) {
+        if (info)
+            print_entry(&m.entries[i]);
+        if (m.entries[i].sample > first)
+            lost += m.entries[i].lost;
+    }
+
+    if (info) {
+        fprintf(stderr, "%llu index entries, range is samples %llu to %llu, %llu samples lost inside\n",
+                (unsigned long long) m.count, (unsigned long long) first, (unsigned long long) last,
+                (unsigned long long) lost);
+        return 0;
+    }
+
+    if (lost > 0)
+        fprintf(stderr, "Warning: %llu samples were lost inside the range.\n", (unsigned long long) lost);
+
+    if (compressed) {
+        fprintf(stderr, "Compressed recording, extract with: play_unz -s %llu -n %llu %s\n",
+                (unsigned long long) first, (unsigned long long) (last - first), argv[optind]);
+        exit(1);
+    }
+
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "Failed to map %s\n", argv[optind]);
+        exit(1);
+    }
+    /* madvise wants a page aligned start */
+    advise_from = first * pair_bytes / page * page;
+    if (madvise((void *) (data + advise_from), last * pair_bytes - advise_from, MADV_SEQUENTIAL) != 0)
+        fprintf(stderr, "Warning: no read ahead hint for the range: %s\n", strerror(errno));
+
+    if (argc <= optind + 1 || strcmp(argv[optind + 1], "-") == 0) {
+        out = stdout;
+    } else {
+        out = fopen(argv[optind + 1], "wb");
+        if (!out) {
+            fprintf(stderr, "Failed to open %s\n", argv[optind + 1]);
+            exit(1);
+        }
+    }
+
+    if (widen ? write_wide(&m, data, tindex_find_time(&m, start_ns), first, last, out) != 0
+              : fwrite(data + first * pair_bytes, pair_bytes, last - first, out) != last - first) {
+        fprintf(stderr, "Short write, samples lost, exiting!\n");
+        exit(1);
+    }
+
+    fprintf(stderr, "Extracted samples %llu to %llu (%.3f s)\n", (unsigned long long) first,
+            (unsigned long long) last, (double) (last - first) / m.hdr->samp_rate);
+
+    if (out != stdout)
+        fclose(out);
+    munmap((void *) data, st.st_size);
+    tindex_unmap(&m);
+
+    return 0;
+}
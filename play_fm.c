@@ -0,0 +1,576 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  play_fm, a narrow band / broadcast FM and AM receiver in the spirit of
+ *  rtl_fm: the RSP captures a band, every channel is cut out of it by a
+ *  ddc, demodulated, de-emphasised and resampled to 16 bit audio.
+ *
+ *  With several -f the receiver scans: it hops to the next frequency once
+ *  the squelch (-l) stayed closed for the hang time and stays while a
+ *  signal is there. With -C all of them are received at once out of one
+ *  capture and written as interleaved audio channels.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ddc.h"
+#include "demod.h"
+#include "iqdsp.h"
+#include "rt.h"
+#include "trace.h"
+
+#ifndef _WIN32
+
+#include <unistd.h>
+#include "mirsdrapi-rsp.h"
+
+#else
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#include "mir_sdr.h"
+#endif
+
+#define DEFAULT_CAPTURE_RATE    2048000
+#define DEFAULT_GAIN            40
+#define DEFAULT_HANG_MS         500
+#define MAX_CHANNELS            16
+#define BLOCK_PAIRS             8192    /* capture pairs demodulated at once, 4 ms at 2 MS/s */
+#define SCAN_SETTLE_MS          20      /* dropped after a hop, the tuner settles */
+#define EDGE_FRACTION           0.8     /* -C channels must lie in this part of the capture */
+
+struct mode {
+    const char *name;
+    enum demod_mode demod;
+    uint32_t channel_rate;
+    uint32_t audio_rate;
+    double deemph_us;
+};
+
+static const struct mode modes[] = {
+    {"fm",   DEMOD_FM,   32000,  32000, 0},
+    {"wbfm", DEMOD_WBFM, 256000, 48000, 50},
+    {"am",   DEMOD_AM,   32000,  32000, 0},
+};
+
+struct channel {
+    uint32_t frequency;
+    struct ddc ddc;
+    struct demod demod;
+    short *audio;
+    int n;                      /* audio samples of the current block */
+    double level;               /* dBFS of the current block */
+    int open;                   /* squelch */
+    int heard;                  /* above the squelch since tuned */
+    uint64_t quiet;             /* capture pairs since the level was last above the squelch */
+    uint64_t written;           /* audio samples out */
+    uint64_t open_blocks;
+};
+
+static int do_exit = 0;
+
+double atofs(char *s)
+/* standard suffixes */
+{
+    char last;
+    int len;
+    double suff = 1.0;
+    len = strlen(s);
+    last = s[len - 1];
+    s[len - 1] = '\0';
+    switch (last) {
+        case 'g':
+        case 'G':
+            suff *= 1e3;
+        case 'm':
+        case 'M':
+            suff *= 1e3;
+        case 'k':
+        case 'K':
+            suff *= 1e3;
+            suff *= atof(s);
+            s[len - 1] = last;
+            return suff;
+    }
+    s[len - 1] = last;
+    return atof(s);
+}
+
+void usage(void) {
+    fprintf(stderr,
+            "play_fm, an FM / AM receiver for SDRplay RSP receivers (rtl_fm port)\n\n"
+                    "Usage:\t -f frequency (Hz), repeat to scan several or to receive them all at once with -C\n"
+                    "\t[-M modulation: fm, wbfm or am (default: fm)]\n"
+                    "\t[-s channel sample rate, rounded to a whole fraction of the capture rate\n"
+                    "\t    (default: fm / am 32000, wbfm 256000 Hz)]\n"
+                    "\t[-r audio sample rate (default: fm / am 32000, wbfm 48000 Hz)]\n"
+                    "\t[-w capture sample rate of the RSP (default: 2048000 Hz)]\n"
+                    "\t[-A FM discriminator: fast (polynomial atan2), std (atan2f) or polar (no arctangent)\n"
+                    "\t    (default: fast)]\n"
+                    "\t[-e de-emphasis time constant in us, 0 for none (default: wbfm 50, else 0)]\n"
+                    "\t[-l squelch level in dBFS of the channel (default: off)]\n"
+                    "\t[-t squelch hang time in ms, also how long a scan waits on a quiet frequency (default: 500)]\n"
+                    "\t[-C receive all frequencies at once, they must fit in the capture; the output has one\n"
+                    "\t    interleaved audio channel per -f]\n"
+                    "\t[-g gain reduction (default: 40)]\n"
+                    "\t[-L RSP LNA enable (default: 0, disabled)]\n"
+                    "\t[-v Verbose mode, prints debug information. Default 0, 1 = enabled\n"
+                    "\t[-E trace.json[:seconds] record what each thread spends its time on, for chrome://tracing or\n"
+                    "\t    ui.perfetto.dev (default: off)]\n"
+                    "\tfilename (a '-' dumps audio to stdout), raw 16 bit signed little endian\n\n");
+    exit(1);
+}
+
+#ifdef _WIN32
+BOOL WINAPI
+sighandler(int signum)
+{
+    if (CTRL_C_EVENT == signum) {
+        fprintf(stderr, "Signal caught, exiting!\n");
+        do_exit = 1;
+        return TRUE;
+    }
+    return FALSE;
+}
+#else
+
+static void sighandler(int signum) {
+    fprintf(stderr, "Signal (%d) caught, exiting!\n", signum);
+    do_exit = 1;
+}
+
+#endif
+
+static mir_sdr_Bw_MHzT bandwidth_for(uint32_t capture_rate) {
+    if (capture_rate >= 8000000)
+        return mir_sdr_BW_8_000;
+    if (capture_rate >= 7000000)
+        return mir_sdr_BW_7_000;
+    if (capture_rate >= 6000000)
+        return mir_sdr_BW_6_000;
+    if (capture_rate >= 5000000)
+        return mir_sdr_BW_5_000;
+    return mir_sdr_BW_1_536;
+}
+
+/* power of one block of channel samples */
+static double channel_level(const float *i, const float *q, int n) {
+    double sum = 0.0;
+    int k;
+
+    for (k = 0; k < n; k++)
+        sum += i[k] * i[k] + q[k] * q[k];
+
+    return iq_power_to_dbfs(n > 0 ? sum / n / (32768.0 * 32768.0) : 0.0);
+}
+
+/* one block of the capture through one channel; returns 1 when its squelch is open */
+static int receive(struct channel *ch, const short *iq, int pairs, double squelch, uint64_t hang) {
+    const float *i, *q;
+    int n;
+    uint64_t t;
+
+    t = trace_begin();
+    n = ddc_run_float(&ch->ddc, iq, pairs, &i, &q);
+    trace_end("ddc", t, pairs);
+
+    /* opens on the level, stays open for the hang time after it dropped */
+    ch->level = channel_level(i, q, n);
+    if (ch->level >= squelch) {
+        ch->heard = 1;
+        ch->quiet = 0;
+    } else {
+        ch->quiet += pairs;
+    }
+    ch->open = squelch <= -200.0 || (ch->heard && ch->quiet < hang);
+
+    t = trace_begin();
+    ch->n = demod_run(&ch->demod, i, q, n, ch->audio);
+    trace_end("demod", t, n);
+
+    if (ch->open)
+        ch->open_blocks++;
+    return ch->open;
+}
+
+/* 0 when tuned in place, 1 after a new Init (the sample numbers restart), -1 on failure */
+static int retune(uint32_t frequency, int gain, uint32_t capture_rate, int samplesPerPacket) {
+    int n;
+
+    if (mir_sdr_SetRf(frequency, 1, 0) == mir_sdr_Success)
+        return 0;
+
+    /* out of the current band: the front end has to be set up again, same rate, same packets */
+    mir_sdr_Uninit();
+    if (mir_sdr_Init(gain, capture_rate / 1e6, frequency / 1e6, bandwidth_for(capture_rate), mir_sdr_IF_Zero,
+                     &n) != mir_sdr_Success || n != samplesPerPacket)
+        return -1;
+    return 1;
+}
+
+int main(int argc, char **argv) {
+#ifndef _WIN32
+    struct sigaction sigact, sigign;
+#endif
+    char *filename = NULL;
+    FILE *file;
+    mir_sdr_ErrT r;
+    int opt, reinit;
+    int gain = DEFAULT_GAIN;
+    int rspLNA = 0;
+    int verbose = 0;
+    char *traceSpec = NULL;
+    const struct mode *mode = &modes[0];
+    enum demod_disc disc = DISC_FAST;
+    uint32_t capture_rate = DEFAULT_CAPTURE_RATE, channel_rate = 0, audio_rate = 0;
+    double deemph_us = -1, squelch = -200.0;
+    int hang_ms = DEFAULT_HANG_MS;
+    int all_at_once = 0;
+
+    uint32_t freqs[MAX_CHANNELS];
+    int nfreqs = 0, nch, cur = 0;
+    struct channel channels[MAX_CHANNELS];
+    uint32_t center, lo, hi;
+    double offset;
+    int factor, maxAudio, blockPairs;
+
+    short *ibuf, *qbuf, *block, *frame;
+    int samplesPerPacket, grChanged, fsChanged, rfChanged;
+    unsigned int firstSample, nextSample = 0;
+    unsigned long packets = 0, sinceInit = 0, lossEvents = 0, lostSamples = 0;
+    int fill = 0, i, k;
+    uint64_t settle = 0, settle_pairs, hang, t, written = 0;
+
+    while ((opt = getopt(argc, argv, "f:M:s:r:w:A:e:l:t:Cg:L:v:E:")) != -1) {
+        switch (opt) {
+            case 'f':
+                if (nfreqs == MAX_CHANNELS) {
+                    fprintf(stderr, "Too many frequencies (-f), at most %d\n", MAX_CHANNELS);
+                    usage();
+                }
+                freqs[nfreqs++] = (uint32_t) atofs(optarg);
+                break;
+            case 'M':
+                mode = NULL;
+                for (i = 0; i < (int) (sizeof(modes) / sizeof(modes[0])); i++) {
+                    if (strcmp(optarg, modes[i].name) == 0)
+                        mode = &modes[i];
+                }
+                if (!mode) {
+                    fprintf(stderr, "Invalid modulation (-M) !\n");
+                    usage();
+                }
+                break;
+            case 's':
+                channel_rate = (uint32_t) atofs(optarg);
+                break;
+            case 'r':
+                audio_rate = (uint32_t) atofs(optarg);
+                break;
+            case 'w':
+                capture_rate = (uint32_t) atofs(optarg);
+                break;
+            case 'A':
+                if ((i = demod_parse_disc(optarg)) < 0) {
+                    fprintf(stderr, "Invalid discriminator (-A) !\n");
+                    usage();
+                }
+                disc = (enum demod_disc) i;
+                break;
+            case 'e':
+                deemph_us = atof(optarg);
+                if (deemph_us < 0) {
+                    fprintf(stderr, "Invalid de-emphasis (-e) !\n");
+                    usage();
+                }
+                break;
+            case 'l':
+                squelch = atof(optarg);
+                break;
+            case 't':
+                hang_ms = atoi(optarg);
+                if (hang_ms < 0) {
+                    fprintf(stderr, "Invalid squelch hang time (-t) !\n");
+                    usage();
+                }
+                break;
+            case 'C':
+                all_at_once = 1;
+                break;
+            case 'g':
+                gain = (int) atof(optarg);
+                break;
+            case 'L':
+                rspLNA = atoi(optarg);
+                break;
+            case 'v':
+                verbose = atoi(optarg);
+                break;
+            case 'E':
+                traceSpec = optarg;
+                break;
+            default:
+                usage();
+                break;
+        }
+    }
+
+    if (argc <= optind || nfreqs == 0)
+        usage();
+    filename = argv[optind];
+
+    if (channel_rate == 0)
+        channel_rate = mode->channel_rate;
+    if (audio_rate == 0)
+        audio_rate = mode->audio_rate;
+    if (deemph_us < 0)
+        deemph_us = mode->deemph_us;
+
+    factor = (int) ((double) capture_rate / channel_rate + 0.5);
+    if (factor < 1)
+        factor = 1;
+    channel_rate = capture_rate / factor;
+    if (audio_rate > channel_rate) {
+        fprintf(stderr, "The audio rate (-r) cannot be above the channel rate (%u Hz).\n", channel_rate);
+        usage();
+    }
+
+    lo = hi = freqs[0];
+    for (i = 1; i < nfreqs; i++) {
+        if (freqs[i] < lo)
+            lo = freqs[i];
+        if (freqs[i] > hi)
+            hi = freqs[i];
+    }
+    if (all_at_once) {
+        center = lo + (hi - lo) / 2;
+        if ((hi - lo) / 2.0 + channel_rate / 2.0 > EDGE_FRACTION * capture_rate / 2.0) {
+            fprintf(stderr, "The channels span %u Hz, too much for a capture at %u Hz (-w).\n", hi - lo,
+                    capture_rate);
+            exit(1);
+        }
+        nch = nfreqs;
+    } else {
+        /* the channel a quarter of the band off the centre, away from the DC spike of zero IF */
+        center = freqs[0] + capture_rate / 4;
+        nch = 1;
+    }
+
+    if (strcmp(filename, "-") == 0) {
+        file = stdout;
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+    } else {
+        file = fopen(filename, "wb");
+        if (!file) {
+            fprintf(stderr, "Failed to open %s\n", filename);
+            exit(1);
+        }
+    }
+
+    hang = (uint64_t) capture_rate * hang_ms / 1000;
+    settle_pairs = (uint64_t) capture_rate * SCAN_SETTLE_MS / 1000;
+
+    fprintf(stderr, "%s, channel %u Hz (1/%d of %u Hz), audio %u Hz, %d channel%s, de-emphasis %.0f us\n",
+            mode->name, channel_rate, factor, capture_rate, audio_rate, nch, nch > 1 ? "s" : "", deemph_us);
+    if (!all_at_once && nfreqs > 1)
+        fprintf(stderr, "Scanning %d frequencies, squelch %.1f dBFS, hang %d ms\n", nfreqs, squelch, hang_ms);
+
+    mir_sdr_SetParam(201, 1);
+    mir_sdr_SetParam(202, rspLNA == 1 ? 0 : 1);
+    r = mir_sdr_Init(gain, capture_rate / 1e6, center / 1e6, bandwidth_for(capture_rate), mir_sdr_IF_Zero,
+                     &samplesPerPacket);
+    if (r != mir_sdr_Success) {
+        fprintf(stderr, "Failed to open SDRplay RSP device.\n");
+        exit(1);
+    }
+    mir_sdr_SetDcMode(4, 0);
+    mir_sdr_SetDcTrackTime(63);
+
+#ifndef _WIN32
+    sigact.sa_handler = sighandler;
+    sigemptyset(&sigact.sa_mask);
+    sigact.sa_flags = 0;
+    sigign.sa_handler = SIG_IGN;
+    sigemptyset(&sigign.sa_mask);
+    sigign.sa_flags = 0;
+    sigaction(SIGINT, &sigact, NULL);
+    sigaction(SIGTERM, &sigact, NULL);
+    sigaction(SIGQUIT, &sigact, NULL);
+    /* the audio player went away: the write fails and the loop ends */
+    sigaction(SIGPIPE, &sigign, NULL);
+#else
+    SetConsoleCtrlHandler( (PHANDLER_ROUTINE) sighandler, TRUE );
+#endif
+
+    /* whole packets per block, the per block work of a channel is paid once */
+    blockPairs = BLOCK_PAIRS > samplesPerPacket ? BLOCK_PAIRS / samplesPerPacket * samplesPerPacket : samplesPerPacket;
+    maxAudio = 0;
+    memset(channels, 0, sizeof(channels));
+    for (i = 0; i < nch; i++) {
+        struct channel *ch = &channels[i];
+
+        ch->frequency = freqs[i];
+        offset = (double) ch->frequency - center;
+        if (ddc_init(&ch->ddc, capture_rate, offset, factor, blockPairs) != 0 ||
+            demod_init(&ch->demod, mode->demod, disc, channel_rate, audio_rate, deemph_us,
+                       blockPairs / factor + 1) != 0) {
+            fprintf(stderr, "Failed to set up channel %u Hz\n", ch->frequency);
+            exit(1);
+        }
+        maxAudio = demod_max_out(&ch->demod, blockPairs / factor + 1);
+        ch->audio = malloc(maxAudio * sizeof(short));
+    }
+    block = malloc(blockPairs * 2 * sizeof(short));
+    frame = malloc((size_t) maxAudio * nch * sizeof(short));
+
+    ibuf = malloc(samplesPerPacket * sizeof(short));
+    qbuf = malloc(samplesPerPacket * sizeof(short));
+
+    if (traceSpec && trace_open(traceSpec) != 0) {
+        fprintf(stderr, "Invalid trace file (-E) !\n");
+        exit(1);
+    }
+
+    rt_apply_thread(RT_CAPTURE, "play_fm");
+
+    while (!do_exit) {
+        t = trace_begin();
+        r = mir_sdr_ReadPacket(ibuf, qbuf, &firstSample, &grChanged, &rfChanged, &fsChanged);
+        trace_end("ReadPacket", t, samplesPerPacket);
+
+        if (r != mir_sdr_Success) {
+            fprintf(stderr, "WARNING: ReadPacket failed.\n");
+            break;
+        }
+
+        /* the API numbers samples, a jump means the device buffers overflowed */
+        packets++;
+        if (sinceInit++ > 0 && firstSample != nextSample && !fsChanged) {
+            lossEvents++;
+            lostSamples += firstSample - nextSample;
+            trace_instant("samples lost", firstSample - nextSample);
+            if (verbose == 1)
+                fprintf(stderr, "[DEBUG] lost %u samples\n", firstSample - nextSample);
+        }
+        nextSample = firstSample + samplesPerPacket;
+
+        if (settle > 0) {
+            settle = settle > (uint64_t) samplesPerPacket ? settle - samplesPerPacket : 0;
+            continue;
+        }
+
+        for (k = 0; k < samplesPerPacket; k++) {
+            block[2 * (fill + k)] = ibuf[k];
+            block[2 * (fill + k) + 1] = qbuf[k];
+        }
+        fill += samplesPerPacket;
+        if (fill < blockPairs)
+            continue;
+        fill = 0;
+
+        if (all_at_once) {
+            for (i = 0; i < nch; i++)
+                receive(&channels[i], block, blockPairs, squelch, hang);
+
+            /* the channels share their rates, every one gave the same number of samples */
+            t = trace_begin();
+            for (k = 0; k < channels[0].n; k++) {
+                for (i = 0; i < nch; i++)
+                    frame[k * nch + i] = channels[i].open ? channels[i].audio[k] : 0;
+            }
+            if (fwrite(frame, sizeof(short) * nch, channels[0].n, file) != (size_t) channels[0].n)
+                break;
+            for (i = 0; i < nch; i++)
+                channels[i].written += channels[0].n;
+            written += channels[0].n;
+            trace_end("write", t, channels[0].n);
+            continue;
+        }
+
+        if (receive(&channels[0], block, blockPairs, squelch, hang)) {
+            if (channels[0].open_blocks == 1 && nfreqs > 1)
+                fprintf(stderr, "[scan] %u Hz, %.1f dBFS\n", channels[0].frequency, channels[0].level);
+        } else if (nfreqs > 1) {
+            /* quiet for the hang time: next frequency */
+            cur = (cur + 1) % nfreqs;
+            channels[0].frequency = freqs[cur];
+            channels[0].quiet = 0;
+            channels[0].heard = 0;
+            channels[0].open_blocks = 0;
+            demod_reset(&channels[0].demod);
+            trace_instant("hop", freqs[cur]);
+            reinit = retune(freqs[cur] + capture_rate / 4, gain, capture_rate, samplesPerPacket);
+            if (reinit < 0) {
+                fprintf(stderr, "Failed to tune to %u Hz\n", freqs[cur]);
+                break;
+            }
+            if (reinit > 0)
+                sinceInit = 0;
+            settle = settle_pairs;
+            if (verbose == 1)
+                fprintf(stderr, "[DEBUG] scan: %u Hz\n", freqs[cur]);
+            continue;
+        } else {
+            /* a single frequency keeps its timing, the squelch writes silence */
+            memset(channels[0].audio, 0, channels[0].n * sizeof(short));
+        }
+
+        t = trace_begin();
+        if (fwrite(channels[0].audio, sizeof(short), channels[0].n, file) != (size_t) channels[0].n)
+            break;
+        channels[0].written += channels[0].n;
+        written += channels[0].n;
+        trace_end("write", t, channels[0].n);
+    }
+
+    mir_sdr_Uninit();
+
+    for (i = 0; i < nch; i++) {
+        if (all_at_once || nfreqs == 1)
+            fprintf(stderr, "%u Hz: %.1f s of audio, squelch open %.0f %% of the time\n", channels[i].frequency,
+                    (double) channels[i].written / audio_rate,
+                    packets ? 100.0 * channels[i].open_blocks * blockPairs / ((double) packets * samplesPerPacket)
+                            : 0.0);
+        ddc_free(&channels[i].ddc);
+        demod_free(&channels[i].demod);
+        free(channels[i].audio);
+    }
+    if (!all_at_once && nfreqs > 1)
+        fprintf(stderr, "scan: %.1f s of audio\n", (double) written / audio_rate);
+    fprintf(stderr, "%lu sample-loss events, %lu samples lost\n", lossEvents, lostSamples);
+
+    free(block);
+    free(frame);
+    free(ibuf);
+    free(qbuf);
+    if (file != stdout)
+        fclose(file);
+    else
+        fflush(stdout);
+
+    trace_close();
+    if (do_exit)
+        fprintf(stderr, "\nUser cancel, exiting...\n");
+    return 0;
+}
@@ -0,0 +1,199 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  play_latency, a test client for play_tcp. Asks for the framed stream
+ *  (command 0x40) and measures, per frame, the time from mir_sdr_ReadPacket
+ *  on the server to the frame header arriving here, and the time from
+ *  connect() to the first samples. Server and client clocks must agree
+ *  for the former, so run it on the same host or with synchronised clocks.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* memmem */
+#endif
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lathist.h"
+#include "rtltcp.h"
+
+#define RECV_SIZE       (1024 * 1024)
+
+void usage(void) {
+    fprintf(stderr,
+            "play_latency, measures the latency of a play_tcp receiver\n\n"
+                    "Usage:\t[-a server address (default: 127.0.0.1)]\n"
+                    "\t[-p port (default: 1234)]\n"
+                    "\t[-t seconds to measure (default: 10)]\n"
+                    "\t[-i read every that many ms, like a client polling from a GUI loop (default: 0, read\n"
+                    "\t    as soon as data arrives)]\n\n");
+    exit(1);
+}
+
+static uint64_t realtime_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint32_t be32(const uint8_t *p) {
+    return (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 | (uint32_t) p[2] << 8 | p[3];
+}
+
+static int recv_all(int s, uint8_t *buf, int len) {
+    int n;
+
+    while (len > 0) {
+        n = recv(s, buf, len, 0);
+        if (n <= 0)
+            return -1;
+        buf += n;
+        len -= n;
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    const char *addr = "127.0.0.1";
+    int port = 1234, seconds = 10, interval_ms = 0;
+    struct sockaddr_in server;
+    struct lathist hist;
+    uint8_t *buf, dongle[sizeof(dongle_info_t)], cmd[sizeof(struct command)] = {CMD_SET_FRAMING, 0, 0, 0, 1};
+    uint64_t connect_ns, first_ns = 0, start, now, frame_ns;
+    uint64_t payload_left = 0, frames = 0, bytes = 0, dropped = 0, skipped = 0;
+    size_t have = 0, pos, k;
+    int s, n, opt, synced = 0;
+    uint8_t *m;
+
+    while ((opt = getopt(argc, argv, "a:p:t:i:")) != -1) {
+        switch (opt) {
+            case 'a':
+                addr = optarg;
+                break;
+            case 'p':
+                port = atoi(optarg);
+                break;
+            case 't':
+                seconds = atoi(optarg);
+                break;
+            case 'i':
+                interval_ms = atoi(optarg);
+                break;
+            default:
+                usage();
+                break;
+        }
+    }
+    if (seconds < 1 || interval_ms < 0)
+        usage();
+
+    memset(&server, 0, sizeof(server));
+    server.sin_family = AF_INET;
+    server.sin_port = htons(port);
+    if (inet_pton(AF_INET, addr, &server.sin_addr) != 1)
+        usage();
+
+    s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    connect_ns = realtime_ns();
+    if (connect(s, (struct sockaddr *) &server, sizeof(server)) != 0 || recv_all(s, dongle, sizeof(dongle)) != 0 ||
+        memcmp(dongle, "RTL0", 4) != 0) {
+        fprintf(stderr, "No play_tcp at %s:%d\n", addr, port);
+        return 1;
+    }
+    if (send(s, cmd, sizeof(cmd), 0) != sizeof(cmd)) {
+        fprintf(stderr, "Failed to ask for the framed stream\n");
+        return 1;
+    }
+
+    buf = malloc(RECV_SIZE);
+    lathist_reset(&hist);
+    start = realtime_ns();
+
+    while ((now = realtime_ns()) - start < (uint64_t) seconds * 1000000000ULL) {
+        n = recv(s, buf + have, RECV_SIZE - have, 0);
+        if (n <= 0) {
+            fprintf(stderr, "Connection closed by the server\n");
+            break;
+        }
+        now = realtime_ns();
+        if (!first_ns)
+            first_ns = now;
+        have += n;
+        bytes += n;
+
+        for (pos = 0; pos < have;) {
+            if (payload_left) {
+                k = have - pos < payload_left ? have - pos : payload_left;
+                pos += k;
+                payload_left -= k;
+                continue;
+            }
+            if (!synced) {
+                /* raw samples sent before the server switched to frames */
+                m = memmem(buf + pos, have - pos, "RTLF", 4);
+                if (!m) {
+                    k = have - pos > 3 ? have - pos - 3 : 0;
+                    skipped += k;
+                    pos += k;
+                    break;
+                }
+                skipped += m - (buf + pos);
+                pos = m - buf;
+                synced = 1;
+            }
+            if (have - pos < sizeof(tcp_frame_t))
+                break;
+            if (memcmp(buf + pos, "RTLF", 4) != 0) {
+                fprintf(stderr, "Lost frame sync after %llu frames\n", (unsigned long long) frames);
+                synced = 0;
+                continue;
+            }
+
+            frame_ns = (uint64_t) be32(buf + pos + 16) * 1000000000ULL + be32(buf + pos + 20);
+            lathist_add(&hist, now > frame_ns ? now - frame_ns : 0);
+            payload_left = be32(buf + pos + 4);
+            dropped += be32(buf + pos + 24);
+            frames++;
+            pos += sizeof(tcp_frame_t);
+        }
+        memmove(buf, buf + pos, have - pos);
+        have -= pos;
+
+        if (interval_ms)
+            usleep(interval_ms * 1000);
+    }
+
+    printf("%llu frames, %.1f MB in %.1f s, %llu raw bytes before the first frame, %llu pairs dropped by the server\n",
+           (unsigned long long) frames, bytes / 1e6, (now - start) / 1e9, (unsigned long long) skipped,
+           (unsigned long long) dropped);
+    printf("connect to first samples: %.2f ms\n", first_ns ? (first_ns - connect_ns) / 1e6 : 0.0);
+    lathist_print(&hist, "latency ReadPacket to client", stdout);
+
+    close(s);
+    free(buf);
+    return 0;
+}
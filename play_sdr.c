@@ -50,6 +50,19 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "dsppool.h"
+#include "fdout.h"
+#include "iqdsp.h"
+#include "iqz.h"
+#include "pipeline.h"
+#include "pyramid.h"
+#include "rt.h"
+#include "shmring.h"
+#include "tee.h"
+#include "tindex.h"
+#include "trace.h"
+#include "trigger.h"
+
 #ifndef _WIN32
 
 #include <unistd.h>
@@ -68,6 +81,10 @@
 #define DEFAULT_GAIN            40;
 #define DEFAULT_FREQUENCY       100000000;
 #define DEFAULT_RESULT_BITS     8; // more compatible with RTL_SDR
+#define DEFAULT_HYSTERESIS      3.0
+#define DEFAULT_PREROLL_MS      100
+#define DEFAULT_POSTROLL_MS     500
+#define DEFAULT_SCALED_INDEX_S  1.0     /* -q without -t */
 
 static int do_exit = 0;
 
@@ -83,6 +100,8 @@ void adjust_if(int ifFreq, mir_sdr_If_kHzT *ptr);
 
 void adjust_result_bits(int bits, int *ptrResultBits);
 
+void adjust_roll(char *arg, int *ptrPreMs, int *ptrPostMs);
+
 double atofs(char *s)
 /* standard suffixes */
 {
@@ -122,8 +141,32 @@ void usage(void) {
                     "\t[-l RSP LNA enable (default: 0, disabled)]\n"
                     "\t[-y Flipcomplex I-Q => Q-I (default: 0, disabled) 1 = enabled\n"
                     "\t[-x Result I/Q bit resolution (uint8 / short) (default: 8, possible values: 8 16)]\n"
+                    "\t[-q adaptive 8 bit scaling: peak or rms[:hold_ms], every packet keeps as many bits as its\n"
+                    "\t    level allows, the shifts go to the time index (see -t, play_extract -w) (default: off,\n"
+                    "\t    the top byte)]\n"
                     "\t[-v Verbose mode, prints debug information. Default 0, 1 = enabled\n"
-                    "\tfilename (a '-' dumps samples to stdout)\n\n");
+                    "\t[-T trigger level in dBFS, only write segments above it (default: off, write everything)]\n"
+                    "\t[-H trigger hysteresis in dB (default: 3)]\n"
+                    "\t[-R trigger pre-roll:post-roll in ms (default: 100:500)]\n"
+                    "\t[-A pin the capture thread to this cpu (default: not pinned)]\n"
+                    "\t[-S capture thread scheduling: fifo:prio, rr:prio or other (default: other)]\n"
+                    "\t[-M memory: 0 default, 1 mlockall and prefault buffers, 2 also huge pages (default: 0)]\n"
+                    "\t[-P pipe size in kB when writing to a stdout pipe (default: 1024)]\n"
+                    "\t[-t write a time index (<file>.tidx, see play_extract) every that many seconds and at every event]\n"
+                    "\t[-D processing pipeline, comma separated: dc[:alpha] swap scale:gain shift:hz decim:n\n"
+                    "\t    e.g. dc,shift:250000,decim:8 (default: none, the samples are written as read)]\n"
+                    "\t[-j run the pipeline (-D) on this many worker threads, in blocks (default: 0, in the capture\n"
+                    "\t    thread)]\n"
+                    "\t[-W write /8 /64 /512 companions and an overview waterfall (<file>.d8 ... <file>.pgm),\n"
+                    "\t    one waterfall row per that many seconds (default: off)]\n"
+                    "\t[-E trace.json[:seconds] record what each thread spends its time on, for chrome://tracing or\n"
+                    "\t    ui.perfetto.dev (default: off)]\n"
+                    "\t[-o extra output, repeatable: path, -, tcp:port or shm:name[:MB], then options ,bits=8|16\n"
+                    "\t    ,decim=n, e.g. tcp:1235,bits=16,decim=4. Each has its own thread, a slow one loses\n"
+                    "\t    samples on its own instead of holding up the capture (default: none)]\n"
+                    "\t[-z compress the recording losslessly (.iqz, see play_unz) using this many threads (default: off)]\n"
+                    "\tfilename (a '-' dumps samples to stdout,\n"
+                    "\t          shm:name[:MB] publishes them in a shared memory ring, default 16 MB)\n\n");
     exit(1);
 }
 
@@ -149,21 +192,98 @@ static void sighandler(int signum) {
 
 #endif
 
+/* where the converted samples go: a file, stdout (without stdio), a shared memory ring, or the compressor */
+struct output {
+    FILE *file;
+    struct fd_output fdo;
+    int use_fd;
+    struct shm_ring ring;
+    int use_ring;
+    struct iqz_writer iqz;
+    int use_iqz;
+};
+
+static int write_output(void *ctx, const void *buf, size_t len) {
+    struct output *out = ctx;
+    uint64_t t = trace_begin();
+    int r;
+
+    if (out->use_ring) {
+        shm_ring_write(&out->ring, buf, len);
+        r = 0;
+    } else if (out->use_iqz) {
+        r = iqz_writer_write(&out->iqz, buf, len);
+    } else if (out->use_fd) {
+        r = fd_output_write(&out->fdo, buf, len);
+    } else {
+        r = fwrite(buf, 1, len, out->file) == len ? 0 : -1;
+    }
+
+    trace_end("write", t, (int64_t) len);
+    return r;
+}
+
+static int open_ring(struct output *out, char *spec, uint32_t samp_rate, uint32_t frequency) {
+    char *name = spec + 4;
+    char *sep = strchr(name, ':');
+    uint64_t size = SHM_RING_DEFAULT_SIZE;
+
+    if (sep) {
+        *sep = '\0';
+        size = (uint64_t) atoi(sep + 1) * 1024 * 1024;
+    }
+
+    out->use_ring = 1;
+    return shm_ring_create(&out->ring, name, size, samp_rate,
+                           resultBits == 8 ? SHM_FMT_CS8 : SHM_FMT_CS16, frequency);
+}
+
 int main(int argc, char **argv) {
 #ifndef _WIN32
     struct sigaction sigact;
 #endif
     char *filename = NULL;
-    int bufferSize;
+    int bufferSize = 0;
     mir_sdr_ErrT r;
     int opt;
     int gain = DEFAULT_GAIN;
     int flipcomplex = 0;
     int verbose = 0;
-    FILE *file;
-
-    uint8_t *buffer8;
-    short *buffer16;
+    struct output out;
+    int pipeKb = FDOUT_DEFAULT_PIPE_SIZE / 1024;
+    int compressThreads = 0;
+    double indexInterval = 0;
+    struct iq_scaler scaler;
+    int adaptive = 0, shift = 8;
+    struct time_index tindex;
+    double pyramidRow = 0;
+    char *pipeSpec = NULL, *spec = NULL;
+    struct pipeline pipe;
+    int dspThreads = 0;
+    struct dsp_pool pool;
+    uint64_t inTotal = 0;
+    uint32_t outRate;
+    int outSamples;
+    struct pyramid pyramid;
+
+    uint8_t *buffer8 = NULL;
+    short *buffer16 = NULL;
+    void *outbuf;
+    size_t outbytes;
+
+    int useTrigger = 0;
+    double triggerLevel = 0;
+    double hysteresis = DEFAULT_HYSTERESIS;
+    int prerollMs = DEFAULT_PREROLL_MS;
+    int postrollMs = DEFAULT_POSTROLL_MS;
+    struct trigger trigger;
+    char *indexname = NULL;
+    char *traceSpec = NULL;
+    struct tee tee;
+    uint64_t t;
+
+    unsigned int nextSample = 0;
+    unsigned long packets = 0, lossEvents = 0, lostSamples = 0;
 
     uint32_t frequency = DEFAULT_FREQUENCY;
     uint32_t samp_rate = DEFAULT_SAMPLE_RATE;
@@ -172,7 +292,9 @@ int main(int argc, char **argv) {
     mir_sdr_Bw_MHzT bandwidth = mir_sdr_BW_1_536;
     mir_sdr_If_kHzT ifKhz = mir_sdr_IF_Zero;
 
-    while ((opt = getopt(argc, argv, "f:g:s:n:l:b:i:x:y:v:")) != -1) {
+    memset(&tee, 0, sizeof(tee));
+
+    while ((opt = getopt(argc, argv, "f:g:s:n:l:b:i:x:q:y:v:T:H:R:A:S:M:P:t:W:z:D:j:E:o:")) != -1) {
         switch (opt) {
             case 'f':
                 frequency = (uint32_t) atofs(optarg);
@@ -195,12 +317,94 @@ int main(int argc, char **argv) {
             case 'x':
                 adjust_result_bits(atoi(optarg), &resultBits);
                 break;
+            case 'q':
+                if (iq_scaler_parse(&scaler, optarg) != 0) {
+                    fprintf(stderr, "Invalid adaptive scaling (-q) !\n");
+                    usage();
+                }
+                adaptive = 1;
+                break;
             case 'y':
                 flipcomplex = atoi(optarg);
                 break;
             case 'v':
                 verbose = atoi(optarg);
                 break;
+            case 'T':
+                useTrigger = 1;
+                triggerLevel = atof(optarg);
+                break;
+            case 'H':
+                hysteresis = atof(optarg);
+                break;
+            case 'R':
+                adjust_roll(optarg, &prerollMs, &postrollMs);
+                break;
+            case 'A':
+                if (rt_parse_cpus(optarg) != 0) {
+                    fprintf(stderr, "Invalid cpu (-A) !\n");
+                    usage();
+                }
+                break;
+            case 'S':
+                if (rt_parse_sched(optarg) != 0) {
+                    fprintf(stderr, "Invalid scheduling policy / priority (-S) !\n");
+                    usage();
+                }
+                break;
+            case 'M':
+                if (rt_parse_memory(optarg) != 0) {
+                    fprintf(stderr, "Invalid memory mode (-M) !\n");
+                    usage();
+                }
+                break;
+            case 'P':
+                pipeKb = atoi(optarg);
+                if (pipeKb < 4) {
+                    fprintf(stderr, "Invalid pipe size (-P) !\n");
+                    usage();
+                }
+                break;
+            case 't':
+                indexInterval = atof(optarg);
+                if (indexInterval <= 0) {
+                    fprintf(stderr, "Invalid time index interval (-t) !\n");
+                    usage();
+                }
+                break;
+            case 'D':
+                pipeSpec = optarg;
+                break;
+            case 'j':
+                dspThreads = atoi(optarg);
+                if (dspThreads < 1 || dspThreads > 64) {
+                    fprintf(stderr, "Invalid number of DSP threads (-j) !\n");
+                    usage();
+                }
+                break;
+            case 'W':
+                pyramidRow = atof(optarg);
+                if (pyramidRow <= 0) {
+                    fprintf(stderr, "Invalid waterfall row interval (-W) !\n");
+                    usage();
+                }
+                break;
+            case 'E':
+                traceSpec = optarg;
+                break;
+            case 'o':
+                if (tee_add(&tee, optarg) != 0) {
+                    fprintf(stderr, "Invalid output (-o) !\n");
+                    usage();
+                }
+                break;
+            case 'z':
+                compressThreads = atoi(optarg);
+                if (compressThreads < 1 || compressThreads > 64) {
+                    fprintf(stderr, "Invalid number of compression threads (-z) !\n");
+                    usage();
+                }
+                break;
             default:
                 usage();
                 break;
@@ -219,6 +423,28 @@ int main(int argc, char **argv) {
         filename = argv[optind];
     }
 
+    if (tee.uses_stdout && strcmp(filename, "-") == 0) {
+        fprintf(stderr, "Only one output can go to stdout.\n");
+        usage();
+    }
+
+    if (adaptive && (resultBits != 8 || pipeSpec)) {
+        fprintf(stderr, "Adaptive scaling (-q) works on the 8 bit output (-x 8) without a pipeline (-D).\n");
+        usage();
+    }
+    if (adaptive && (strcmp(filename, "-") == 0 || strncmp(filename, "shm:", 4) == 0 || useTrigger)) {
+        fprintf(stderr, "Adaptive scaling (-q) keeps its shifts in the time index, it needs a continuous recording to a file.\n");
+        usage();
+    }
+    /* without its shifts the recording cannot be read back */
+    if (adaptive && indexInterval == 0)
+        indexInterval = DEFAULT_SCALED_INDEX_S;
+
+    if (dspThreads > 0 && (!pipeSpec || useTrigger)) {
+        fprintf(stderr, "DSP threads (-j) need a pipeline (-D) and a continuous recording (no -T).\n");
+        usage();
+    }
+
     if (verbose == 1) {
         fprintf(stderr, "[DEBUG] *************** play_sdr16 init summary *********************\n");
         fprintf(stderr, "[DEBUG] LNA: %d\n", rspLNA);
@@ -228,20 +454,27 @@ int main(int argc, char **argv) {
         fprintf(stderr, "[DEBUG] bandwidth: [kHz] %d\n", bandwidth);
         fprintf(stderr, "[DEBUG] IF: %d\n", ifKhz);
         fprintf(stderr, "[DEBUG] Result I/Q bit resolution (bit): %d\n", resultBits);
+        if (useTrigger) {
+            fprintf(stderr, "[DEBUG] trigger: %.1f dBFS, hysteresis %.1f dB, pre-roll %d ms, post-roll %d ms\n",
+                    triggerLevel, hysteresis, prerollMs, postrollMs);
+        }
         fprintf(stderr, "[DEBUG] *************************************************************\n");
     }
 
 
-    r = mir_sdr_Init(40, 2.0, 100.00, mir_sdr_BW_1_536, mir_sdr_IF_Zero,
-                     &samplesPerPacket);
+    rt_lock_memory();
 
+    mir_sdr_SetParam(201, 1);
+    mir_sdr_SetParam(202, rspLNA == 1 ? 0 : 1);
+
+    /* opened once, before any output exists; a separate probe Init costs as much again */
+    r = mir_sdr_Init(gain, (samp_rate / 1e6), (frequency / 1e6),
+                     bandwidth, ifKhz, &samplesPerPacket);
     if (r != mir_sdr_Success) {
         fprintf(stderr, "Failed to open SDRplay RSP device.\n");
         exit(1);
     }
 
-    mir_sdr_Uninit();
-
 #ifndef _WIN32
     sigact.sa_handler = sighandler;
     sigemptyset(&sigact.sa_mask);
@@ -254,62 +487,209 @@ int main(int argc, char **argv) {
     SetConsoleCtrlHandler( (PHANDLER_ROUTINE) sighandler, TRUE );
 #endif
 
-    if (strcmp(filename, "-") == 0) { /* Write samples to stdout */
-        file = stdout;
+    memset(&out, 0, sizeof(out));
+    memset(&tindex, 0, sizeof(tindex));
+
+    /* output rate, lower than samp_rate when the pipeline decimates */
+    outRate = samp_rate;
+    if (pipeSpec) {
+        spec = malloc(strlen(pipeSpec) + 6);
+        sprintf(spec, "%s%s", flipcomplex ? "swap," : "", pipeSpec);
+        if (pipeline_parse(&pipe, spec, samp_rate, resultBits) != 0)
+            usage();
+        outRate = samp_rate / pipe.decimation;
+        if (verbose == 1) {
+            fprintf(stderr, "[DEBUG] pipeline, %u S/s out: ", outRate);
+            pipeline_describe(&pipe, stderr);
+        }
+    }
+
+    if (pyramidRow > 0 && (strcmp(filename, "-") == 0 || strncmp(filename, "shm:", 4) == 0)) {
+        fprintf(stderr, "The companion streams (-W) are written next to a recording file.\n");
+        goto out;
+    }
+
+    if (indexInterval > 0) {
+        char *tindexname;
+
+        if (strcmp(filename, "-") == 0 || strncmp(filename, "shm:", 4) == 0 || useTrigger) {
+            fprintf(stderr, "The time index (-t) needs a continuous recording to a file.\n");
+            goto out;
+        }
+        tindexname = malloc(strlen(filename) + 6);
+        sprintf(tindexname, "%s.tidx", filename);
+        if (tindex_open(&tindex, tindexname, outRate, resultBits, adaptive, indexInterval) != 0) {
+            free(tindexname);
+            goto out;
+        }
+        free(tindexname);
+    }
+
+    if (compressThreads > 0) {
+        if (strncmp(filename, "shm:", 4) == 0) {
+            fprintf(stderr, "Compression (-z) needs a file or stdout, not a shared memory ring.\n");
+            goto out;
+        }
+        out.file = strcmp(filename, "-") == 0 ? stdout : fopen(filename, "wb");
+        if (!out.file) {
+            fprintf(stderr, "Failed to open %s\n", filename);
+            goto out;
+        }
+        if (iqz_writer_open(&out.iqz, out.file, resultBits, outRate, frequency, compressThreads) != 0)
+            goto out;
+        out.use_iqz = 1;
+    } else if (strcmp(filename, "-") == 0) { /* Write samples to stdout */
+        out.file = stdout;
 #ifdef _WIN32
         _setmode(_fileno(stdin), _O_BINARY);
+#else
+        if (fd_output_open(&out.fdo, STDOUT_FILENO, (size_t) pipeKb * 1024) != 0) {
+            fprintf(stderr, "Failed to allocate output buffers\n");
+            goto out;
+        }
+        out.use_fd = 1;
+        if (verbose == 1) {
+            if (out.fdo.is_pipe)
+                fprintf(stderr, "[DEBUG] stdout is a pipe of %zu bytes, vmsplice output\n", out.fdo.pipe_size);
+            else
+                fprintf(stderr, "[DEBUG] stdout is not a pipe, direct %d byte writes\n", FDOUT_BLOCK_SIZE);
+        }
 #endif
+    } else if (strncmp(filename, "shm:", 4) == 0) {
+        if (open_ring(&out, filename, outRate, frequency) != 0)
+            goto out;
+        fprintf(stderr, "Publishing samples in shared memory %s (%llu MB)\n", out.ring.name,
+                (unsigned long long) (out.ring.size >> 20));
     } else {
-        file = fopen(filename, "wb");
-        if (!file) {
+        out.file = fopen(filename, "wb");
+        if (!out.file) {
             fprintf(stderr, "Failed to open %s\n", filename);
             goto out;
         }
     }
 
 
-    mir_sdr_SetParam(201, 1);
-    mir_sdr_SetParam(202, rspLNA == 1 ? 0 : 1);
-
-
-    r = mir_sdr_Init(gain, (samp_rate / 1e6), (frequency / 1e6),
-                     bandwidth, ifKhz, &samplesPerPacket);
-
-
     bufferSize = (samplesPerPacket * 2);
 
     if (resultBits == 8) {
-        buffer8 = malloc(bufferSize * sizeof(uint8_t));
+        buffer8 = rt_alloc(bufferSize * sizeof(uint8_t));
+        outbuf = buffer8;
+        outbytes = bufferSize * sizeof(uint8_t);
     }
     else {
-        buffer16 = malloc(bufferSize * sizeof(short));
+        buffer16 = rt_alloc(bufferSize * sizeof(short));
+        outbuf = buffer16;
+        outbytes = bufferSize * sizeof(short);
     }
 
+    mir_sdr_SetDcMode(4, 0);
+    mir_sdr_SetDcTrackTime(63);
 
-    if (r != mir_sdr_Success) {
-        fprintf(stderr, "Failed to start SDRplay RSP device.\n");
+    ibuf = rt_alloc(samplesPerPacket * sizeof(short));
+    qbuf = rt_alloc(samplesPerPacket * sizeof(short));
+
+    outSamples = samplesPerPacket;
+    if (pipeSpec) {
+        if (pipeline_prepare(&pipe, samplesPerPacket) != 0) {
+            fprintf(stderr, "Failed to allocate pipeline buffers\n");
+            exit(1);
+        }
+        if (useTrigger && samplesPerPacket % pipe.decimation != 0) {
+            fprintf(stderr, "The trigger needs a decimation that divides the %d samples per packet.\n",
+                    samplesPerPacket);
+            exit(1);
+        }
+        outSamples = samplesPerPacket / pipe.decimation;
+        outbytes /= pipe.decimation;
+    }
+
+    if (dspThreads > 0) {
+        if (dsp_pool_open(&pool, spec, samp_rate, resultBits, dspThreads) != 0)
+            exit(1);
+        if (verbose == 1)
+            fprintf(stderr, "[DEBUG] %d DSP threads, blocks of %d samples plus %d overlap\n", dspThreads,
+                    pool.block_samples, pool.overlap);
+    }
+
+    if (useTrigger) {
+        if (out.file && out.file != stdout) { /* segment index next to the recording */
+            indexname = malloc(strlen(filename) + 5);
+            sprintf(indexname, "%s.seg", filename);
+        }
+
+        if (trigger_init(&trigger, triggerLevel, hysteresis, prerollMs, postrollMs, outRate,
+                         outSamples, outbytes, indexname, write_output, &out) != 0) {
+            exit(1);
+        }
+    }
+
+    if (pyramidRow > 0 &&
+        pyramid_open(&pyramid, filename, resultBits, samp_rate, samplesPerPacket, pyramidRow) != 0) {
         exit(1);
     }
 
-    mir_sdr_SetDcMode(4, 0);
-    mir_sdr_SetDcTrackTime(63);
+    if (tee.nsinks > 0 && tee_start(&tee, samp_rate, frequency, samplesPerPacket) != 0)
+        exit(1);
 
-    ibuf = malloc(samplesPerPacket * sizeof(short));
-    qbuf = malloc(samplesPerPacket * sizeof(short));
+    if (traceSpec && trace_open(traceSpec) != 0) {
+        fprintf(stderr, "Invalid trace file (-E) !\n");
+        exit(1);
+    }
+
+    rt_apply_thread(RT_CAPTURE, "play_sdr");
 
+    if (adaptive)
+        iq_scaler_reset(&scaler, samp_rate);
     fprintf(stderr, "Writing samples...\n");
 
     while (!do_exit) {
+        t = trace_begin();
         r = mir_sdr_ReadPacket(ibuf, qbuf, &firstSample, &grChanged, &rfChanged,
                                &fsChanged);
+        trace_end("ReadPacket", t, samplesPerPacket);
 
         if (r != mir_sdr_Success) {
             fprintf(stderr, "WARNING: ReadPacket failed.\n");
             break;
         }
 
+        /* the API numbers samples, a jump means the device buffers overflowed */
+        if (packets++ > 0 && firstSample != nextSample && !fsChanged) {
+            lossEvents++;
+            lostSamples += firstSample - nextSample;
+            trace_instant("samples lost", firstSample - nextSample);
+            if (verbose == 1)
+                fprintf(stderr, "[DEBUG] lost %u samples\n", firstSample - nextSample);
+        }
+        nextSample = firstSample + samplesPerPacket;
+        if (grChanged)
+            trace_instant("gain changed", 0);
+        if (rfChanged)
+            trace_instant("rf changed", 0);
+
+        if (tee.nsinks > 0) {
+            t = trace_begin();
+            tee_write(&tee, ibuf, qbuf, samplesPerPacket, flipcomplex);
+            trace_end("tee", t, samplesPerPacket);
+        }
+
+        t = trace_begin();
+        if (dspThreads > 0) {
+            /* written as blocks come back; the index counts what this packet will turn into */
+            inTotal += samplesPerPacket;
+            outSamples = (int) (inTotal / pipe.decimation - (inTotal - samplesPerPacket) / pipe.decimation);
+        } else if (pipeSpec) {
+            outSamples = pipeline_run(&pipe, ibuf, qbuf, samplesPerPacket, outbuf);
+            outbytes = (size_t) outSamples * (resultBits == 8 ? 2 : 4);
+        }
+
+        if (adaptive) {
+            shift = iq_scaler_update(&scaler, ibuf, qbuf, samplesPerPacket);
+            iq_to8_shift(flipcomplex ? qbuf : ibuf, flipcomplex ? ibuf : qbuf, samplesPerPacket, shift, buffer8);
+        }
+
         j = 0;
-        for (i = 0; i < samplesPerPacket; i++) {
+        for (i = 0; i < samplesPerPacket && !pipeSpec && !adaptive; i++) {
             if (resultBits == 8) {
                 if (flipcomplex == 0) {
                     buffer8[j++] = (unsigned char) (ibuf[i] >> 8);
@@ -329,41 +709,109 @@ int main(int argc, char **argv) {
                 }
             }
         }
+        if (dspThreads == 0)
+            trace_end(pipeSpec ? "pipeline" : "convert", t, samplesPerPacket);
 
-        if (resultBits == 8) {
-            if (fwrite(buffer8, sizeof(uint8_t), bufferSize, file) != (size_t) bufferSize) {
+        t = trace_begin();
+        if (pyramidRow > 0 &&
+            pyramid_feed(&pyramid, flipcomplex ? qbuf : ibuf, flipcomplex ? ibuf : qbuf) != 0) {
+            fprintf(stderr, "Short write of the companion streams, exiting!\n");
+            break;
+        }
+        if (pyramidRow > 0)
+            trace_end("companions", t, samplesPerPacket);
+
+        t = trace_begin();
+        if (useTrigger) {
+            if (trigger_feed(&trigger, iq_block_power(ibuf, qbuf, samplesPerPacket), outbuf) != 0) {
                 fprintf(stderr, "Short write, samples lost, exiting!\n");
                 break;
             }
+            trace_end("trigger", t, samplesPerPacket);
         }
         else {
-            if (fwrite(buffer16, sizeof(short), samplesPerPacket * 2, file) != (size_t) bufferSize) {
+            if (indexInterval > 0)
+                tindex_packet(&tindex, firstSample, samplesPerPacket, outSamples, grChanged, rfChanged,
+                              fsChanged, frequency, gain, resultBits == 8 ? shift : 0);
+            if ((dspThreads > 0 ? dsp_pool_feed(&pool, ibuf, qbuf, samplesPerPacket, write_output, &out) :
+                 write_output(&out, outbuf, outbytes)) != 0) {
                 fprintf(stderr, "Short write, samples lost, exiting!\n");
                 break;
             }
+            if (dspThreads > 0)
+                trace_end("dsp feed", t, samplesPerPacket);
         }
     }
 
 
     mir_sdr_Uninit();
 
+    if (dspThreads > 0 && dsp_pool_close(&pool, write_output, &out) != 0)
+        fprintf(stderr, "Short write, samples lost!\n");
+
+    if (tee.nsinks > 0)
+        tee_close(&tee);
+
+    if (useTrigger) {
+        trigger_close(&trigger, verbose);
+        free(indexname);
+    }
+
+    if (pyramidRow > 0)
+        pyramid_close(&pyramid, verbose);
+
+    if (pipeSpec)
+        pipeline_free(&pipe);
+    free(spec);
+
+    if (indexInterval > 0) {
+        if (verbose == 1)
+            fprintf(stderr, "[DEBUG] %llu time index entries\n", (unsigned long long) tindex.entries);
+        tindex_close(&tindex);
+    }
+    if (adaptive)
+        fprintf(stderr, "adaptive scaling: %llu packets, %llu changes of the shift, %llu packets clipped\n",
+                (unsigned long long) scaler.blocks, (unsigned long long) scaler.changes,
+                (unsigned long long) scaler.clipped);
+
+    fprintf(stderr, "%lu sample-loss events, %lu samples lost\n", lossEvents, lostSamples);
+
     if (do_exit)
         fprintf(stderr, "\nUser cancel, exiting...\n");
     else
         fprintf(stderr, "\nLibrary error %d, exiting...\n", r);
 
-    if (file != stdout)
-        fclose(file);
+    if (out.use_iqz) {
+        if (iqz_writer_close(&out.iqz) != 0)
+            fprintf(stderr, "Failed to finish the compressed recording!\n");
+        else if (verbose == 1)
+            fprintf(stderr, "[DEBUG] compressed %llu bytes to %llu\n", (unsigned long long) out.iqz.raw_bytes,
+                    (unsigned long long) out.iqz.offset);
+        if (out.file != stdout)
+            fclose(out.file);
+    } else if (out.use_ring) {
+        shm_ring_close(&out.ring);
+    } else if (out.use_fd) {
+        fd_output_flush(&out.fdo);
+        fd_output_close(&out.fdo);
+    } else if (out.file != stdout) {
+        fclose(out.file);
+    }
 
 
     if (resultBits == 8) {
-        free(buffer8);
+        rt_free(buffer8, bufferSize * sizeof(uint8_t));
     }
     else {
-        free(buffer16);
+        rt_free(buffer16, bufferSize * sizeof(short));
     }
+    rt_free(ibuf, samplesPerPacket * sizeof(short));
+    rt_free(qbuf, samplesPerPacket * sizeof(short));
 
     out:
+    trace_close();
+    if (bufferSize == 0) /* an output failed to open, the device is open already */
+        mir_sdr_Uninit();
     return r >= 0 ? r : -r;
 }
 
@@ -379,6 +827,20 @@ void adjust_result_bits(int bits, int *ptrResultBits) {
     usage();
 }
 
+void adjust_roll(char *arg, int *ptrPreMs, int *ptrPostMs) {
+    char *sep = strchr(arg, ':');
+
+    *ptrPreMs = atoi(arg);
+    if (sep) {
+        *ptrPostMs = atoi(sep + 1);
+    }
+
+    if (*ptrPreMs < 0 || *ptrPostMs < 0) {
+        fprintf(stderr, "Invalid trigger pre-roll / post-roll (-R) !\n");
+        usage();
+    }
+}
+
 void adjust_if(int ifFreq, mir_sdr_If_kHzT *ptrIFKhz) {
     switch (ifFreq) {
         case 0:
@@ -0,0 +1,173 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  play_shm, example reader of the play_sdr shared memory ring (play_sdr shm:name).
+ *  Forwards the samples to stdout, or with -c only consumes them in place and
+ *  reports throughput and its own CPU time. -i does the same on stdin, for a
+ *  comparison with the classic "play_sdr - | consumer" pipe.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "shmring.h"
+
+#define STDIN_CHUNK (256 * 1024)
+
+static volatile int do_exit = 0;
+
+void usage(void) {
+    fprintf(stderr,
+            "play_shm, reads the shared memory ring published by 'play_sdr shm:name'\n\n"
+                    "Usage:\t[-c seconds: consume in place for that long and report MB/s and CPU time]\n"
+                    "\t[-i read stdin instead (pipe comparison, with -c)]\n"
+                    "\tname\n\n");
+    exit(1);
+}
+
+static void sighandler(int signum) {
+    (void) signum;
+    do_exit = 1;
+}
+
+static double now(void) {
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/* stands in for real processing: every byte is read once */
+static uint32_t touch(const uint8_t *data, long len, uint32_t acc) {
+    long i;
+
+    for (i = 0; i < len; i++)
+        acc += data[i];
+    return acc;
+}
+
+static void report(const char *what, uint64_t bytes, double start) {
+    struct rusage ru;
+    double elapsed = now() - start;
+    double cpu;
+
+    getrusage(RUSAGE_SELF, &ru);
+    cpu = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+    fprintf(stderr, "%s: %.1f MB in %.1f s, %.2f MB/s, cpu %.3f s (%.1f%%)\n", what, bytes / 1e6, elapsed,
+            bytes / 1e6 / elapsed, cpu, 100.0 * cpu / elapsed);
+}
+
+static int read_stdin(int seconds) {
+    uint8_t *buf = malloc(STDIN_CHUNK);
+    uint64_t bytes = 0;
+    uint32_t acc = 0;
+    double start = now();
+    ssize_t n;
+
+    while (!do_exit && now() - start < seconds) {
+        n = read(0, buf, STDIN_CHUNK);
+        if (n <= 0)
+            break;
+        acc = touch(buf, n, acc);
+        bytes += n;
+    }
+
+    report("pipe", bytes, start);
+    free(buf);
+    return acc == 0xffffffff; /* keep the touch loop */
+}
+
+int main(int argc, char **argv) {
+    struct shm_ring ring;
+    const uint8_t *data;
+    uint64_t bytes = 0;
+    uint32_t acc = 0;
+    double start;
+    long n;
+    int opt;
+    int seconds = 0;
+    int useStdin = 0;
+
+    while ((opt = getopt(argc, argv, "c:i")) != -1) {
+        switch (opt) {
+            case 'c':
+                seconds = atoi(optarg);
+                break;
+            case 'i':
+                useStdin = 1;
+                break;
+            default:
+                usage();
+                break;
+        }
+    }
+
+    signal(SIGINT, sighandler);
+    signal(SIGTERM, sighandler);
+    signal(SIGPIPE, sighandler);
+
+    if (useStdin) {
+        if (seconds <= 0)
+            usage();
+        return read_stdin(seconds);
+    }
+
+    if (argc <= optind)
+        usage();
+
+    if (shm_ring_open(&ring, argv[optind]) != 0)
+        exit(1);
+
+    fprintf(stderr, "%s: %llu MB ring, %u S/s, format %s, %u Hz\n", ring.name,
+            (unsigned long long) (ring.size >> 20), ring.hdr->samp_rate,
+            ring.hdr->format == SHM_FMT_CS8 ? "cs8" : "cs16", ring.hdr->frequency);
+
+    start = now();
+    while (!do_exit && (seconds == 0 || now() - start < seconds)) {
+        n = shm_ring_wait(&ring, &data, 100);
+        if (n < 0) {
+            fprintf(stderr, "Writer closed the ring.\n");
+            break;
+        }
+        if (n == 0)
+            continue;
+
+        if (seconds > 0) {
+            acc = touch(data, n, acc);
+        } else if (fwrite(data, 1, n, stdout) != (size_t) n) {
+            break;
+        }
+
+        if (shm_ring_consume(&ring, n) != 0)
+            fprintf(stderr, "Overrun while reading, data was overwritten.\n");
+        bytes += n;
+    }
+
+    if (seconds > 0)
+        report("shm", bytes, start);
+    fprintf(stderr, "%llu overruns, %llu bytes lost\n", (unsigned long long) ring.overruns,
+            (unsigned long long) ring.lost);
+
+    shm_ring_close(&ring);
+    return acc == 0xffffffff;
+}
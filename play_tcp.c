@@ -43,7 +43,12 @@
  *
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* sendmmsg */
+#endif
+
 #include <errno.h>
+#include <math.h>
 #include <signal.h>
 #include <string.h>
 #include <stdio.h>
@@ -57,6 +62,7 @@
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <fcntl.h>
 #else
 #include <winsock2.h>
@@ -64,9 +70,24 @@
 #endif
 
 #include <pthread.h>
+#include <time.h>
 
 #include "mirsdrapi-rsp.h"
 
+#include "ddc.h"
+#include "iqdsp.h"
+#include "lathist.h"
+#include "pipeline.h"
+#include "pktqueue.h"
+#include "rt.h"
+#include "rtltcp.h"
+#include "simsrc.h"
+#include "trace.h"
+#ifndef _WIN32
+#include "filesrc.h"
+#include "shmring.h"
+#endif
+
 #ifdef _WIN32
 #pragma comment(lib, "ws2_32.lib")
 
@@ -83,33 +104,36 @@ typedef int socklen_t;
 
 #endif
 
-static SOCKET s;
-
-static pthread_t tcp_worker_thread;
-static pthread_t command_thread;
-static pthread_cond_t exit_cond;
+#define MAX_SOURCES 8
+#define SOURCE_SIM  -1 /* device number of a simulated receiver */
+#define SOURCE_FILE -2 /* ... and of a recording being replayed */
 
-static pthread_mutex_t exit_cond_lock;
-static pthread_mutex_t ll_mutex;
+#define DEFAULT_MTU     1500
+#define UDP_IP_OVERHEAD 28 /* IPv4 + UDP headers */
+#define UDP_BATCH       32 /* datagrams per sendmmsg */
 
-static pthread_cond_t cond;
-static uint32_t cmd_freq_value;
+#define RSP_PACKET_BYTES        (336 * 2) /* -n counted packets of this size */
+#define LATENCY_REPORT_S        10
 
-int samplesPerPacket, grChanged, fsChanged, rfChanged;
+#define VRX_MAX_CLIENTS         64
+#define VRX_CHUNK_PAIRS         16384   /* wideband pairs a virtual receiver handles at once */
+#define VRX_RING_SECONDS        2       /* shared ring at the capture rate, at least SHM_RING_DEFAULT_SIZE */
 
-static uint32_t bytes_to_read = 0;
-
-struct llist {
-    char *data;
-    size_t len;
-    struct llist *next;
-};
-
-typedef struct { /* structure size must be multiple of 2 bytes */
-    char magic[4];
-    uint32_t tuner_type;
-    uint32_t tuner_gain_count;
-} dongle_info_t;
+/*
+ * UDP streaming (-u): every datagram starts with this header, all fields
+ * in network byte order, followed by 8 bit I/Q pairs. Receivers detect
+ * loss from gaps in seq and place data with sample.
+ */
+typedef struct {
+    char magic[4];          /* "RTLU" */
+    uint32_t seq;
+    uint32_t sample_hi;     /* number of the first I/Q pair of the datagram */
+    uint32_t sample_lo;
+    uint32_t time_sec;      /* wall clock time of that sample */
+    uint32_t time_nsec;
+    uint32_t frequency;
+    uint32_t samp_rate;
+} udp_header_t;
 
 
 typedef struct{
@@ -134,26 +158,141 @@ frequency_allocation_t freqAllocationTable[8] = {{0, 11.999999e6}
                                                 ,{420e6, 999.999999e6}
                                                 ,{1000e6,UINT32_MAX}};
 
-static struct llist *ll_buffers = 0;
-static int llbuf_num = 500;
-
-uint32_t out_block_size = DEFAULT_BUF_LENGTH;
-short *ibuf;
-short *qbuf;
-unsigned int firstSample;
-int n_read;
-int sdrIsInitialized = 0; /* 1, when mir_sdr_init done */
-mir_sdr_ErrT r;
-uint32_t frequency = 100000000;
-int gain = 30;
-uint32_t samp_rate = DEFAULT_SAMPLE_RATE;
-uint8_t *buffer;
-mir_sdr_Bw_MHzT sdr_bw = mir_sdr_BW_1_536;
-int rspMode = 0;
-int rspLNA = 0;
+/*
+ * TCP streaming profiles (-T). bulk lets the kernel size the socket buffer
+ * and coalesce segments for throughput, low keeps little data anywhere
+ * between mir_sdr_ReadPacket and the wire: a 50 ms queue, small sends
+ * without Nagle and a socket buffer just large enough for a client
+ * reading every 20 ms at 2 MS/s.
+ */
+struct stream_profile {
+    const char *name;
+    int nodelay;                /* TCP_NODELAY */
+    int sndbuf;                 /* SO_SNDBUF bytes, 0: kernel autotuning */
+    size_t batch_bytes;         /* taken from the queue per send round, at most one frame */
+    size_t queue_kb;            /* -Q / -L defaults */
+    int queue_ms;
+};
+
+static const struct stream_profile profiles[] = {
+    {"bulk", 0, 0,          64 * 1024, 4096, 1000},
+    {"low",  1, 128 * 1024, 4 * 1024, 1024, 50},
+};
+
+struct rx_source;
+
+/*
+ * A virtual receiver (-V): one client of a wideband source, with its own
+ * frequency and rate. Its sender reads the shared ring through its own
+ * cursor and cuts the client's channel out with a ddc; a client that
+ * falls behind by more than the ring loses samples on its own.
+ */
+struct vrx {
+    struct rx_source *src;
+    int index;
+    volatile int active;        /* slot in use, cleared by the sender at the end of the session */
+    int started;                /* threads to join before the slot is used again */
+    volatile int exit;
+    SOCKET s;
+
+    volatile uint32_t frequency;    /* asked for by the client */
+    volatile uint32_t samp_rate;
+    volatile int changed;           /* set by the command thread, applied by the sender */
+    double offset;                  /* applied: channel centre minus capture centre */
+
+#ifndef _WIN32
+    struct shm_ring reader;
+#endif
+    struct ddc ddc;
+    uint8_t *out;
+    uint64_t sent;
+
+    pthread_t thread;
+    pthread_t command_thread;
+};
+
+/*
+ * One receiver and its pipeline: device settings, capture buffers, the
+ * sample queue and the client session. Every source is served by its own
+ * threads on its own port, so one process can drive several receivers.
+ */
+struct rx_source {
+    int index;
+    int device;                 /* RSP device number or SOURCE_SIM */
+    char *addr;
+    int port;
+
+    uint32_t frequency;
+    int gain;
+    uint32_t samp_rate;
+    mir_sdr_Bw_MHzT sdr_bw;
+    int rspMode;
+    int rspLNA;
+
+    int samplesPerPacket, grChanged, fsChanged, rfChanged;
+    unsigned int firstSample;
+    short *ibuf;
+    short *qbuf;
+    uint8_t *buffer;
+    int sdrIsInitialized;       /* 1, when mir_sdr_init done */
+    int bufferSamples;          /* size of buffer, ibuf and qbuf */
+    int idle_timeout;           /* -I: seconds without a client before powering down, 0: never */
+    struct sim_source sim;
+
+    char *pipe_spec;            /* -D, NULL: plain conversion */
+    struct pipeline pipe;
+
+    char *replay_path;          /* SOURCE_FILE */
+    double replay_speed;
+#ifndef _WIN32
+    struct file_source replay;
+#endif
+
+    char *udp_dest;             /* group:port for UDP streaming, NULL: TCP server */
+    int mtu;
+    uint64_t sample_count;
+
+    int virtual_max;            /* -V: clients with their own channel of the band, 0: one client */
+    struct vrx *vrx;
+#ifndef _WIN32
+    struct shm_ring wide;       /* -V: every packet as 16 bit interleaved I/Q */
+#endif
+    short *wide_iq;
+
+    SOCKET s;
+    volatile int attached;      /* client sessions running (-V: several), packets go to the queue */
+    volatile int session_exit;
+    uint64_t connect_ns;        /* accept of the current client */
+    int warm_at_connect;
+    volatile int framed;        /* client asked for tcp_frame_t framing, 2: with adaptive scaling */
+    struct iq_scaler scaler;    /* -q, used while framed is 2 */
+    uint32_t cmd_freq_value;
+    uint32_t bytes_to_read;
+
+    struct pkt_queue queue;
+    enum pktq_policy queue_policy;
+    size_t queue_bytes;         /* 0: from the profile */
+    int queue_ms;               /* -1: from the profile */
+
+    const struct stream_profile *profile;
+    struct lathist latency;     /* mir_sdr_ReadPacket to the socket, per packet */
+
+    pthread_mutex_t dev_mutex;
+    pthread_cond_t dev_cond;    /* a client attached */
+
+    pthread_t server_thread;
+    pthread_t capture_thread;
+    pthread_t tcp_worker_thread;
+    pthread_t command_thread;
+};
+
+static struct rx_source sources[MAX_SOURCES];
+static int num_sources = 0;
 
 static volatile int do_exit = 0;
 
+int freq_change_req_reinnit(uint32_t old, uint32_t new);
+
 void usage(void)
 {
     printf("play_tcp (rtl_tcp fork for SDRPlay), an I/Q spectrum server for SDRPlay receivers\n\n"
@@ -163,9 +302,39 @@ void usage(void)
                    "\t[-g SDRPlay Gain reduction], see http://www.sdrplay.com/docs/Mirics_SDR_API_Specification.pdf for details\n"
                    "\t[-s samplerate in Hz (default: 2048000 Hz)]\n"
                    "\t[-b number of buffers (default: 15, set by library)]\n"
-                   "\t[-n max number of linked list buffers to keep (default: 500)]\n"
+                   "\t[-O slow client policy: oldest (drop the oldest data), newest (drop incoming data),\n"
+                   "\t    decimate (average down the rate, then drop the oldest), block (hold the\n"
+                   "\t    receiver up to the latency bound, then drop the oldest) (default: oldest)]\n"
+                   "\t[-T streaming profile: bulk for throughput, low for latency (TCP_NODELAY, small\n"
+                   "\t    sends and socket buffer, short queue) (default: bulk)]\n"
+                   "\t[-Q queue memory per receiver in kB (default: 4096, low profile 1024)]\n"
+                   "\t[-L latency bound of the queue in ms, 0 for none (default: 1000, low profile 50)]\n"
+                   "\t[-n queue memory as a number of RSP packets (old form of -Q)]\n"
                    "\t[-r enable gain reduction (default: 0, disabled)]\n"
-                   "\t[-l RSP LNA enable (default: 0, disabled)]\n");
+                   "\t[-l RSP LNA enable (default: 0, disabled)]\n"
+                   "\t[-u group:port stream UDP datagrams to a multicast (or unicast) address instead of\n"
+                   "\t    serving TCP clients, -a selects the outgoing interface]\n"
+                   "\t[-m MTU for -u (default: 1500)]\n"
+                   "\t[-d device: RSP number (0), 'sim' for a simulated receiver or file:recording to replay an\n"
+                   "\t    8 bit play_sdr recording (tuning seeks when it has a time index) (default: 0)]\n"
+                   "\t    repeat -d to serve several receivers, the options following a -d apply to\n"
+                   "\t    that receiver, which listens on the next port unless -p is given\n"
+                   "\t[-D processing pipeline, comma separated: dc[:alpha] swap scale:gain shift:hz\n"
+                   "\t    (default: none, the samples are sent as read)]\n"
+                   "\t[-q adaptive 8 bit scaling for the clients that ask for it (framing command 0x40, param 2):\n"
+                   "\t    peak or rms[:hold_ms] (default: peak:100)]\n"
+                   "\t[-I power the receiver down after that many seconds without a client, it is kept\n"
+                   "\t    streaming in between so clients get samples at once (default: 0, never)]\n"
+                   "\t[-V up to that many clients at once, each with its own channel of the band captured at\n"
+                   "\t    -f / -s: their frequency (0x01) and rate (0x02) commands set a digital downconverter\n"
+                   "\t    in the server, the device stays put (default: 0, one client tuning the device)]\n"
+                   "\t[-R replay speed for file: receivers, 1 real time, 0 as fast as possible (default: 1)]\n"
+                   "\t[-A cpus for the capture[,sender[,command]] threads (default: not pinned)]\n"
+                   "\t    further receivers use the following cpus\n"
+                   "\t[-S capture thread scheduling: fifo:prio, rr:prio or other (default: other)]\n"
+                   "\t[-M memory: 0 default, 1 mlockall and prefault buffers, 2 also huge pages (default: 0)]\n"
+                   "\t[-E trace.json[:seconds] record what each thread spends its time on, for chrome://tracing or\n"
+                   "\t    ui.perfetto.dev (default: off)]\n");
     exit(1);
 }
 
@@ -197,7 +366,6 @@ sighandler(int signum)
 	if (CTRL_C_EVENT == signum) {
 		fprintf(stderr, "Signal caught, exiting!\n");
 		do_exit = 1;
-		rtlsdr_cancel_async(dev);
 		return TRUE;
 	}
 	return FALSE;
@@ -206,152 +374,198 @@ sighandler(int signum)
 static void sighandler(int signum)
 {
     fprintf(stderr, "Signal caught, exiting!\n");
-    // TODO: replace rtlsdr_cancel_async(dev);
     do_exit = 1;
 }
 #endif
 
-void rtlsdr_callback(unsigned char *buf, uint32_t len)
+/* ends the client session of a source, the receiver keeps serving */
+static void end_session(struct rx_source *src)
 {
-    if(!do_exit) {
-        struct llist *rpt = (struct llist*)malloc(sizeof(struct llist));
-        rpt->data = (char*)malloc(len);
-        memcpy(rpt->data, buf, len);
-        rpt->len = len;
-        rpt->next = NULL;
-
-        pthread_mutex_lock(&ll_mutex);
+    src->session_exit = 1;
+}
 
-        if (ll_buffers == NULL) {
-            ll_buffers = rpt;
-        } else {
-            struct llist *cur = ll_buffers;
-            int num_queued = 0;
+static int session_over(struct rx_source *src)
+{
+    return do_exit || src->session_exit;
+}
 
-            while (cur->next != NULL) {
-                cur = cur->next;
-                num_queued++;
-            }
+static uint64_t realtime_ns(void)
+{
+    struct timespec ts;
 
-            if(llbuf_num && llbuf_num == num_queued-2){
-                struct llist *curelem;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
 
-                free(ll_buffers->data);
-                curelem = ll_buffers->next;
-                free(ll_buffers);
-                ll_buffers = curelem;
-            }
+void rtlsdr_callback(struct rx_source *src, unsigned char *buf, uint32_t len, uint64_t time_ns, int shift)
+{
+    uint64_t t = trace_begin();
 
-            cur->next = rpt;
+    if(!session_over(src))
+        pktq_push(&src->queue, buf, len, src->sample_count, time_ns, shift);
+    trace_end("queue push", t, len);
+}
 
+/* 0 when all of buf went out, -1 when the client is gone or the session ends */
+static int send_all(struct rx_source *src, const char *buf, int len)
+{
+    struct timeval tv;
+    fd_set writefds;
+    int r, sent;
+    uint64_t t;
+
+    while (len > 0) {
+        FD_ZERO(&writefds);
+        FD_SET(src->s, &writefds);
+        tv.tv_sec = 1;
+        tv.tv_usec = 0;
+        t = trace_begin();
+        r = select(src->s+1, NULL, &writefds, NULL, &tv);
+        trace_end("select", t, 0);
+        if (session_over(src))
+            return -1;
+        if (r > 0) {
+            t = trace_begin();
+            sent = send(src->s, buf, len, 0);
+            trace_end("send", t, sent);
+            if (sent == SOCKET_ERROR)
+                return -1;
+            buf += sent;
+            len -= sent;
         }
-        pthread_cond_signal(&cond);
-        pthread_mutex_unlock(&ll_mutex);
     }
+
+    return 0;
 }
 
-static void *tcp_worker(void *arg)
+/* a frame runs over the following packets until a drop or a change of decimation or scale */
+static int frame_starts(const struct llist *cur, const struct llist *prev)
 {
-    struct llist *curelem,*prev;
-    int bytesleft,bytessent, index;
-    struct timeval tv= {1,0};
-    struct timespec ts;
-    struct timeval tp;
-    fd_set writefds;
-    int r = 0;
+    return !prev || cur->dropped || cur->decimation != prev->decimation || cur->shift != prev->shift;
+}
 
-    while(1) {
-        if(do_exit)
-            pthread_exit(0);
-
-        pthread_mutex_lock(&ll_mutex);
-        gettimeofday(&tp, NULL);
-        ts.tv_sec  = tp.tv_sec+5;
-        ts.tv_nsec = tp.tv_usec * 1000;
-        r = pthread_cond_timedwait(&cond, &ll_mutex, &ts);
-        if(r == ETIMEDOUT) {
-            pthread_mutex_unlock(&ll_mutex);
-            printf("worker cond timeout\n");
-            sighandler(0);
-            pthread_exit(NULL);
-        }
-
-        curelem = ll_buffers;
-        ll_buffers = 0;
-        pthread_mutex_unlock(&ll_mutex);
-
-        while(curelem != 0) {
-            bytesleft = curelem->len;
-            index = 0;
-            bytessent = 0;
-            while(bytesleft > 0) {
-                FD_ZERO(&writefds);
-                FD_SET(s, &writefds);
-                tv.tv_sec = 1;
-                tv.tv_usec = 0;
-                r = select(s+1, NULL, &writefds, NULL, &tv);
-                if(r) {
-                    bytessent = send(s,  &curelem->data[index], bytesleft, 0);
-                    bytesleft -= bytessent;
-                    index += bytessent;
-                }
-                if(bytessent == SOCKET_ERROR || do_exit) {
-                    printf("worker socket bye\n");
-                    sighandler(0);
-                    pthread_exit(NULL);
-                }
+static int send_frame_header(struct rx_source *src, const struct llist *first)
+{
+    const struct llist *cur, *prev = first;
+    tcp_frame_t frame;
+    size_t len = first->len;
+
+    for (cur = first->next; cur && !frame_starts(cur, prev); prev = cur, cur = cur->next)
+        len += cur->len;
+
+    memcpy(frame.magic, "RTLF", 4);
+    frame.length = htonl((uint32_t)len);
+    frame.sample_hi = htonl((uint32_t)(first->sample >> 32));
+    frame.sample_lo = htonl((uint32_t)first->sample);
+    frame.time_sec = htonl((uint32_t)(first->time_ns / 1000000000ULL));
+    frame.time_nsec = htonl((uint32_t)(first->time_ns % 1000000000ULL));
+    frame.dropped = htonl(first->dropped);
+    frame.gain_bits = htons((uint16_t)(8 - first->shift));
+    frame.decimation = htons((uint16_t)first->decimation);
+
+    return send_all(src, (const char *)&frame, sizeof(frame));
+}
+
+static void *tcp_worker(void *arg)
+{
+    struct rx_source *src = arg;
+    struct llist *batch, *cur, *prev;
+    struct pktq_stats stats;
+    uint64_t reported = 0;
+    time_t last_report = 0, last_latency = time(NULL);
+    char label[48];
+    int framed;
+    char name[16];
+    uint64_t t;
+
+    snprintf(name, sizeof(name), "play_tcp tx%d", src->index);
+    rt_apply_thread_at(RT_SENDER, src->index, name);
+
+    while(!session_over(src)) {
+        /* a pause in the data is no reason to end the session, only a closed socket is */
+        t = trace_begin();
+        batch = pktq_take(&src->queue, src->profile->batch_bytes, 1000);
+        trace_end("queue take", t, 0);
+        if (!batch)
+            continue;
+
+        framed = src->framed;
+        for (prev = NULL, cur = batch; cur; prev = cur, cur = cur->next) {
+            if ((framed && frame_starts(cur, prev) && send_frame_header(src, cur) != 0) ||
+                send_all(src, cur->data, (int)cur->len) != 0) {
+                printf("worker socket bye\n");
+                pktq_release(batch);
+                end_session(src);
+                pthread_exit(NULL);
+            }
+            if (src->latency.n == 0)
+                printf("[rx%d] first samples %.2f ms after accept (%s)\n", src->index,
+                       (realtime_ns() - src->connect_ns) / 1e6,
+                       src->warm_at_connect ? "device warm" : "device powered up");
+            lathist_add(&src->latency, realtime_ns() - cur->time_ns);
+        }
+        pktq_release(batch);
+
+        /* raw rtl_tcp clients cannot be told, keep the operator informed */
+        if (time(NULL) != last_report) {
+            last_report = time(NULL);
+            pthread_mutex_lock(&src->queue.mutex);
+            stats = src->queue.stats;
+            pthread_mutex_unlock(&src->queue.mutex);
+            if (stats.dropped_packets != reported) {
+                printf("[rx%d] slow client, %llu packets (%llu kB) dropped so far, policy %s\n", src->index,
+                       (unsigned long long)stats.dropped_packets, (unsigned long long)stats.dropped_bytes / 1024,
+                       pktq_policy_name(src->queue.policy));
+                reported = stats.dropped_packets;
+            }
+            if (last_report - last_latency >= LATENCY_REPORT_S) {
+                last_latency = last_report;
+                snprintf(label, sizeof(label), "[rx%d] latency to socket (%s)", src->index, src->profile->name);
+                lathist_print(&src->latency, label, stdout);
             }
-            prev = curelem;
-            curelem = curelem->next;
-            free(prev->data);
-            free(prev);
         }
     }
-}
 
-#ifdef _WIN32
-#define __attribute__(x)
-#pragma pack(push, 1)
-#endif
-struct command{
-    unsigned char cmd;
-    unsigned int param;
-}__attribute__((packed));
+    return NULL;
+}
 
-#ifdef _WIN32
-#pragma pack(pop)
-#endif
 static void *command_worker(void *arg)
 {
+    struct rx_source *src = arg;
     int left, received = 0;
     fd_set readfds;
     struct command cmd={0, 0};
     struct timeval tv= {1, 0};
     int r = 0;
     uint32_t tmp;
+    char name[16];
+
+    snprintf(name, sizeof(name), "play_tcp cmd%d", src->index);
+    rt_apply_thread_at(RT_WRITER, src->index, name);
 
     while(1) {
         left=sizeof(cmd);
         while(left >0) {
             FD_ZERO(&readfds);
-            FD_SET(s, &readfds);
+            FD_SET(src->s, &readfds);
             tv.tv_sec = 1;
             tv.tv_usec = 0;
-            r = select(s+1, &readfds, NULL, NULL, &tv);
+            r = select(src->s+1, &readfds, NULL, NULL, &tv);
             if(r) {
-                received = recv(s, (char*)&cmd+(sizeof(cmd)-left), left, 0);
+                received = recv(src->s, (char*)&cmd+(sizeof(cmd)-left), left, 0);
                 left -= received;
             }
-            if(received == SOCKET_ERROR || do_exit) {
+            if(received == SOCKET_ERROR || session_over(src)) {
                 printf("comm recv bye\n");
-                sighandler(0);
+                end_session(src);
                 pthread_exit(NULL);
             }
         }
         switch(cmd.cmd) {
             case 0x01:
                 printf("set freq %d\n", ntohl(cmd.param));
-                cmd_freq_value = ntohl(cmd.param);
+                src->cmd_freq_value = ntohl(cmd.param);
+                trace_instant("set freq", src->cmd_freq_value);
                 break;
             case 0x02:
                 printf("set sample rate %d\n !Not implemented for SDRPlay (not yet...)\n", ntohl(cmd.param));
@@ -391,6 +605,10 @@ static void *command_worker(void *arg)
             case 0x0d:
                 printf("set tuner gain by index %d\n !Not implemented for SDRPlay (not yet...)\"", ntohl(cmd.param));
                 break;
+            case CMD_SET_FRAMING:
+                src->framed = ntohl(cmd.param) > 2 ? 1 : (int)ntohl(cmd.param);
+                printf("framed stream %s\n", src->framed == 2 ? "on, adaptive scaling" : src->framed ? "on" : "off");
+                break;
             default:
                 break;
         }
@@ -400,18 +618,26 @@ static void *command_worker(void *arg)
 
 
 
-void sdrplay_reinit(){
+void sdrplay_reinit(struct rx_source *src){
+
+    mir_sdr_ErrT r;
+
+    printf("======>>>>> REINIT F: %d\n", src->frequency);
 
-    printf("======>>>>> REINIT F: %d\n", frequency);
+    if (src->device == SOURCE_SIM) {
+        sim_init(&src->sim, src->samp_rate, src->frequency, &src->samplesPerPacket);
+        src->sdrIsInitialized = 1;
+        return;
+    }
 
-    if(sdrIsInitialized == 1) {
+    if(src->sdrIsInitialized == 1) {
         r = mir_sdr_Uninit();
     }
 
-    if (rspMode == 1)
+    if (src->rspMode == 1)
     {
         mir_sdr_SetParam(201,1);
-        if (rspLNA == 1)
+        if (src->rspLNA == 1)
         {
             mir_sdr_SetParam(202,0);
         }
@@ -419,13 +645,13 @@ void sdrplay_reinit(){
         {
             mir_sdr_SetParam(202,1);
         }
-        r = mir_sdr_Init(gain, (samp_rate/1e6), (frequency/1e6),
-                         sdr_bw, mir_sdr_IF_Zero, &samplesPerPacket );
+        r = mir_sdr_Init(src->gain, (src->samp_rate/1e6), (src->frequency/1e6),
+                         src->sdr_bw, mir_sdr_IF_Zero, &src->samplesPerPacket );
     }
     else
     {
-        r = mir_sdr_Init((78-gain), (samp_rate/1e6), (frequency/1e6),
-                         sdr_bw, mir_sdr_IF_Zero, &samplesPerPacket );
+        r = mir_sdr_Init((78-src->gain), (src->samp_rate/1e6), (src->frequency/1e6),
+                         src->sdr_bw, mir_sdr_IF_Zero, &src->samplesPerPacket );
     }
 
     if (r != mir_sdr_Success) {
@@ -433,11 +659,11 @@ void sdrplay_reinit(){
         exit(1);
     }
 
-    while(mir_sdr_Success != mir_sdr_SetRf(frequency, 1, 0)){
+    while(mir_sdr_Success != mir_sdr_SetRf(src->frequency, 1, 0)){
         printf("SetRf rejected, retry....\n");
     }
 
-    printf("SetRf to %d\n", frequency);
+    printf("SetRf to %d\n", src->frequency);
 
     mir_sdr_SetDcMode(4,0);
     mir_sdr_SetDcTrackTime(63);
@@ -454,73 +680,236 @@ void sdrplay_reinit(){
         fprintf(stderr, "Failed to onfigure DC tracking in tuner of RSP device.\n");
     }
 
-    sdrIsInitialized = 1;
+    src->sdrIsInitialized = 1;
 
 }
 
-void sdrplay_rx(){
+static void sdrplay_set_rf(struct rx_source *src)
+{
+    if (src->device == SOURCE_SIM)
+        sim_set_rf(&src->sim, src->frequency);
+    else
+        mir_sdr_SetRf(src->frequency, 1, 0);
+}
 
-    buffer = malloc(out_block_size * sizeof(uint8_t));
-    sdrplay_reinit();
+static mir_sdr_ErrT sdrplay_read_packet(struct rx_source *src)
+{
+    if (src->device == SOURCE_SIM) {
+        src->grChanged = src->rfChanged = src->fsChanged = 0;
+        sim_read_packet(&src->sim, src->ibuf, src->qbuf, &src->firstSample);
+        return mir_sdr_Success;
+    }
 
+    return mir_sdr_ReadPacket(src->ibuf, src->qbuf, &src->firstSample, &src->grChanged, &src->rfChanged,
+                              &src->fsChanged);
+}
 
+/* Init and the buffers of one packet, the device streams from here on */
+static void rx_power_up(struct rx_source *src)
+{
+    uint64_t t = trace_begin();
 
-    ibuf = malloc(samplesPerPacket * sizeof(short));
-    qbuf = malloc(samplesPerPacket * sizeof(short));
+    sdrplay_reinit(src);
 
-    int i, j;
+    src->bufferSamples = src->samplesPerPacket;
+    src->buffer = rt_alloc(src->bufferSamples * 2 * sizeof(uint8_t));
+    src->ibuf = rt_alloc(src->bufferSamples * sizeof(short));
+    src->qbuf = rt_alloc(src->bufferSamples * sizeof(short));
+    if (src->virtual_max)
+        src->wide_iq = rt_alloc(src->bufferSamples * 2 * sizeof(short));
 
+    if (src->pipe_spec && (pipeline_parse(&src->pipe, src->pipe_spec, src->samp_rate, 8) != 0 ||
+                           pipeline_prepare(&src->pipe, src->bufferSamples) != 0)) {
+        fprintf(stderr, "Failed to set up the pipeline.\n");
+        exit(1);
+    }
+    trace_end("power up", t, 0);
+}
 
+static void rx_power_down(struct rx_source *src)
+{
+    trace_instant("power down", 0);
+    if (src->device >= 0)
+        mir_sdr_Uninit();
+    src->sdrIsInitialized = 0;
+
+    if (src->pipe_spec)
+        pipeline_free(&src->pipe);
+    rt_free(src->buffer, src->bufferSamples * 2 * sizeof(uint8_t));
+    rt_free(src->ibuf, src->bufferSamples * sizeof(short));
+    rt_free(src->qbuf, src->bufferSamples * sizeof(short));
+    if (src->virtual_max)
+        rt_free(src->wide_iq, src->bufferSamples * 2 * sizeof(short));
+}
 
-    while (!do_exit) {
+/* sleeps until a client attaches (or one second passed) */
+static void rx_wait_for_client(struct rx_source *src)
+{
+    struct timespec ts;
 
+    pthread_mutex_lock(&src->dev_mutex);
+    if (!src->attached && !do_exit) {
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += 1;
+        pthread_cond_timedwait(&src->dev_cond, &src->dev_mutex, &ts);
+    }
+    pthread_mutex_unlock(&src->dev_mutex);
+}
 
+/*
+ * Capture loop of a source, runs until exit. The device stays initialised
+ * and is read while no client is attached, so a client gets samples as
+ * soon as its session starts; after idle_timeout seconds without one it
+ * is powered down and the next client waits for Init again.
+ */
+void sdrplay_rx(struct rx_source *src){
 
-        if(cmd_freq_value != frequency){
+    unsigned int nextSample = 0;
+    unsigned long packets = 0, lossEvents = 0, lostSamples = 0;
+    int n_read, shift, scaling = 0;
+    int32_t gap;
+    uint64_t time_ns, idle_since, t;
+    mir_sdr_ErrT r;
 
-            if(freq_change_req_reinnit(frequency,cmd_freq_value) == 1) {
+    src->cmd_freq_value = src->frequency;
+    rx_power_up(src);
+    idle_since = realtime_ns();
+
+    int i, j;
 
-                frequency = cmd_freq_value;
-                sdrplay_reinit();
+    while (!do_exit) {
+
+        if (!src->sdrIsInitialized) {
+            if (!src->attached) {
+                rx_wait_for_client(src);
+                continue;
+            }
+            printf("[rx%d] client waiting, powering up\n", src->index);
+            rx_power_up(src);
+            packets = 0;
+        }
+
+        if(src->cmd_freq_value != src->frequency){
+
+            t = trace_begin();
+            if(freq_change_req_reinnit(src->frequency,src->cmd_freq_value) == 1) {
+
+                src->frequency = src->cmd_freq_value;
+                sdrplay_reinit(src);
+                packets = 0; /* Init restarts the sample numbers */
             }else{
-                frequency = cmd_freq_value; // update tracking freq;
-                mir_sdr_SetRf(frequency, 1, 0);
+                src->frequency = src->cmd_freq_value; // update tracking freq;
+                sdrplay_set_rf(src);
             }
+            trace_end("retune", t, src->frequency);
 
             printf("*************** freq change req ****************\n");
 
         }
 
-        r = mir_sdr_ReadPacket(ibuf, qbuf, &firstSample, &grChanged, &rfChanged,
-                               &fsChanged);
-
+        t = trace_begin();
+        r = sdrplay_read_packet(src);
+        time_ns = realtime_ns();
+        trace_end("ReadPacket", t, src->samplesPerPacket);
 
         if (r != mir_sdr_Success) {
             fprintf(stderr, "WARNING: ReadPacket failed.\n");
-            break;
+            rx_power_down(src);
+            continue;
         }
 
-        j = 0;
-        for (i=0; i < samplesPerPacket; i++)
-        {
-            buffer[j++] = (unsigned char) (ibuf[i] >> 8);
-            buffer[j++] = (unsigned char) (qbuf[i] >> 8);
+        /* the API numbers samples, a jump forward means the device buffers overflowed */
+        gap = (int32_t) (src->firstSample - nextSample);
+        if (packets++ > 0 && gap > 0 && !src->fsChanged) {
+            lossEvents++;
+            lostSamples += gap;
+            trace_instant("samples lost", gap);
+            /* the stream numbers skip what the device lost, never an Init (packets is 0 after one) */
+            src->sample_count += (uint64_t) gap;
         }
+        nextSample = src->firstSample + src->samplesPerPacket;
+
+        /* nobody listening: keep the device streaming, skip the conversion */
+        if (!src->attached || session_over(src)) {
+            src->sample_count += src->samplesPerPacket;
+            if (src->idle_timeout > 0 && !src->attached &&
+                time_ns - idle_since > (uint64_t)src->idle_timeout * 1000000000ULL) {
+                printf("[rx%d] no client for %d s, powering down\n", src->index, src->idle_timeout);
+                rx_power_down(src);
+            }
+            continue;
+        }
+        idle_since = time_ns;
 
-        n_read = (samplesPerPacket * 2);
+#ifndef _WIN32
+        /* virtual receivers: the whole band to the shared ring, each client cuts its own channel */
+        if (src->virtual_max) {
+            t = trace_begin();
+            for (i = 0; i < src->samplesPerPacket; i++) {
+                src->wide_iq[2 * i] = src->ibuf[i];
+                src->wide_iq[2 * i + 1] = src->qbuf[i];
+            }
+            shm_ring_write(&src->wide, src->wide_iq, src->samplesPerPacket * 2 * sizeof(short));
+            trace_end("ring write", t, src->samplesPerPacket);
+            src->sample_count += src->samplesPerPacket;
+            continue;
+        }
+#endif
 
-        if ((bytes_to_read > 0) && (bytes_to_read <= (uint32_t)n_read)) {
-            n_read = bytes_to_read;
-            do_exit = 1;
+        /* a client asking for scaling starts from the top byte */
+        if ((src->framed == 2) != scaling) {
+            scaling = src->framed == 2;
+            iq_scaler_reset(&src->scaler, src->samp_rate);
         }
 
-        rtlsdr_callback(buffer, n_read);
+        t = trace_begin();
+        shift = 8;
+        if (src->pipe_spec) {
+            n_read = pipeline_run(&src->pipe, src->ibuf, src->qbuf, src->samplesPerPacket, src->buffer) * 2;
+        } else if (scaling) {
+            shift = iq_scaler_update(&src->scaler, src->ibuf, src->qbuf, src->samplesPerPacket);
+            iq_to8_shift(src->ibuf, src->qbuf, src->samplesPerPacket, shift, src->buffer);
+            n_read = src->samplesPerPacket * 2;
+        } else {
+            j = 0;
+            for (i=0; i < src->samplesPerPacket; i++)
+            {
+                src->buffer[j++] = (unsigned char) (src->ibuf[i] >> 8);
+                src->buffer[j++] = (unsigned char) (src->qbuf[i] >> 8);
+            }
+
+            n_read = (src->samplesPerPacket * 2);
+        }
+        trace_end(src->pipe_spec ? "pipeline" : "convert", t, src->samplesPerPacket);
 
-        if (bytes_to_read > 0)
-            bytes_to_read -= n_read;
+        if ((src->bytes_to_read > 0) && (src->bytes_to_read <= (uint32_t)n_read)) {
+            n_read = src->bytes_to_read;
+            end_session(src);
+        }
+
+        rtlsdr_callback(src, src->buffer, n_read, time_ns, shift);
+        src->sample_count += n_read / 2;
+
+        if (src->bytes_to_read > 0)
+            src->bytes_to_read -= n_read;
     }
 
+    printf("%lu sample-loss events, %lu samples lost\n", lossEvents, lostSamples);
 
+    if (src->sdrIsInitialized)
+        rx_power_down(src);
+}
+
+static void *capture_worker(void *arg)
+{
+    struct rx_source *src = arg;
+    char name[16];
+
+    snprintf(name, sizeof(name), "play_tcp rx%d", src->index);
+    rt_apply_thread_at(RT_CAPTURE, src->index, name);
+
+    sdrplay_rx(src);
+    return NULL;
 }
 
 double atofs(char *s)
@@ -551,119 +940,553 @@ double atofs(char *s)
 
 }
 
+#ifndef _WIN32
+static int udp_send_batch(struct rx_source *src, struct mmsghdr *msgs, int n, unsigned long *errors)
+{
+    int sent = 0, r;
+    uint64_t t;
+
+    while (sent < n) {
+        t = trace_begin();
+        r = sendmmsg(src->s, msgs + sent, n - sent, 0);
+        trace_end("sendmmsg", t, r);
+        if (r < 0) {
+            if (errno == EINTR)
+                continue;
+            /* ENOBUFS / ECONNREFUSED: the datagrams are lost, receivers see the seq gap */
+            (*errors)++;
+            return -1;
+        }
+        sent += r;
+    }
+
+    return 0;
+}
 
-int main(int argc, char **argv)
+/* closes the datagram at *n with len bytes, sends the batch once it is full */
+static void udp_queue_datagram(struct rx_source *src, struct mmsghdr *msgs, int *n, size_t len,
+                               unsigned long *datagrams, unsigned long *errors)
 {
-    int r, opt, i;
-    char* addr = "127.0.0.1";
-    int port = 1234;
+    msgs[*n].msg_hdr.msg_iov->iov_len = len;
+    if (++*n == UDP_BATCH) {
+        udp_send_batch(src, msgs, *n, errors);
+        *datagrams += *n;
+        *n = 0;
+    }
+}
 
-    struct sockaddr_in local, remote;
-    uint32_t buf_num = 0;
-    int dev_index = 0;
-    int dev_given = 0;
-    gain = 30;
-    int ppm_error = 0;
-    struct llist *curelem,*prev;
-    pthread_attr_t attr;
+/*
+ * Cuts the queued packets into MTU sized datagrams and hands them to the
+ * kernel UDP_BATCH at a time. The cost does not depend on how many
+ * receivers joined the group. A datagram only spans packets that follow
+ * each other: at a drop, a gap in the sample numbers or a change of
+ * decimation or scale the open one goes out short.
+ */
+static void *udp_worker(void *arg)
+{
+    struct rx_source *src = arg;
+    int payload = (src->mtu - UDP_IP_OVERHEAD - (int)sizeof(udp_header_t)) & ~1;
+    size_t stride = sizeof(udp_header_t) + payload;
+    uint8_t *dgrams = malloc(UDP_BATCH * stride);
+    struct mmsghdr msgs[UDP_BATCH];
+    struct iovec iovs[UDP_BATCH];
+    struct llist *batch, *cur;
+    udp_header_t *hdr;
+    unsigned long datagrams = 0, errors = 0;
+    uint32_t seq = 0, decimation = 0, shift = 0;
+    size_t offset, chunk;
+    uint64_t sample, time_ns, next_sample = 0;
+    int fill = 0, n = 0;
+    char name[16];
+
+    snprintf(name, sizeof(name), "play_tcp tx%d", src->index);
+    rt_apply_thread_at(RT_SENDER, src->index, name);
+
+    memset(msgs, 0, sizeof(msgs));
+    for (n = 0; n < UDP_BATCH; n++) {
+        iovs[n].iov_base = dgrams + n * stride;
+        msgs[n].msg_hdr.msg_iov = &iovs[n];
+        msgs[n].msg_hdr.msg_iovlen = 1;
+    }
+    n = 0;
+
+    while (!session_over(src)) {
+        batch = pktq_take(&src->queue, 0, 1000);
+
+        for (cur = batch; cur; cur = cur->next) {
+            if (fill > 0 && (cur->dropped || cur->sample != next_sample || cur->decimation != decimation ||
+                             cur->shift != shift)) {
+                udp_queue_datagram(src, msgs, &n, sizeof(udp_header_t) + fill, &datagrams, &errors);
+                fill = 0;
+            }
+            decimation = cur->decimation;
+            shift = cur->shift;
+            next_sample = cur->sample + (uint64_t)(cur->len / 2) * decimation;
+
+            offset = 0;
+            while (offset < cur->len) {
+                hdr = (udp_header_t *)(dgrams + n * stride);
+                if (fill == 0) {
+                    sample = cur->sample + (uint64_t)(offset / 2) * decimation;
+                    time_ns = cur->time_ns + (uint64_t)(offset / 2) * decimation * 1000000000ULL / src->samp_rate;
+                    memcpy(hdr->magic, "RTLU", 4);
+                    hdr->seq = htonl(seq++);
+                    hdr->sample_hi = htonl((uint32_t)(sample >> 32));
+                    hdr->sample_lo = htonl((uint32_t)sample);
+                    hdr->time_sec = htonl((uint32_t)(time_ns / 1000000000ULL));
+                    hdr->time_nsec = htonl((uint32_t)(time_ns % 1000000000ULL));
+                    hdr->frequency = htonl(src->frequency);
+                    hdr->samp_rate = htonl(src->samp_rate);
+                }
+
+                chunk = cur->len - offset;
+                if (chunk > (size_t)(payload - fill))
+                    chunk = payload - fill;
+                memcpy((uint8_t *)(hdr + 1) + fill, cur->data + offset, chunk);
+                fill += chunk;
+                offset += chunk;
+
+                if (fill == payload) {
+                    udp_queue_datagram(src, msgs, &n, stride, &datagrams, &errors);
+                    fill = 0;
+                }
+            }
+        }
+        pktq_release(batch);
+
+        /* queue drained, do not hold back complete datagrams */
+        if (n > 0) {
+            udp_send_batch(src, msgs, n, &errors);
+            datagrams += n;
+            if (fill > 0) /* move the open datagram to the front of the batch */
+                memmove(dgrams, dgrams + n * stride, sizeof(udp_header_t) + fill);
+            n = 0;
+        }
+    }
+
+    printf("[%s] %lu datagrams sent, %lu send errors\n", name, datagrams, errors);
+    free(dgrams);
+    return NULL;
+}
+
+/* -u mode: no listening socket, the source streams to the group until exit */
+static void udp_server(struct rx_source *src)
+{
+    struct sockaddr_in dest;
+    struct in_addr ifaddr;
+    char group[64], *sep;
+    unsigned char ttl = 1, loop = 1;
+    int sndbuf = 4 * 1024 * 1024;
     void *status;
-    struct timeval tv = {1,0};
-    struct linger ling = {1,0};
-    SOCKET listensocket;
-    socklen_t rlen;
-    fd_set readfds;
-    u_long blockmode = 1;
-    dongle_info_t dongle_info;
 
-#ifdef _WIN32
-    WSADATA wsd;
-	i = WSAStartup(MAKEWORD(2,2), &wsd);
-#else
-    struct sigaction sigact, sigign;
+    snprintf(group, sizeof(group), "%s", src->udp_dest);
+    sep = strrchr(group, ':');
+    if (!sep) {
+        fprintf(stderr, "Invalid UDP destination %s, expected group:port\n", src->udp_dest);
+        do_exit = 1;
+        return;
+    }
+    *sep = '\0';
+
+    memset(&dest, 0, sizeof(dest));
+    dest.sin_family = AF_INET;
+    dest.sin_port = htons(atoi(sep + 1));
+    if (inet_pton(AF_INET, group, &dest.sin_addr) != 1) {
+        fprintf(stderr, "Invalid UDP destination address %s\n", group);
+        do_exit = 1;
+        return;
+    }
+
+    src->s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    setsockopt(src->s, SOL_SOCKET, SO_SNDBUF, (char *)&sndbuf, sizeof(sndbuf));
+    if (IN_MULTICAST(ntohl(dest.sin_addr.s_addr))) {
+        ifaddr.s_addr = inet_addr(src->addr);
+        setsockopt(src->s, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+        setsockopt(src->s, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+        if (setsockopt(src->s, IPPROTO_IP, IP_MULTICAST_IF, &ifaddr, sizeof(ifaddr)) != 0)
+            fprintf(stderr, "Cannot send multicast via %s: %s\n", src->addr, strerror(errno));
+    }
+    if (connect(src->s, (struct sockaddr *)&dest, sizeof(dest)) != 0) {
+        fprintf(stderr, "Cannot stream to %s: %s\n", src->udp_dest, strerror(errno));
+        closesocket(src->s);
+        do_exit = 1;
+        return;
+    }
+
+    printf("streaming %d byte datagrams to %s via %s\n", src->mtu - UDP_IP_OVERHEAD, src->udp_dest, src->addr);
+
+    src->cmd_freq_value = src->frequency;
+    src->attached = 1;
+    pthread_create(&src->tcp_worker_thread, NULL, udp_worker, src);
+
+    sdrplay_rx(src);
+    end_session(src);
+
+    pthread_join(src->tcp_worker_thread, &status);
+    closesocket(src->s);
+}
 #endif
 
-    while ((opt = getopt(argc, argv, "a:p:f:g:s:b:n:d:P:r:l:")) != -1) {
-        switch (opt) {
-            case 'd':
-                //dev_index = verbose_device_search(optarg);
-                //dev_given = 1;//FIXME
-                break;
-            case 'r':
-                rspMode = atoi(optarg);
-                break;
-            case 'l':
-                rspLNA = atoi(optarg);
-                break;
-            case 'f':
-                frequency = (uint32_t)atofs(optarg);
-                break;
-            case 'g':
-                gain = (int)(atof(optarg) * 10); /* tenths of a dB *///FIXME
-                break;
-            case 's':
-                samp_rate = (uint32_t)atofs(optarg);//FIXME
-                break;
-            case 'a':
-                addr = optarg;
-                break;
-            case 'p':
-                port = atoi(optarg);
-                break;
-            case 'b':
-                buf_num = atoi(optarg);
-                break;
-            case 'n':
-                llbuf_num = atoi(optarg);
+#ifndef _WIN32
+/* a file: source sends straight from the page cache, no capture thread or queue */
+static void replay_session(struct rx_source *src)
+{
+    struct linger graceful = {0, 0};
+    unsigned long long sent = 0;
+    void *status;
+    long n;
+
+    pthread_create(&src->command_thread, NULL, command_worker, src);
+
+    file_source_rewind(&src->replay);
+    src->frequency = src->cmd_freq_value = src->replay.frequency ? src->replay.frequency : src->frequency;
+
+    while (!session_over(src)) {
+        if (src->cmd_freq_value != src->frequency) {
+            if (file_source_tune(&src->replay, src->cmd_freq_value) == 0)
+                printf("replay: seek to the segment at %u Hz\n", src->cmd_freq_value);
+            else
+                printf("replay: nothing recorded at %u Hz, continuing\n", src->cmd_freq_value);
+            src->frequency = src->cmd_freq_value;
+        }
+
+        n = file_source_send(&src->replay, src->s);
+        if (n <= 0) {
+            printf(n == 0 ? "replay: end of recording\n" : "replay: client gone\n");
+            if (n == 0) { /* graceful close, the client gets the tail of the recording */
+                setsockopt(src->s, SOL_SOCKET, SO_LINGER, (char *)&graceful, sizeof(graceful));
+                shutdown(src->s, SHUT_WR);
+            }
+            end_session(src);
+            break;
+        }
+        sent += n;
+    }
+
+    printf("replay: %llu bytes sent\n", sent);
+    pthread_join(src->command_thread, &status);
+}
+#endif
+
+#ifndef _WIN32
+/* 0 when all of buf went out, -1 when the client is gone or the session ends */
+static int vrx_send(struct vrx *v, const uint8_t *buf, size_t len)
+{
+    struct timeval tv;
+    fd_set writefds;
+    ssize_t sent;
+    int r;
+    uint64_t t;
+
+    while (len > 0) {
+        FD_ZERO(&writefds);
+        FD_SET(v->s, &writefds);
+        tv.tv_sec = 1;
+        tv.tv_usec = 0;
+        r = select(v->s+1, NULL, &writefds, NULL, &tv);
+        if (do_exit || v->exit)
+            return -1;
+        if (r > 0) {
+            t = trace_begin();
+            sent = send(v->s, buf, len, MSG_NOSIGNAL);
+            trace_end("send", t, sent);
+            if (sent <= 0)
+                return -1;
+            buf += sent;
+            len -= sent;
+        }
+    }
+
+    return 0;
+}
+
+/* applies the client's last frequency and rate to its ddc */
+static void vrx_tune(struct vrx *v)
+{
+    struct rx_source *src = v->src;
+    uint32_t frequency, rate;
+    double offset;
+    int factor;
+
+    v->changed = 0;
+    frequency = v->frequency;
+    rate = v->samp_rate;
+
+    /* the nearest whole fraction of the capture rate */
+    factor = rate ? (int)((double)src->samp_rate / rate + 0.5) : 1;
+    if (factor < 1)
+        factor = 1;
+    if (src->samp_rate / factor != rate)
+        printf("[rx%d v%d] rate %u S/s asked, %u S/s sent (1/%d of the capture)\n", src->index, v->index, rate,
+               src->samp_rate / factor, factor);
+
+    offset = (double)frequency - src->frequency;
+    if (fabs(offset) >= src->samp_rate / 2.0) {
+        printf("[rx%d v%d] %u Hz is outside the band captured around %u Hz (%u S/s), staying at %.0f Hz\n",
+               src->index, v->index, frequency, src->frequency, src->samp_rate, src->frequency + v->offset);
+        offset = v->offset;
+    }
+
+    if (factor != v->ddc.factor) {
+        ddc_free(&v->ddc);
+        if (ddc_init(&v->ddc, src->samp_rate, offset, factor, VRX_CHUNK_PAIRS) != 0) {
+            fprintf(stderr, "[rx%d v%d] failed to set up the downconverter\n", src->index, v->index);
+            v->exit = 1;
+            return;
+        }
+    } else if (offset != v->offset) {
+        ddc_retune(&v->ddc, offset);
+    }
+    v->offset = offset;
+    trace_instant("vrx tune", (int64_t)offset);
+    printf("[rx%d v%d] channel at %.0f Hz, %u S/s\n", src->index, v->index, src->frequency + offset,
+           src->samp_rate / factor);
+}
+
+static void *vrx_command_worker(void *arg)
+{
+    struct vrx *v = arg;
+    struct command cmd;
+    fd_set readfds;
+    struct timeval tv;
+    int left, received, r;
+    char name[16];
+
+    snprintf(name, sizeof(name), "play_tcp vc%d.%d", v->src->index, v->index);
+    rt_apply_thread_at(RT_WRITER, v->src->index, name);
+
+    while (!do_exit && !v->exit) {
+        left = sizeof(cmd);
+        while (left > 0) {
+            FD_ZERO(&readfds);
+            FD_SET(v->s, &readfds);
+            tv.tv_sec = 1;
+            tv.tv_usec = 0;
+            r = select(v->s+1, &readfds, NULL, NULL, &tv);
+            if (do_exit || v->exit)
+                goto out;
+            if (r > 0) {
+                received = recv(v->s, (char *)&cmd + (sizeof(cmd) - left), left, 0);
+                if (received <= 0)
+                    goto out;
+                left -= received;
+            }
+        }
+        switch (cmd.cmd) {
+            case 0x01:
+                v->frequency = ntohl(cmd.param);
+                v->changed = 1;
                 break;
-            case 'P':
-                ppm_error = atoi(optarg);
+            case 0x02:
+                v->samp_rate = ntohl(cmd.param);
+                v->changed = 1;
                 break;
             default:
-                usage();
+                /* gain and the like would change the device for every client */
+                printf("[rx%d v%d] command 0x%02x %u ignored, the receiver is shared\n", v->src->index, v->index,
+                       cmd.cmd, ntohl(cmd.param));
                 break;
         }
     }
 
-    if (argc < optind)
-        usage();
+    out:
+    v->exit = 1;
+    return NULL;
+}
 
-    if (!dev_given) {
-        //dev_index = verbose_device_search("0");
+static void *vrx_worker(void *arg)
+{
+    struct vrx *v = arg;
+    struct rx_source *src = v->src;
+    const uint8_t *data;
+    void *status;
+    long avail;
+    int pairs, n;
+    uint64_t t, torn = 0;
+    char name[16];
+
+    snprintf(name, sizeof(name), "play_tcp v%d.%d", src->index, v->index);
+    rt_apply_thread_at(RT_SENDER, src->index, name);
+
+    while (!do_exit && !v->exit && (avail = shm_ring_wait(&v->reader, &data, 1000)) >= 0) {
+        if (v->changed)
+            vrx_tune(v);
+        if (avail == 0 || v->exit)
+            continue;
+
+        pairs = avail / (2 * sizeof(short));
+        if (pairs > VRX_CHUNK_PAIRS)
+            pairs = VRX_CHUNK_PAIRS;
+
+        t = trace_begin();
+        n = ddc_run(&v->ddc, (const short *)data, pairs, v->out);
+        trace_end("ddc", t, pairs);
+        if (shm_ring_consume(&v->reader, pairs * 2 * sizeof(short)) != 0)
+            torn++;
+
+        if (n > 0 && vrx_send(v, v->out, n * 2) != 0)
+            break;
+        v->sent += n * 2;
     }
 
-    if (dev_index < 0) {
-        exit(1);
+    v->exit = 1;
+    pthread_join(v->command_thread, &status);
+    closesocket(v->s);
+    printf("[rx%d v%d] client gone, %.1f MB sent, %llu overruns (%.1f MB of the band lost)", src->index, v->index,
+           v->sent / 1e6, (unsigned long long)v->reader.overruns, v->reader.lost / 1e6);
+    if (torn)
+        printf(", %llu chunks overwritten while being read", (unsigned long long)torn);
+    printf("\n");
+
+    shm_ring_close(&v->reader);
+    ddc_free(&v->ddc);
+    free(v->out);
+
+    pthread_mutex_lock(&src->dev_mutex);
+    src->attached--;
+    v->active = 0;
+    pthread_mutex_unlock(&src->dev_mutex);
+
+    return NULL;
+}
+
+/* gives an accepted client a free virtual receiver, closes it when there is none */
+static void vrx_attach(struct rx_source *src, SOCKET s)
+{
+    struct vrx *v = NULL;
+    void *status;
+    int k;
+
+    pthread_mutex_lock(&src->dev_mutex);
+    for (k = 0; k < src->virtual_max && !v; k++) {
+        if (!src->vrx[k].active)
+            v = &src->vrx[k];
     }
+    pthread_mutex_unlock(&src->dev_mutex);
 
-#ifndef _WIN32
-    sigact.sa_handler = sighandler;
-    sigemptyset(&sigact.sa_mask);
-    sigact.sa_flags = 0;
-    sigign.sa_handler = SIG_IGN;
-    sigaction(SIGINT, &sigact, NULL);
-    sigaction(SIGTERM, &sigact, NULL);
-    sigaction(SIGQUIT, &sigact, NULL);
-    sigaction(SIGPIPE, &sigign, NULL);
-#else
-    SetConsoleCtrlHandler( (PHANDLER_ROUTINE) sighandler, TRUE );
+    if (!v) {
+        printf("[rx%d] all %d virtual receivers busy, client turned away\n", src->index, src->virtual_max);
+        closesocket(s);
+        return;
+    }
+
+    if (v->started) {
+        pthread_join(v->thread, &status);
+        v->started = 0;
+    }
+    v->s = s;
+    v->exit = 0;
+    v->changed = 0;
+    v->sent = 0;
+    v->offset = 0;
+    v->frequency = src->frequency;
+    v->samp_rate = src->samp_rate;
+    v->out = malloc(VRX_CHUNK_PAIRS * 2);
+    if (!v->out || ddc_init(&v->ddc, src->samp_rate, 0, 1, VRX_CHUNK_PAIRS) != 0 ||
+        shm_ring_open(&v->reader, src->wide.name) != 0) {
+        fprintf(stderr, "[rx%d v%d] failed to set up the virtual receiver\n", src->index, v->index);
+        ddc_free(&v->ddc);
+        free(v->out);
+        closesocket(s);
+        return;
+    }
+
+    /* from here on the capture writes the band to the ring */
+    pthread_mutex_lock(&src->dev_mutex);
+    v->active = 1;
+    src->attached++;
+    pthread_cond_signal(&src->dev_cond);
+    pthread_mutex_unlock(&src->dev_mutex);
+
+    pthread_create(&v->command_thread, NULL, vrx_command_worker, v);
+    pthread_create(&v->thread, NULL, vrx_worker, v);
+    v->started = 1;
+    printf("[rx%d v%d] client attached, %d of %d virtual receivers in use\n", src->index, v->index, src->attached,
+           src->virtual_max);
+}
+
+/* the shared ring and the slots of a -V source */
+static int vrx_open(struct rx_source *src)
+{
+    uint64_t size = (uint64_t)src->samp_rate * 2 * sizeof(short) * VRX_RING_SECONDS;
+    char name[64];
+    int k;
+
+    snprintf(name, sizeof(name), "play_tcp-%d-rx%d", (int)getpid(), src->index);
+    if (shm_ring_create(&src->wide, name, size > SHM_RING_DEFAULT_SIZE ? size : SHM_RING_DEFAULT_SIZE,
+                        src->samp_rate, SHM_FMT_CS16, src->frequency) != 0)
+        return -1;
+
+    src->vrx = calloc(src->virtual_max, sizeof(struct vrx));
+    for (k = 0; k < src->virtual_max; k++) {
+        src->vrx[k].src = src;
+        src->vrx[k].index = k;
+    }
+    printf("[rx%d] up to %d virtual receivers in the %u S/s band around %u Hz\n", src->index, src->virtual_max,
+           src->samp_rate, src->frequency);
+
+    return 0;
+}
+
+/* after the capture stopped: the senders see the ring closed */
+static void vrx_close(struct rx_source *src)
+{
+    void *status;
+    int k;
+
+    shm_ring_close(&src->wide);
+    for (k = 0; k < src->virtual_max; k++) {
+        if (src->vrx[k].started)
+            pthread_join(src->vrx[k].thread, &status);
+    }
+    free(src->vrx);
+}
 #endif
 
-    pthread_mutex_init(&exit_cond_lock, NULL);
-    pthread_mutex_init(&ll_mutex, NULL);
-    pthread_mutex_init(&exit_cond_lock, NULL);
-    pthread_cond_init(&cond, NULL);
-    pthread_cond_init(&exit_cond, NULL);
+/* accept loop of one source: one client at a time, as rtl_tcp, or several with -V */
+static void *source_server(void *arg)
+{
+    struct rx_source *src = arg;
+    struct sockaddr_in local, remote;
+    pthread_attr_t attr;
+    void *status;
+    struct timeval tv = {1,0};
+    struct linger ling = {1,0};
+    SOCKET listensocket;
+    socklen_t rlen;
+    fd_set readfds;
+    u_long blockmode = 1;
+    dongle_info_t dongle_info;
+    char name[16], label[64];
+    int r;
+
+    snprintf(name, sizeof(name), "play_tcp rx%d", src->index);
+
+    /* live TCP sources capture on their own thread, the others on this one */
+    if (src->udp_dest || src->device == SOURCE_FILE)
+        rt_apply_thread_at(RT_CAPTURE, src->index, name);
+
+#ifndef _WIN32
+    if (src->udp_dest) {
+        udp_server(src);
+        return NULL;
+    }
+#endif
 
     memset(&local,0,sizeof(local));
     local.sin_family = AF_INET;
-    local.sin_port = htons(port);
-    local.sin_addr.s_addr = inet_addr(addr);
+    local.sin_port = htons(src->port);
+    local.sin_addr.s_addr = inet_addr(src->addr);
 
     listensocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
     r = 1;
     setsockopt(listensocket, SOL_SOCKET, SO_REUSEADDR, (char *)&r, sizeof(int));
     setsockopt(listensocket, SOL_SOCKET, SO_LINGER, (char *)&ling, sizeof(ling));
-    bind(listensocket,(struct sockaddr *)&local,sizeof(local));
+    if (bind(listensocket,(struct sockaddr *)&local,sizeof(local)) != 0) {
+        fprintf(stderr, "[%s] failed to bind %s:%d\n", name, src->addr, src->port);
+        do_exit = 1;
+        return NULL;
+    }
 
 #ifdef _WIN32
     ioctlsocket(listensocket, FIONBIO, &blockmode);
@@ -672,13 +1495,24 @@ int main(int argc, char **argv)
     r = fcntl(listensocket, F_SETFL, r | O_NONBLOCK);
 #endif
 
+#ifndef _WIN32
+    if (src->virtual_max && vrx_open(src) != 0) {
+        do_exit = 1;
+        closesocket(listensocket);
+        return NULL;
+    }
+#endif
+
+    if (src->device != SOURCE_FILE)
+        pthread_create(&src->capture_thread, NULL, capture_worker, src);
+
     while(1) {
-        printf("listening...\n");
+        printf("[%s] listening...\n", name);
         printf("Use the device argument 'rtl_tcp=%s:%d' in OsmoSDR "
                        "(gr-osmosdr) source\n"
                        "to receive samples in GRC and control "
                        "rtl_tcp parameters (frequency, gain, ...).\n",
-               addr, port);
+               src->addr, src->port);
         listen(listensocket,1);
 
         while(1) {
@@ -691,14 +1525,22 @@ int main(int argc, char **argv)
                 goto out;
             } else if(r) {
                 rlen = sizeof(remote);
-                s = accept(listensocket,(struct sockaddr *)&remote, &rlen);
+                src->s = accept(listensocket,(struct sockaddr *)&remote, &rlen);
+                src->connect_ns = realtime_ns();
                 break;
             }
         }
 
-        setsockopt(s, SOL_SOCKET, SO_LINGER, (char *)&ling, sizeof(ling));
+        setsockopt(src->s, SOL_SOCKET, SO_LINGER, (char *)&ling, sizeof(ling));
+        r = src->profile->nodelay;
+        setsockopt(src->s, IPPROTO_TCP, TCP_NODELAY, (char *)&r, sizeof(r));
+        if (src->profile->sndbuf) {
+            r = src->profile->sndbuf;
+            setsockopt(src->s, SOL_SOCKET, SO_SNDBUF, (char *)&r, sizeof(r));
+        }
+        lathist_reset(&src->latency);
 
-        printf("client accepted!\n");
+        printf("[%s] client accepted!\n", name);
 
         memset(&dongle_info, 0, sizeof(dongle_info));
         memcpy(&dongle_info.magic, "RTL0", 4);
@@ -711,49 +1553,396 @@ int main(int argc, char **argv)
         if (r >= 0)
             dongle_info.tuner_gain_count = htonl(r);
 
-        r = send(s, (const char *)&dongle_info, sizeof(dongle_info), 0);
+        r = send(src->s, (const char *)&dongle_info, sizeof(dongle_info), 0);
         if (sizeof(dongle_info) != r)
             printf("failed to send dongle information\n");
 
+        src->cmd_freq_value = src->frequency;
+        src->framed = 0;
+
+#ifndef _WIN32
+        if (src->virtual_max) {
+            vrx_attach(src, src->s);
+            continue;
+        }
+        if (src->device == SOURCE_FILE) {
+            replay_session(src);
+            closesocket(src->s);
+            src->session_exit = 0;
+            continue;
+        }
+#endif
+
+        /* attach to the running capture, packets flow from the next one on */
+        pktq_clear(&src->queue);
+        src->warm_at_connect = src->sdrIsInitialized;
+        pthread_mutex_lock(&src->dev_mutex);
+        src->attached = 1;
+        pthread_cond_signal(&src->dev_cond);
+        pthread_mutex_unlock(&src->dev_mutex);
+
         pthread_attr_init(&attr);
         pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
-        r = pthread_create(&tcp_worker_thread, &attr, tcp_worker, NULL);
-        r = pthread_create(&command_thread, &attr, command_worker, NULL);
+        r = pthread_create(&src->tcp_worker_thread, &attr, tcp_worker, src);
+        r = pthread_create(&src->command_thread, &attr, command_worker, src);
         pthread_attr_destroy(&attr);
 
-       // r = rtlsdr_read_async(dev, rtlsdr_callback, NULL, buf_num, 0);
-        sdrplay_rx();
+        pthread_join(src->tcp_worker_thread, &status);
+        pthread_join(src->command_thread, &status);
+        src->attached = 0;
+
+        closesocket(src->s);
+
+        printf("[%s] all threads dead..\n", name);
+        snprintf(label, sizeof(label), "[%s] latency to socket (%s)", name, src->profile->name);
+        lathist_print(&src->latency, label, stdout);
+        printf("[%s] queue: %llu packets, %llu dropped (%llu kB), %llu decimated, peak %llu kB, "
+               "capture blocked %.1f ms, policy %s\n", name,
+               (unsigned long long)src->queue.stats.packets, (unsigned long long)src->queue.stats.dropped_packets,
+               (unsigned long long)src->queue.stats.dropped_bytes / 1024,
+               (unsigned long long)src->queue.stats.decimated_packets,
+               (unsigned long long)src->queue.stats.peak_bytes / 1024, src->queue.stats.blocked_ns / 1e6,
+               pktq_policy_name(src->queue.policy));
+        pktq_clear(&src->queue);
+
+        src->session_exit = 0;
+    }
 
-        pthread_join(tcp_worker_thread, &status);
-        pthread_join(command_thread, &status);
+    out:
+    closesocket(listensocket);
+    if (src->device != SOURCE_FILE)
+        pthread_join(src->capture_thread, &status);
+#ifndef _WIN32
+    if (src->virtual_max)
+        vrx_close(src);
+#endif
+    return NULL;
+}
 
-        closesocket(s);
+/* a new source, settings copied from the previous one, on the next port */
+static struct rx_source *add_source(void)
+{
+    struct rx_source *src = &sources[num_sources];
+
+    if (num_sources == MAX_SOURCES) {
+        fprintf(stderr, "Too many receivers (-d), at most %d\n", MAX_SOURCES);
+        exit(1);
+    }
+
+    if (num_sources > 0) {
+        *src = sources[num_sources - 1];
+        src->port++;
+    } else {
+        memset(src, 0, sizeof(*src));
+        src->device = 0;
+        src->addr = "127.0.0.1";
+        src->port = 1234;
+        src->frequency = 100000000;
+        src->gain = 30;
+        src->samp_rate = DEFAULT_SAMPLE_RATE;
+        src->sdr_bw = mir_sdr_BW_1_536;
+        src->queue_policy = PKTQ_DROP_OLDEST;
+        src->queue_ms = -1;
+        src->profile = &profiles[0];
+        src->mtu = DEFAULT_MTU;
+        src->replay_speed = 1.0;
+        iq_scaler_parse(&src->scaler, "peak");
+    }
+    src->index = num_sources++;
+
+    return src;
+}
+
+static int parse_device(struct rx_source *src, char *arg)
+{
+    if (strcmp(arg, "sim") == 0)
+        return SOURCE_SIM;
+
+    if (strncmp(arg, "file:", 5) == 0) {
+        src->replay_path = arg + 5;
+        return SOURCE_FILE;
+    }
+
+    if (atoi(arg) != 0) {
+        /* mir_sdr_Init always opens the first RSP, and the API drives one per process */
+        fprintf(stderr, "Only RSP 0 can be opened, run one play_tcp per further RSP.\n");
+        exit(1);
+    }
+
+    return 0;
+}
+
+
+int main(int argc, char **argv)
+{
+    int r, opt, i;
+    struct rx_source *src;
+
+    uint32_t buf_num = 0;
+    int dev_given = 0;
+    int hw_sources = 0;
+    int ppm_error = 0;
+    char *trace_spec = NULL;
+    void *status;
+
+#ifdef _WIN32
+    WSADATA wsd;
+	i = WSAStartup(MAKEWORD(2,2), &wsd);
+#else
+    struct sigaction sigact, sigign;
+#endif
+
+    src = add_source();
+
+    while ((opt = getopt(argc, argv, "a:p:f:g:s:b:n:d:P:r:l:u:m:R:D:O:Q:L:T:I:V:q:A:S:M:E:")) != -1) {
+        switch (opt) {
+            case 'd':
+                if (dev_given)
+                    src = add_source();
+                src->device = parse_device(src, optarg);
+                dev_given = 1;
+                break;
+            case 'r':
+                src->rspMode = atoi(optarg);
+                break;
+            case 'l':
+                src->rspLNA = atoi(optarg);
+                break;
+            case 'f':
+                src->frequency = (uint32_t)atofs(optarg);
+                break;
+            case 'g':
+                src->gain = (int)(atof(optarg) * 10); /* tenths of a dB *///FIXME
+                break;
+            case 's':
+                src->samp_rate = (uint32_t)atofs(optarg);//FIXME
+                break;
+            case 'a':
+                src->addr = optarg;
+                break;
+            case 'p':
+                src->port = atoi(optarg);
+                break;
+            case 'b':
+                buf_num = atoi(optarg);
+                break;
+            case 'n':
+                src->queue_bytes = (size_t)atoi(optarg) * RSP_PACKET_BYTES;
+                if (src->queue_bytes == 0) {
+                    fprintf(stderr, "Invalid number of queued packets (-n) !\n");
+                    usage();
+                }
+                break;
+            case 'O':
+                r = pktq_parse_policy(optarg);
+                if (r < 0) {
+                    fprintf(stderr, "Invalid slow client policy (-O) !\n");
+                    usage();
+                }
+                src->queue_policy = (enum pktq_policy)r;
+                break;
+            case 'Q':
+                src->queue_bytes = (size_t)atoi(optarg) * 1024;
+                if (src->queue_bytes == 0) {
+                    fprintf(stderr, "Invalid queue memory (-Q) !\n");
+                    usage();
+                }
+                break;
+            case 'I':
+                src->idle_timeout = atoi(optarg);
+                if (src->idle_timeout < 0) {
+                    fprintf(stderr, "Invalid idle timeout (-I) !\n");
+                    usage();
+                }
+                break;
+            case 'q':
+                if (iq_scaler_parse(&src->scaler, optarg) != 0) {
+                    fprintf(stderr, "Invalid adaptive scaling (-q) !\n");
+                    usage();
+                }
+                break;
+            case 'V':
+                src->virtual_max = atoi(optarg);
+                if (src->virtual_max < 0 || src->virtual_max > VRX_MAX_CLIENTS) {
+                    fprintf(stderr, "Invalid number of virtual receivers (-V) !\n");
+                    usage();
+                }
+                break;
+            case 'T':
+                src->profile = NULL;
+                for (i = 0; i < (int)(sizeof(profiles) / sizeof(profiles[0])); i++) {
+                    if (strcmp(optarg, profiles[i].name) == 0)
+                        src->profile = &profiles[i];
+                }
+                if (!src->profile) {
+                    fprintf(stderr, "Invalid streaming profile (-T) !\n");
+                    usage();
+                }
+                break;
+            case 'L':
+                if (atoi(optarg) < 0) {
+                    fprintf(stderr, "Invalid latency bound (-L) !\n");
+                    usage();
+                }
+                src->queue_ms = atoi(optarg);
+                break;
+            case 'P':
+                ppm_error = atoi(optarg);
+                break;
+            case 'u':
+                src->udp_dest = optarg;
+                break;
+            case 'm':
+                src->mtu = atoi(optarg);
+                if (src->mtu < UDP_IP_OVERHEAD + (int)sizeof(udp_header_t) + 2 || src->mtu > 65535) {
+                    fprintf(stderr, "Invalid MTU (-m) !\n");
+                    usage();
+                }
+                break;
+            case 'D':
+                src->pipe_spec = optarg;
+                break;
+            case 'R':
+                src->replay_speed = atof(optarg);
+                if (src->replay_speed < 0) {
+                    fprintf(stderr, "Invalid replay speed (-R) !\n");
+                    usage();
+                }
+                break;
+            case 'A':
+                if (rt_parse_cpus(optarg) != 0) {
+                    fprintf(stderr, "Invalid cpu list (-A) !\n");
+                    usage();
+                }
+                break;
+            case 'S':
+                if (rt_parse_sched(optarg) != 0) {
+                    fprintf(stderr, "Invalid scheduling policy / priority (-S) !\n");
+                    usage();
+                }
+                break;
+            case 'M':
+                if (rt_parse_memory(optarg) != 0) {
+                    fprintf(stderr, "Invalid memory mode (-M) !\n");
+                    usage();
+                }
+                break;
+            case 'E':
+                trace_spec = optarg;
+                break;
+            default:
+                usage();
+                break;
+        }
+    }
 
-        printf("all threads dead..\n");
-        curelem = ll_buffers;
-        ll_buffers = 0;
+    if (argc < optind)
+        usage();
 
-        while(curelem != 0) {
-            prev = curelem;
-            curelem = curelem->next;
-            free(prev->data);
-            free(prev);
+    for (i = 0; i < num_sources; i++) {
+        src = &sources[i];
+        if (src->device >= 0)
+            hw_sources++;
+        if (src->pipe_spec) {
+            /* clients are told the tuned rate, so no decimation here */
+            if (pipeline_parse(&src->pipe, src->pipe_spec, src->samp_rate, 8) != 0)
+                usage();
+            pipeline_free(&src->pipe);
+            if (src->pipe.decimation != 1) {
+                fprintf(stderr, "play_tcp keeps the sample rate the clients asked for, no decim in -D.\n");
+                exit(1);
+            }
+            if (src->device == SOURCE_FILE)
+                fprintf(stderr, "[rx%d] recordings are sent as recorded, -D ignored.\n", i);
         }
+        if (src->virtual_max) {
+#ifdef _WIN32
+            fprintf(stderr, "Virtual receivers (-V) are not supported on Windows.\n");
+            exit(1);
+#endif
+            if (src->device == SOURCE_FILE || src->udp_dest || src->pipe_spec) {
+                fprintf(stderr, "[rx%d] virtual receivers (-V) need a live TCP receiver without -D.\n", i);
+                exit(1);
+            }
+        }
+        if (src->device != SOURCE_FILE)
+            continue;
+#ifndef _WIN32
+        if (src->udp_dest) {
+            fprintf(stderr, "Recordings (-d file:) are replayed to TCP clients only, not with -u.\n");
+            exit(1);
+        }
+        if (file_source_open(&src->replay, src->replay_path, src->replay_speed, src->samp_rate,
+                             src->frequency) != 0)
+            exit(1);
+        src->samp_rate = src->replay.samp_rate;
+        printf("[rx%d] replaying %s at %u S/s, %s%s\n", i, src->replay_path, src->samp_rate,
+               src->replay.indexed ? "time indexed, " : "", src->replay_speed > 0 ? "paced" : "unpaced");
+#else
+        fprintf(stderr, "Replaying recordings (-d file:) is not supported on Windows.\n");
+        exit(1);
+#endif
+    }
 
-        do_exit = 0;
+    if (hw_sources > 1) {
+        fprintf(stderr, "The mir_sdr API drives one RSP per process, use 'sim' or one play_tcp per RSP.\n");
+        exit(1);
     }
 
+    rt_lock_memory();
 
+    if (trace_spec && trace_open(trace_spec) != 0) {
+        fprintf(stderr, "Invalid trace file (-E) !\n");
+        exit(1);
+    }
 
-    out:
-    mir_sdr_Uninit();
-    closesocket(listensocket);
-    closesocket(s);
+#ifndef _WIN32
+    sigact.sa_handler = sighandler;
+    sigemptyset(&sigact.sa_mask);
+    sigact.sa_flags = 0;
+    sigign.sa_handler = SIG_IGN;
+    sigaction(SIGINT, &sigact, NULL);
+    sigaction(SIGTERM, &sigact, NULL);
+    sigaction(SIGQUIT, &sigact, NULL);
+    sigaction(SIGPIPE, &sigign, NULL);
+#else
+    SetConsoleCtrlHandler( (PHANDLER_ROUTINE) sighandler, TRUE );
+#endif
+
+    for (i = 0; i < num_sources; i++) {
+        src = &sources[i];
+        if (src->queue_bytes == 0)
+            src->queue_bytes = src->profile->queue_kb * 1024;
+        if (src->queue_ms < 0)
+            src->queue_ms = src->profile->queue_ms;
+        pktq_init(&src->queue, src->queue_policy, src->queue_bytes, (unsigned int)src->queue_ms);
+        pthread_mutex_init(&src->dev_mutex, NULL);
+        pthread_cond_init(&src->dev_cond, NULL);
+        r = pthread_create(&src->server_thread, NULL, source_server, src);
+        if (r != 0) {
+            fprintf(stderr, "Failed to start receiver %d\n", i);
+            do_exit = 1;
+            num_sources = i;
+            break;
+        }
+    }
+
+    for (i = 0; i < num_sources; i++) {
+        pthread_join(sources[i].server_thread, &status);
+    }
+
+#ifndef _WIN32
+    for (i = 0; i < num_sources; i++) {
+        if (sources[i].device == SOURCE_FILE)
+            file_source_close(&sources[i].replay);
+    }
+#endif
+    trace_close();
 #ifdef _WIN32
     WSACleanup();
 #endif
     printf("bye!\n");
-    return r >= 0 ? r : -r;
+    return 0;
 }
 
 
@@ -0,0 +1,273 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  play_tcpbench, reference consumer of a play_tcp receiver built on the
+ *  client library (tcpclient.h). Receives, converts to CF32 and reports
+ *  once a second and at the end: the achieved rate, what the server
+ *  dropped, gaps in the sample numbers of the frames and waits for data
+ *  longer than -g. -w writes the CF32 stream out, for use as a client.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "iqdsp.h"
+#include "rtltcp.h"
+#include "tcpclient.h"
+
+#define CF32_PAIRS      65536
+
+static volatile int do_exit = 0;
+
+void usage(void) {
+    fprintf(stderr,
+            "play_tcpbench, receives from play_tcp and reports rate, drops and gaps\n\n"
+                    "Usage:\t[-a server address (default: 127.0.0.1)]\n"
+                    "\t[-p port (default: 1234)]\n"
+                    "\t[-t seconds to run (default: 10, 0: until interrupted)]\n"
+                    "\t[-F framing: 0 raw rtl_tcp, 1 frames, 2 frames with adaptive scaling (default: 1)]\n"
+                    "\t[-f frequency to tune to [Hz]]\n"
+                    "\t[-r ring size in MB (default: 8)]\n"
+                    "\t[-l kB to wait for per read (default: 64, 0: any)]\n"
+                    "\t[-g report waits for data longer than that many ms (default: 100)]\n"
+                    "\t[-n only consume, no CF32 conversion]\n"
+                    "\t[-w file to write the CF32 samples to ('-' for stdout)]\n\n");
+    exit(1);
+}
+
+static void sighandler(int signum) {
+    (void) signum;
+    do_exit = 1;
+}
+
+double atofs(char *s)
+/* standard suffixes */
+{
+    char last;
+    int len;
+    double suff = 1.0;
+    len = strlen(s);
+    last = s[len - 1];
+    s[len - 1] = '\0';
+    switch (last) {
+        case 'g':
+        case 'G':
+            suff *= 1e3;
+        case 'm':
+        case 'M':
+            suff *= 1e3;
+        case 'k':
+        case 'K':
+            suff *= 1e3;
+            suff *= atof(s);
+            s[len - 1] = last;
+            return suff;
+    }
+    s[len - 1] = last;
+    return atof(s);
+}
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double cpu_seconds(void) {
+    struct rusage ru;
+
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+int main(int argc, char **argv) {
+    const char *addr = "127.0.0.1", *outname = NULL;
+    int port = 1234, seconds = 10, framing = 1, read_kb = 64, convert = 1, opt;
+    uint32_t frequency = 0;
+    double ring_mb = 8, wait_limit_ms = 100;
+    struct tcp_client c;
+    struct tcp_client_span span;
+    struct tcp_client_stats last;
+    const uint8_t *data;
+    float *cf32 = NULL;
+    FILE *out = NULL;
+    double start, t, last_data, last_report, wait, longest = 0, convert_s = 0, cpu0;
+    uint64_t first_sample = 0, end_sample = 0, long_waits = 0;
+    int have_first = 0, closed = 0;
+    long n;
+
+    while ((opt = getopt(argc, argv, "a:p:t:F:f:r:l:g:nw:")) != -1) {
+        switch (opt) {
+            case 'a':
+                addr = optarg;
+                break;
+            case 'p':
+                port = atoi(optarg);
+                break;
+            case 't':
+                seconds = atoi(optarg);
+                break;
+            case 'F':
+                framing = atoi(optarg);
+                break;
+            case 'f':
+                frequency = (uint32_t) atofs(optarg);
+                break;
+            case 'r':
+                ring_mb = atof(optarg);
+                break;
+            case 'l':
+                read_kb = atoi(optarg);
+                break;
+            case 'g':
+                wait_limit_ms = atof(optarg);
+                break;
+            case 'n':
+                convert = 0;
+                break;
+            case 'w':
+                outname = optarg;
+                break;
+            default:
+                usage();
+                break;
+        }
+    }
+
+    if (framing < 0 || framing > 2) {
+        fprintf(stderr, "Invalid framing (-F) !\n");
+        usage();
+    }
+    if (ring_mb <= 0 || read_kb < 0 || seconds < 0 || wait_limit_ms <= 0) {
+        fprintf(stderr, "Invalid ring size, read size, duration or wait limit (-r, -l, -t, -g) !\n");
+        usage();
+    }
+    if (outname && !convert) {
+        fprintf(stderr, "Writing CF32 needs the conversion (-w, -n) !\n");
+        usage();
+    }
+
+    if (outname) {
+        out = strcmp(outname, "-") == 0 ? stdout : fopen(outname, "wb");
+        if (!out) {
+            fprintf(stderr, "Failed to open %s\n", outname);
+            exit(1);
+        }
+    }
+    if (convert)
+        cf32 = malloc(2 * CF32_PAIRS * sizeof(float));
+
+    if (tcp_client_connect(&c, addr, port, (uint64_t) (ring_mb * 1024 * 1024), read_kb * 1024) != 0) {
+        fprintf(stderr, "No play_tcp at %s:%d\n", addr, port);
+        exit(1);
+    }
+    fprintf(stderr, "Connected to %s:%d, tuner type %u, %u gains\n", addr, port, c.tuner_type, c.tuner_gain_count);
+    if ((frequency && tcp_client_command(&c, CMD_SET_FREQ, frequency) != 0) ||
+        (framing && tcp_client_set_framing(&c, framing) != 0)) {
+        fprintf(stderr, "Failed to send the commands\n");
+        exit(1);
+    }
+
+    signal(SIGINT, sighandler);
+    signal(SIGTERM, sighandler);
+    signal(SIGPIPE, SIG_IGN);
+
+    memset(&last, 0, sizeof(last));
+    cpu0 = cpu_seconds();
+    start = last_data = last_report = now();
+
+    while (!do_exit && (seconds == 0 || now() - start < seconds)) {
+        n = tcp_client_read(&c, &data, &span, 200);
+        if (n > 0) {
+            n /= 2;
+            if (convert) {
+                double t0 = now();
+
+                if (n > CF32_PAIRS)
+                    n = CF32_PAIRS;
+                iq_cs8_to_cf32(data, (int) n, span.gain_bits, cf32);
+                convert_s += now() - t0;
+                if (out && fwrite(cf32, 2 * sizeof(float), (size_t) n, out) != (size_t) n) {
+                    fprintf(stderr, "Short write, exiting!\n");
+                    break;
+                }
+            }
+            tcp_client_consume(&c, 2 * (size_t) n);
+        }
+        if (n < 0) {
+            closed = 1;
+            break;
+        }
+
+        t = now();
+        if (n > 0) {
+            wait = t - last_data;
+            if (wait * 1000 > wait_limit_ms)
+                long_waits++;
+            if (wait > longest)
+                longest = wait;
+            last_data = t;
+            if (!have_first) {
+                first_sample = span.sample;
+                have_first = 1;
+            }
+            end_sample = span.sample + (uint64_t) n * span.decimation;
+        }
+
+        if (t - last_report >= 1.0) {
+            fprintf(stderr, "%.2f MB/s, %.3f M pairs/s, %llu frames, %llu dropped, %llu gaps (%llu lost)\n",
+                    (c.stats.bytes - last.bytes) / 1e6 / (t - last_report),
+                    (c.stats.pairs - last.pairs) / 1e6 / (t - last_report),
+                    (unsigned long long) (c.stats.frames - last.frames),
+                    (unsigned long long) (c.stats.dropped - last.dropped),
+                    (unsigned long long) (c.stats.gaps - last.gaps), (unsigned long long) (c.stats.lost - last.lost));
+            last = c.stats;
+            last_report = t;
+        }
+    }
+
+    t = now() - start;
+    if (closed)
+        fprintf(stderr, "Connection closed by the server\n");
+    fprintf(stderr, "%.1f MB in %.1f s: %.2f MB/s, %.3f M pairs/s", c.stats.bytes / 1e6, t, c.stats.bytes / 1e6 / t,
+            c.stats.pairs / 1e6 / t);
+    if (c.stats.frames)
+        fprintf(stderr, ", the frames cover %.3f M samples/s at the server", (end_sample - first_sample) / 1e6 / t);
+    fprintf(stderr, "\n%llu reads of %.1f kB on average, cpu %.1f%%", (unsigned long long) c.stats.reads,
+            c.stats.reads ? c.stats.bytes / 1024.0 / c.stats.reads : 0.0, 100.0 * (cpu_seconds() - cpu0) / t);
+    if (convert && c.stats.pairs)
+        fprintf(stderr, ", CF32 conversion %.2f ns/pair", convert_s * 1e9 / c.stats.pairs);
+    fprintf(stderr, "\n%llu frames, %llu pairs dropped by the server, %llu gaps with %llu samples lost in the receiver, "
+                    "%llu bytes skipped\n", (unsigned long long) c.stats.frames, (unsigned long long) c.stats.dropped,
+            (unsigned long long) c.stats.gaps, (unsigned long long) c.stats.lost,
+            (unsigned long long) c.stats.skipped);
+    fprintf(stderr, "%llu waits for data over %.0f ms, longest %.1f ms\n", (unsigned long long) long_waits,
+            wait_limit_ms, longest * 1000);
+
+    tcp_client_close(&c);
+    if (out && out != stdout)
+        fclose(out);
+    free(cf32);
+    return 0;
+}
@@ -0,0 +1,137 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  play_unz, decompresses recordings made with 'play_sdr -z'. With -s/-n only
+ *  the blocks holding the requested range are read, using the block index.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FILE_OFFSET_BITS
+#define _FILE_OFFSET_BITS 64
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "iqz.h"
+
+void usage(void) {
+    fprintf(stderr,
+            "play_unz, decompresses play_sdr -z recordings\n\n"
+                    "Usage:\t[-s first I/Q sample to extract (default: 0)]\n"
+                    "\t[-n number of I/Q samples to extract (default: all)]\n"
+                    "\t[-i print recording and index information only]\n"
+                    "\tinput.iqz [output_filename (default: '-' dumps samples to stdout)]\n\n");
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    struct iqz_reader rd;
+    FILE *in, *out;
+    uint8_t *buf;
+    uint64_t first = 0, count = 0, blk, pos, end;
+    uint64_t skip, take;
+    long pairs;
+    int opt;
+    int info = 0;
+
+    while ((opt = getopt(argc, argv, "s:n:i")) != -1) {
+        switch (opt) {
+            case 's':
+                first = strtoull(optarg, NULL, 10);
+                break;
+            case 'n':
+                count = strtoull(optarg, NULL, 10);
+                break;
+            case 'i':
+                info = 1;
+                break;
+            default:
+                usage();
+                break;
+        }
+    }
+
+    if (argc <= optind)
+        usage();
+
+    in = fopen(argv[optind], "rb");
+    if (!in) {
+        fprintf(stderr, "Failed to open %s\n", argv[optind]);
+        exit(1);
+    }
+    if (iqz_reader_open(&rd, in) != 0)
+        exit(1);
+
+    if (info) {
+        fseeko(in, 0, SEEK_END);
+        fprintf(stderr, "%d bit, %u S/s, %u Hz, %llu I/Q samples (%.1f s) in %llu blocks%s\n", rd.bits,
+                rd.samp_rate, rd.frequency, (unsigned long long) rd.samples,
+                rd.samp_rate ? (double) rd.samples / rd.samp_rate : 0.0, (unsigned long long) rd.nindex,
+                rd.indexed ? "" : " (no index, rebuilt by scanning)");
+        fprintf(stderr, "compressed to %.1f%% of %llu bytes\n",
+                rd.samples ? 100.0 * ftello(in) / (rd.samples * rd.pair_bytes) : 0.0,
+                (unsigned long long) (rd.samples * rd.pair_bytes));
+        iqz_reader_close(&rd);
+        fclose(in);
+        return 0;
+    }
+
+    if (argc <= optind + 1 || strcmp(argv[optind + 1], "-") == 0) {
+        out = stdout;
+    } else {
+        out = fopen(argv[optind + 1], "wb");
+        if (!out) {
+            fprintf(stderr, "Failed to open %s\n", argv[optind + 1]);
+            exit(1);
+        }
+    }
+
+    end = rd.samples;
+    if (count > 0 && first + count < end)
+        end = first + count;
+
+    buf = malloc(rd.block_samples * rd.pair_bytes);
+    pos = first;
+    for (blk = iqz_find_block(&rd, first); pos < end && blk < rd.nindex; blk++) {
+        pairs = iqz_read_block(&rd, blk, buf);
+        if (pairs < 0) {
+            fprintf(stderr, "Corrupt block %llu, stopping.\n", (unsigned long long) blk);
+            break;
+        }
+        skip = pos - rd.index[blk].sample;
+        if (skip >= (uint64_t) pairs)
+            continue;
+        take = pairs - skip;
+        if (take > end - pos)
+            take = end - pos;
+        if (fwrite(buf + skip * rd.pair_bytes, rd.pair_bytes, take, out) != take) {
+            fprintf(stderr, "Short write, samples lost, exiting!\n");
+            break;
+        }
+        pos += take;
+    }
+
+    if (out != stdout)
+        fclose(out);
+    free(buf);
+    iqz_reader_close(&rd);
+    fclose(in);
+
+    return pos == end ? 0 : 1;
+}
@@ -0,0 +1,207 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pyramid.h"
+
+/* |X|^2 of a full scale complex tone through the Hann window */
+#define FFT_FULL_SCALE  (32768.0 * PYRAMID_FFT_SIZE * 0.5)
+
+int pyramid_open(struct pyramid *p, const char *basename, int bits, uint32_t samp_rate,
+                 int samples_per_packet, double row_seconds) {
+    char *name = malloc(strlen(basename) + 8);
+    int i, factor = 1;
+
+    memset(p, 0, sizeof(*p));
+    p->bits = bits;
+    p->samples_per_packet = samples_per_packet;
+
+    p->in_i = malloc(samples_per_packet * sizeof(float));
+    p->in_q = malloc(samples_per_packet * sizeof(float));
+    p->conv = malloc(2 * (samples_per_packet + 1) * sizeof(short));
+    if (!name || !p->in_i || !p->in_q || !p->conv)
+        goto fail;
+
+    for (i = 0; i < PYRAMID_LEVELS; i++) {
+        struct pyramid_level *l = &p->level[i];
+
+        factor *= PYRAMID_FACTOR;
+        sprintf(name, "%s.d%d", basename, factor);
+        l->file = fopen(name, "wb");
+        if (!l->file) {
+            fprintf(stderr, "Failed to open %s\n", name);
+            goto fail;
+        }
+        l->out_i = malloc((samples_per_packet / PYRAMID_FACTOR + 1) * sizeof(float));
+        l->out_q = malloc((samples_per_packet / PYRAMID_FACTOR + 1) * sizeof(float));
+        if (!l->out_i || !l->out_q || iq_decimator_init(&l->dec, PYRAMID_FACTOR, PYRAMID_TAPS_PER_FACTOR) != 0)
+            goto fail;
+    }
+
+    sprintf(name, "%s.pgm", basename);
+    p->pgm = fopen(name, "wb");
+    if (!p->pgm) {
+        fprintf(stderr, "Failed to open %s\n", name);
+        goto fail;
+    }
+    /* the height is patched in on close */
+    fprintf(p->pgm, "P5\n%d ", PYRAMID_FFT_SIZE);
+    p->pgm_height_pos = ftell(p->pgm);
+    fprintf(p->pgm, "%10u\n255\n", 0);
+
+    p->packets_per_row = (uint64_t) (row_seconds * samp_rate / samples_per_packet);
+    if (p->packets_per_row < 1)
+        p->packets_per_row = 1;
+    p->fft_stride = p->packets_per_row / PYRAMID_FFTS_PER_ROW;
+    if (p->fft_stride < 1)
+        p->fft_stride = 1;
+
+    for (i = 0; i < PYRAMID_FFT_SIZE; i++)
+        p->window[i] = (float) (0.5 - 0.5 * cos(2 * M_PI * i / PYRAMID_FFT_SIZE));
+
+    free(name);
+    return 0;
+
+    fail:
+    free(name);
+    pyramid_close(p, 0);
+    return -1;
+}
+
+static short clamp16(float v) {
+    if (v > 32767.0f)
+        return 32767;
+    if (v < -32768.0f)
+        return -32768;
+    return (short) lrintf(v);
+}
+
+/* same conversion as the recording itself */
+static int write_level(struct pyramid *p, struct pyramid_level *l, int n) {
+    uint8_t *b8 = p->conv;
+    short *b16 = p->conv;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        if (p->bits == 8) {
+            b8[2 * i] = (unsigned char) (clamp16(l->out_i[i]) >> 8);
+            b8[2 * i + 1] = (unsigned char) (clamp16(l->out_q[i]) >> 8);
+        } else {
+            b16[2 * i] = clamp16(l->out_i[i]);
+            b16[2 * i + 1] = clamp16(l->out_q[i]);
+        }
+    }
+    l->samples += n;
+
+    return fwrite(p->conv, p->bits == 8 ? 2 : 4, n, l->file) == (size_t) n ? 0 : -1;
+}
+
+static void spectrum(struct pyramid *p, const short *ibuf, const short *qbuf) {
+    int i, half = PYRAMID_FFT_SIZE / 2;
+
+    for (i = 0; i < PYRAMID_FFT_SIZE; i++) {
+        p->fft_re[i] = ibuf[i] * p->window[i];
+        p->fft_im[i] = qbuf[i] * p->window[i];
+    }
+    iq_fft(p->fft_re, p->fft_im, PYRAMID_FFT_SIZE);
+
+    /* negative frequencies on the left */
+    for (i = 0; i < PYRAMID_FFT_SIZE; i++) {
+        int bin = (i + half) % PYRAMID_FFT_SIZE;
+        p->power[i] += (double) p->fft_re[bin] * p->fft_re[bin] + (double) p->fft_im[bin] * p->fft_im[bin];
+    }
+    p->ffts++;
+}
+
+static int write_row(struct pyramid *p) {
+    uint8_t row[PYRAMID_FFT_SIZE];
+    double db;
+    int i;
+
+    for (i = 0; i < PYRAMID_FFT_SIZE; i++) {
+        db = iq_power_to_dbfs(p->power[i] / p->ffts / (FFT_FULL_SCALE * FFT_FULL_SCALE));
+        db = (db - PYRAMID_DB_FLOOR) * 255.0 / -PYRAMID_DB_FLOOR;
+        row[i] = (uint8_t) (db < 0 ? 0 : db > 255 ? 255 : db);
+        p->power[i] = 0;
+    }
+    p->ffts = 0;
+    p->rows++;
+
+    return fwrite(row, 1, sizeof(row), p->pgm) == sizeof(row) ? 0 : -1;
+}
+
+int pyramid_feed(struct pyramid *p, const short *ibuf, const short *qbuf) {
+    const float *src_i = p->in_i, *src_q = p->in_q;
+    int i, n = p->samples_per_packet;
+
+    for (i = 0; i < n; i++) {
+        p->in_i[i] = ibuf[i];
+        p->in_q[i] = qbuf[i];
+    }
+
+    /* each level decimates the output of the previous one */
+    for (i = 0; i < PYRAMID_LEVELS; i++) {
+        struct pyramid_level *l = &p->level[i];
+
+        n = iq_decimate(&l->dec, src_i, src_q, n, l->out_i, l->out_q);
+        if (n > 0 && write_level(p, l, n) != 0)
+            return -1;
+        src_i = l->out_i;
+        src_q = l->out_q;
+    }
+
+    if (p->samples_per_packet >= PYRAMID_FFT_SIZE && p->packet % p->fft_stride == 0)
+        spectrum(p, ibuf, qbuf);
+    if (++p->packet % p->packets_per_row == 0 && p->ffts > 0)
+        return write_row(p);
+
+    return 0;
+}
+
+void pyramid_close(struct pyramid *p, int verbose) {
+    int i;
+
+    for (i = 0; i < PYRAMID_LEVELS; i++) {
+        struct pyramid_level *l = &p->level[i];
+
+        if (l->file)
+            fclose(l->file);
+        if (verbose == 1)
+            fprintf(stderr, "[DEBUG] pyramid level /%d: %llu samples\n", (int) pow(PYRAMID_FACTOR, i + 1),
+                    (unsigned long long) l->samples);
+        iq_decimator_free(&l->dec);
+        free(l->out_i);
+        free(l->out_q);
+    }
+
+    if (p->pgm) {
+        fseek(p->pgm, p->pgm_height_pos, SEEK_SET);
+        fprintf(p->pgm, "%10u", p->rows);
+        fclose(p->pgm);
+        if (verbose == 1)
+            fprintf(stderr, "[DEBUG] overview waterfall: %u rows\n", p->rows);
+    }
+
+    free(p->in_i);
+    free(p->in_q);
+    free(p->conv);
+    memset(p, 0, sizeof(*p));
+}
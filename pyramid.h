@@ -0,0 +1,81 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  pyramid: zoomed out companions of a recording, written during capture.
+ *
+ *  One cascade of /8 decimators produces <file>.d8, <file>.d64 and
+ *  <file>.d512 (same sample format as the recording, centred on the same
+ *  frequency, at 1/8, 1/64 and 1/512 of the sample rate). Next to them
+ *  <file>.pgm is an overview waterfall of the full band: one row of
+ *  PYRAMID_FFT_SIZE bins per row interval, averaged over up to
+ *  PYRAMID_FFTS_PER_ROW windowed FFTs, -120..0 dBFS mapped to 0..255.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PYRAMID_H
+#define PYRAMID_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "iqdsp.h"
+
+#define PYRAMID_LEVELS          3
+#define PYRAMID_FACTOR          8
+#define PYRAMID_TAPS_PER_FACTOR 6
+#define PYRAMID_FFT_SIZE        256
+#define PYRAMID_FFTS_PER_ROW    64
+#define PYRAMID_DB_FLOOR        -120.0
+
+struct pyramid_level {
+    struct iq_decimator dec;
+    FILE *file;
+    float *out_i;
+    float *out_q;
+    uint64_t samples;
+};
+
+struct pyramid {
+    int bits;
+    int samples_per_packet;
+    struct pyramid_level level[PYRAMID_LEVELS];
+    float *in_i;
+    float *in_q;
+    void *conv;                 /* converted output of one level */
+
+    FILE *pgm;
+    long pgm_height_pos;
+    uint64_t packets_per_row;
+    uint64_t fft_stride;        /* in packets */
+    uint64_t packet;
+    float window[PYRAMID_FFT_SIZE];
+    float fft_re[PYRAMID_FFT_SIZE];
+    float fft_im[PYRAMID_FFT_SIZE];
+    double power[PYRAMID_FFT_SIZE];
+    int ffts;
+    unsigned int rows;
+};
+
+/* bits: sample format of the companions, as the recording. Returns 0 on success. */
+int pyramid_open(struct pyramid *p, const char *basename, int bits, uint32_t samp_rate,
+                 int samples_per_packet, double row_seconds);
+
+/* one packet as returned by mir_sdr_ReadPacket (swapped already if I/Q are flipped) */
+int pyramid_feed(struct pyramid *p, const short *ibuf, const short *qbuf);
+
+void pyramid_close(struct pyramid *p, int verbose);
+
+#endif
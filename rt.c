@@ -0,0 +1,229 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "rt.h"
+
+#define RT_HUGE_PAGE_SIZE   (2 * 1024 * 1024)
+
+struct rt_config rt_cfg = {{-1, -1, -1}, SCHED_OTHER, 0, RT_MEM_DEFAULT};
+
+static const char *role_names[RT_ROLES] = {"capture", "sender", "writer"};
+
+int rt_parse_cpus(const char *arg) {
+    int role = 0;
+    char *end;
+
+    while (*arg && role < RT_ROLES) {
+        long cpu = strtol(arg, &end, 10);
+        if (end == arg || cpu < -1 || cpu >= CPU_SETSIZE)
+            return -1;
+        rt_cfg.cpu[role++] = (int) cpu;
+        arg = (*end == ',') ? end + 1 : end;
+    }
+
+    return *arg ? -1 : 0;
+}
+
+int rt_parse_sched(const char *arg) {
+    const char *sep = strchr(arg, ':');
+    size_t len = sep ? (size_t) (sep - arg) : strlen(arg);
+
+    if (len == 4 && strncmp(arg, "fifo", len) == 0) {
+        rt_cfg.policy = SCHED_FIFO;
+    } else if (len == 2 && strncmp(arg, "rr", len) == 0) {
+        rt_cfg.policy = SCHED_RR;
+    } else if (len == 5 && strncmp(arg, "other", len) == 0) {
+        rt_cfg.policy = SCHED_OTHER;
+        rt_cfg.priority = 0;
+        return 0;
+    } else {
+        return -1;
+    }
+
+    rt_cfg.priority = sep ? atoi(sep + 1) : 50;
+    if (rt_cfg.priority < sched_get_priority_min(rt_cfg.policy) ||
+        rt_cfg.priority > sched_get_priority_max(rt_cfg.policy))
+        return -1;
+
+    return 0;
+}
+
+int rt_parse_memory(const char *arg) {
+    rt_cfg.memory = atoi(arg);
+
+    return (rt_cfg.memory < RT_MEM_DEFAULT || rt_cfg.memory > RT_MEM_HUGE) ? -1 : 0;
+}
+
+static const char *policy_name(int policy) {
+    switch (policy) {
+        case SCHED_FIFO:
+            return "SCHED_FIFO";
+        case SCHED_RR:
+            return "SCHED_RR";
+    }
+    return "SCHED_OTHER";
+}
+
+/* cpu of a role for the given instance, -1 when not pinned */
+static int rt_cpu(enum rt_role role, int instance) {
+    int i, pinned = 0;
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (rt_cfg.cpu[role] < 0)
+        return -1;
+
+    for (i = 0; i < RT_ROLES; i++) {
+        if (rt_cfg.cpu[i] >= 0)
+            pinned++;
+    }
+
+    return (int) ((rt_cfg.cpu[role] + (long) instance * pinned) % (ncpu > 0 ? ncpu : 1));
+}
+
+void rt_apply_thread(enum rt_role role, const char *name) {
+    rt_apply_thread_at(role, 0, name);
+}
+
+void rt_apply_thread_at(enum rt_role role, int instance, const char *name) {
+    pthread_t self = pthread_self();
+    struct sched_param param;
+    cpu_set_t set;
+    int policy, r;
+    int cpu = rt_cpu(role, instance);
+    int capture_cpu = rt_cpu(RT_CAPTURE, instance);
+
+#ifdef __linux__
+    pthread_setname_np(self, name);
+#endif
+
+    if (cpu >= 0) {
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        r = pthread_setaffinity_np(self, sizeof(set), &set);
+        if (r != 0)
+            fprintf(stderr, "[RT] %s: pinning to cpu %d failed: %s\n", name, cpu, strerror(r));
+    } else if (role != RT_CAPTURE && capture_cpu >= 0) {
+        /* threads inherit the mask of their creator, keep them off the capture cpu */
+        long i, ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        CPU_ZERO(&set);
+        for (i = 0; i < ncpu && i < CPU_SETSIZE; i++) {
+            if (i != capture_cpu)
+                CPU_SET(i, &set);
+        }
+        if (CPU_COUNT(&set) > 0)
+            pthread_setaffinity_np(self, sizeof(set), &set);
+    }
+
+    /* same for the scheduling class, only the capture thread runs real-time */
+    memset(&param, 0, sizeof(param));
+    if (role == RT_CAPTURE && rt_cfg.policy != SCHED_OTHER) {
+        param.sched_priority = rt_cfg.priority;
+        r = pthread_setschedparam(self, rt_cfg.policy, &param);
+        if (r != 0)
+            fprintf(stderr, "[RT] %s: %s priority %d refused: %s\n", name, policy_name(rt_cfg.policy),
+                    rt_cfg.priority, strerror(r));
+    } else if (role != RT_CAPTURE) {
+        pthread_setschedparam(self, SCHED_OTHER, &param);
+    }
+
+    /* report what the kernel actually gave us */
+    pthread_getschedparam(self, &policy, &param);
+    if (cpu >= 0 && pthread_getaffinity_np(self, sizeof(set), &set) == 0 && CPU_COUNT(&set) == 1) {
+        fprintf(stderr, "[RT] %s (%s thread): cpu %d, %s priority %d\n", name, role_names[role],
+                cpu, policy_name(policy), param.sched_priority);
+    } else {
+        fprintf(stderr, "[RT] %s (%s thread): not pinned, %s priority %d\n", name, role_names[role],
+                policy_name(policy), param.sched_priority);
+    }
+}
+
+void rt_lock_memory(void) {
+    if (rt_cfg.memory == RT_MEM_DEFAULT)
+        return;
+
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        fprintf(stderr, "[RT] mlockall failed: %s, memory stays pageable\n", strerror(errno));
+        return;
+    }
+
+    fprintf(stderr, "[RT] memory locked (mlockall)%s\n",
+            rt_cfg.memory == RT_MEM_HUGE ? ", huge pages for large buffers" : "");
+}
+
+/* huge page backed buffers are rounded up to whole huge pages */
+static size_t rt_length(size_t size) {
+    if (rt_cfg.memory == RT_MEM_HUGE && size >= RT_HUGE_PAGE_SIZE)
+        return (size + RT_HUGE_PAGE_SIZE - 1) & ~((size_t) RT_HUGE_PAGE_SIZE - 1);
+
+    return size;
+}
+
+void *rt_alloc(size_t size) {
+    size_t len = rt_length(size);
+    void *ptr = MAP_FAILED;
+
+    if (rt_cfg.memory == RT_MEM_DEFAULT)
+        return malloc(size);
+
+#ifdef MAP_HUGETLB
+    if (rt_cfg.memory == RT_MEM_HUGE && size >= RT_HUGE_PAGE_SIZE) {
+        ptr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (ptr == MAP_FAILED)
+            fprintf(stderr, "[RT] no hugetlbfs pages for %zu bytes, using transparent huge pages\n", size);
+    }
+#endif
+
+    if (ptr == MAP_FAILED) {
+        ptr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED)
+            return NULL;
+#ifdef MADV_HUGEPAGE
+        if (rt_cfg.memory == RT_MEM_HUGE && size >= RT_HUGE_PAGE_SIZE)
+            madvise(ptr, len, MADV_HUGEPAGE);
+#endif
+    }
+
+    /* prefault, no page faults later in the capture loop */
+    memset(ptr, 0, len);
+    mlock(ptr, len);
+
+    return ptr;
+}
+
+void rt_free(void *ptr, size_t size) {
+    if (!ptr)
+        return;
+
+    if (rt_cfg.memory == RT_MEM_DEFAULT)
+        free(ptr);
+    else
+        munmap(ptr, rt_length(size));
+}
@@ -0,0 +1,80 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  rt: CPU pinning, real-time scheduling and locked / prefaulted memory
+ *  for the capture, sender and writer threads.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RT_H
+#define RT_H
+
+#include <stddef.h>
+
+enum rt_role {
+    RT_CAPTURE = 0,     /* the mir_sdr_ReadPacket loop */
+    RT_SENDER,          /* play_tcp tcp_worker */
+    RT_WRITER,          /* file / command / sink threads */
+    RT_ROLES
+};
+
+#define RT_MEM_DEFAULT   0
+#define RT_MEM_LOCK      1  /* mlockall + prefault buffers */
+#define RT_MEM_HUGE      2  /* as 1, large buffers on huge pages */
+
+struct rt_config {
+    int cpu[RT_ROLES];  /* -1: not pinned */
+    int policy;         /* SCHED_OTHER, SCHED_FIFO or SCHED_RR, capture thread only */
+    int priority;
+    int memory;         /* RT_MEM_* */
+};
+
+extern struct rt_config rt_cfg;
+
+/* "2" or "2,3,1": cpus for capture[,sender[,writer]] */
+int rt_parse_cpus(const char *arg);
+
+/* "fifo:50", "rr:40" or "other" */
+int rt_parse_sched(const char *arg);
+
+/* 0, 1 or 2, see RT_MEM_* */
+int rt_parse_memory(const char *arg);
+
+/*
+ * Applies the configured pinning (and scheduling, for RT_CAPTURE) to the
+ * calling thread and reports what was actually applied on stderr.
+ */
+void rt_apply_thread(enum rt_role role, const char *name);
+
+/*
+ * Same for the threads of the instance'th pipeline of a process running
+ * several: its cpus follow the configured ones, shifted past those of
+ * the previous instances ("-A 0,1" puts instance 1 on cpus 2 and 3).
+ */
+void rt_apply_thread_at(enum rt_role role, int instance, const char *name);
+
+/* mlockall() when requested, reports the result */
+void rt_lock_memory(void);
+
+/*
+ * Buffer allocation honouring rt_cfg.memory: prefaulted, and on huge
+ * pages for large buffers when RT_MEM_HUGE. Release with rt_free().
+ */
+void *rt_alloc(size_t size);
+
+void rt_free(void *ptr, size_t size);
+
+#endif
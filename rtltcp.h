@@ -0,0 +1,82 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  rtltcp: the wire format of play_tcp, shared by the server and the client
+ *  library (tcpclient.h). The server greets with dongle_info_t, then sends
+ *  8 bit I/Q pairs; the client sends 5 byte commands.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLTCP_H
+#define RTLTCP_H
+
+#include <stdint.h>
+
+/* commands, the parameter is a uint32 in network byte order */
+#define CMD_SET_FREQ            0x01
+#define CMD_SET_SAMPLE_RATE     0x02
+#define CMD_SET_GAIN_MODE       0x03
+#define CMD_SET_GAIN            0x04
+#define CMD_SET_FREQ_CORRECTION 0x05
+#define CMD_SET_IF_GAIN         0x06    /* stage << 16 | gain */
+#define CMD_SET_AGC_MODE        0x08
+#define CMD_SET_FRAMING         0x40
+
+typedef struct { /* structure size must be multiple of 2 bytes */
+    char magic[4];
+    uint32_t tuner_type;
+    uint32_t tuner_gain_count;
+} dongle_info_t;
+
+/*
+ * Framed TCP stream, opted in by the client with command 0x40 (param 1,
+ * 0 switches back): from the next packet on the samples come in frames,
+ * this header in network byte order followed by length bytes of 8 bit
+ * I/Q pairs. dropped counts the pairs the queue discarded right before
+ * the frame because the client was too slow; a jump in sample beyond
+ * that was lost in the receiver.
+ *
+ * Param 2 also turns on adaptive 8 bit scaling (-q): every packet keeps
+ * as many low bits as its level allows and a frame starts at every change.
+ * gain_bits is how many: the 16 bit samples are the bytes << (8 - gain_bits).
+ * It stays 0 otherwise, where clients of param 1 read decimation as 32 bits.
+ */
+typedef struct {
+    char magic[4];          /* "RTLF" */
+    uint32_t length;
+    uint32_t sample_hi;     /* number of the first I/Q pair of the frame, at samp_rate */
+    uint32_t sample_lo;
+    uint32_t time_sec;      /* wall clock time of that sample */
+    uint32_t time_nsec;
+    uint32_t dropped;
+    uint16_t gain_bits;     /* 0 to 8, see above */
+    uint16_t decimation;    /* the payload was averaged down to samp_rate / decimation */
+} tcp_frame_t;
+
+#ifdef _WIN32
+#define __attribute__(x)
+#pragma pack(push, 1)
+#endif
+struct command{
+    unsigned char cmd;
+    unsigned int param;
+}__attribute__((packed));
+
+#ifdef _WIN32
+#pragma pack(pop)
+#endif
+
+#endif
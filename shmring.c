@@ -0,0 +1,224 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "shmring.h"
+
+static void futex_wake(uint32_t *addr) {
+    syscall(SYS_futex, addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+static void futex_wait(uint32_t *addr, uint32_t val, int timeout_ms) {
+    struct timespec ts;
+
+    ts.tv_sec = timeout_ms / 1000;
+    ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+    syscall(SYS_futex, addr, FUTEX_WAIT, val, &ts, NULL, 0);
+}
+
+/* page size multiple of at least n: MAP_FIXED views must start on a page, 16 or 64 kB on some arm64 / ppc64 */
+static uint64_t page_round(uint64_t n) {
+    uint64_t page = (uint64_t) sysconf(_SC_PAGESIZE);
+
+    return (n + page - 1) / page * page;
+}
+
+/* header plus the data area twice, the second view starting where the first ends */
+static int shm_ring_map(struct shm_ring *r, int fd, int prot) {
+    uint8_t *base;
+
+    r->map_len = r->header_size + 2 * r->size;
+    base = mmap(NULL, r->map_len, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED)
+        return -1;
+
+    if (mmap(base, r->header_size + r->size, prot, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+        mmap(base + r->header_size + r->size, r->size, prot, MAP_SHARED | MAP_FIXED, fd,
+             (off_t) r->header_size) == MAP_FAILED) {
+        munmap(base, r->map_len);
+        return -1;
+    }
+
+    r->hdr = (struct shm_ring_header *) base;
+    r->data = base + r->header_size;
+    return 0;
+}
+
+int shm_ring_create(struct shm_ring *r, const char *name, uint64_t size,
+                    uint32_t samp_rate, uint32_t format, uint32_t frequency) {
+    int fd;
+
+    memset(r, 0, sizeof(*r));
+    snprintf(r->name, sizeof(r->name), "/%s", name[0] == '/' ? name + 1 : name);
+    r->writer = 1;
+
+    r->header_size = page_round(SHM_RING_HEADER_SIZE);
+    r->size = 65536;
+    while (r->size < size || r->size < page_round(1))
+        r->size <<= 1;
+
+    fd = shm_open(r->name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to create shared memory %s: %s\n", r->name, strerror(errno));
+        return -1;
+    }
+
+    if (ftruncate(fd, (off_t) (r->header_size + r->size)) != 0 || shm_ring_map(r, fd, PROT_READ | PROT_WRITE) != 0) {
+        fprintf(stderr, "Failed to map shared memory %s: %s\n", r->name, strerror(errno));
+        close(fd);
+        shm_unlink(r->name);
+        return -1;
+    }
+    close(fd);
+
+    r->hdr->version = SHM_RING_VERSION;
+    r->hdr->header_size = (uint32_t) r->header_size;
+    r->hdr->size = r->size;
+    r->hdr->samp_rate = samp_rate;
+    r->hdr->format = format;
+    r->hdr->frequency = frequency;
+    /* magic last, readers only trust a complete header */
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(r->hdr->magic, SHM_RING_MAGIC, sizeof(r->hdr->magic));
+
+    return 0;
+}
+
+void shm_ring_write(struct shm_ring *r, const void *buf, size_t len) {
+    uint64_t w = r->hdr->write_index;
+
+    if (len > r->hdr->max_write)
+        __atomic_store_n(&r->hdr->max_write, (uint32_t) len, __ATOMIC_RELEASE);
+    memcpy(r->data + (w & (r->size - 1)), buf, len);
+    __atomic_store_n(&r->hdr->write_index, w + len, __ATOMIC_RELEASE);
+
+    if (w + len - r->last_wake >= SHM_RING_WAKE_BYTES) {
+        r->last_wake = w + len;
+        __atomic_add_fetch(&r->hdr->seq, 1, __ATOMIC_RELEASE);
+        futex_wake(&r->hdr->seq);
+    }
+}
+
+int shm_ring_open(struct shm_ring *r, const char *name) {
+    struct shm_ring_header hdr;
+    int fd;
+
+    memset(r, 0, sizeof(*r));
+    snprintf(r->name, sizeof(r->name), "/%s", name[0] == '/' ? name + 1 : name);
+
+    fd = shm_open(r->name, O_RDONLY, 0);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open shared memory %s: %s\n", r->name, strerror(errno));
+        return -1;
+    }
+
+    if (pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+        memcmp(hdr.magic, SHM_RING_MAGIC, sizeof(hdr.magic)) != 0 || hdr.version != SHM_RING_VERSION) {
+        fprintf(stderr, "%s is not a play_sdr ring (or not ready yet)\n", r->name);
+        close(fd);
+        return -1;
+    }
+
+    r->size = hdr.size;
+    r->header_size = hdr.header_size;
+    if (r->header_size < sizeof(hdr) || page_round(r->header_size) != r->header_size ||
+        page_round(r->size) != r->size) {
+        fprintf(stderr, "%s was made for another page size\n", r->name);
+        close(fd);
+        return -1;
+    }
+    if (shm_ring_map(r, fd, PROT_READ) != 0) {
+        fprintf(stderr, "Failed to map shared memory %s: %s\n", r->name, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    close(fd);
+
+    r->cursor = __atomic_load_n(&r->hdr->write_index, __ATOMIC_ACQUIRE);
+    return 0;
+}
+
+/* bytes behind write_index that cannot be overwritten by a write in flight */
+static uint64_t shm_ring_safe(struct shm_ring *r) {
+    return r->size - __atomic_load_n(&r->hdr->max_write, __ATOMIC_ACQUIRE);
+}
+
+long shm_ring_wait(struct shm_ring *r, const uint8_t **data, int timeout_ms) {
+    uint64_t w;
+    uint32_t seq;
+
+    for (;;) {
+        seq = __atomic_load_n(&r->hdr->seq, __ATOMIC_ACQUIRE);
+        w = __atomic_load_n(&r->hdr->write_index, __ATOMIC_ACQUIRE);
+
+        if (w - r->cursor > shm_ring_safe(r)) {
+            /* lapped, continue half a ring behind the writer */
+            r->overruns++;
+            r->lost += w - r->size / 2 - r->cursor;
+            r->cursor = w - r->size / 2;
+        }
+
+        if (w != r->cursor) {
+            *data = r->data + (r->cursor & (r->size - 1));
+            return (long) (w - r->cursor);
+        }
+
+        if (__atomic_load_n(&r->hdr->closed, __ATOMIC_ACQUIRE))
+            return -1;
+
+        if (timeout_ms <= 0)
+            return 0;
+
+        futex_wait(&r->hdr->seq, seq, timeout_ms);
+        timeout_ms = 0; /* one wait, then report what is there */
+    }
+}
+
+int shm_ring_consume(struct shm_ring *r, size_t len) {
+    uint64_t w = __atomic_load_n(&r->hdr->write_index, __ATOMIC_ACQUIRE);
+    int overwritten = (w - r->cursor > shm_ring_safe(r));
+
+    r->cursor += len;
+    return overwritten ? -1 : 0;
+}
+
+void shm_ring_close(struct shm_ring *r) {
+    if (!r->hdr)
+        return;
+
+    if (r->writer) {
+        __atomic_store_n(&r->hdr->closed, 1, __ATOMIC_RELEASE);
+        __atomic_add_fetch(&r->hdr->seq, 1, __ATOMIC_RELEASE);
+        futex_wake(&r->hdr->seq);
+        shm_unlink(r->name);
+    }
+
+    munmap(r->hdr, r->map_len);
+    r->hdr = NULL;
+}
@@ -0,0 +1,98 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  shmring: single writer, many reader sample ring in POSIX shared memory.
+ *
+ *  The data area is mapped twice back to back, so every read or write of
+ *  up to the ring size is one contiguous block, and readers work on the
+ *  mapping itself without copies. Readers map the ring read-only and keep
+ *  their own cursor; a reader that falls more than the ring size behind
+ *  is moved forward and the overrun counted. The writer wakes waiting
+ *  readers through a futex on the seq word.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SHMRING_H
+#define SHMRING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHM_RING_MAGIC          "SDRPRING"
+#define SHM_RING_VERSION        1
+#define SHM_RING_HEADER_SIZE    4096    /* rounded up to the page size, data follows */
+#define SHM_RING_DEFAULT_SIZE   (16 * 1024 * 1024)
+#define SHM_RING_WAKE_BYTES     16384   /* writer wakes readers at most once per this much data */
+
+/* sample formats */
+#define SHM_FMT_CS8     1   /* interleaved signed 8 bit I/Q, the top byte of the 16 bit samples */
+#define SHM_FMT_CS16    2   /* interleaved signed 16 bit I/Q, play_sdr -x 16 */
+
+struct shm_ring_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t size;              /* bytes in the data area, a power of two */
+    uint32_t samp_rate;
+    uint32_t format;
+    uint32_t frequency;
+    uint32_t closed;            /* set when the writer is gone */
+    uint64_t write_index;       /* total bytes ever written */
+    uint32_t seq;               /* futex word, bumped on every wake */
+    uint32_t max_write;         /* largest single write, may be in flight past write_index */
+};
+
+struct shm_ring {
+    struct shm_ring_header *hdr;
+    uint8_t *data;
+    uint64_t size;
+    uint64_t header_size;       /* offset of the data, a page multiple */
+    size_t map_len;
+    int writer;
+    char name[256];
+
+    uint64_t cursor;            /* reader: next byte to read */
+    uint64_t overruns;          /* reader: times the writer lapped us */
+    uint64_t lost;              /* reader: bytes skipped by those */
+    uint64_t last_wake;         /* writer */
+};
+
+/* writer side, size is rounded up to a power of two. Returns 0 on success. */
+int shm_ring_create(struct shm_ring *r, const char *name, uint64_t size,
+                    uint32_t samp_rate, uint32_t format, uint32_t frequency);
+
+/* appends len (at most the ring size) bytes and publishes them */
+void shm_ring_write(struct shm_ring *r, const void *buf, size_t len);
+
+/* reader side: maps the ring read-only, starts at the current write position */
+int shm_ring_open(struct shm_ring *r, const char *name);
+
+/*
+ * Waits up to timeout_ms for data. Returns the number of readable bytes
+ * at *data (0 on timeout), or -1 once the writer closed the ring.
+ */
+long shm_ring_wait(struct shm_ring *r, const uint8_t **data, int timeout_ms);
+
+/*
+ * Marks len bytes as read. Returns -1 when the writer overwrote them
+ * while they were being processed.
+ */
+int shm_ring_consume(struct shm_ring *r, size_t len);
+
+/* unmaps, the writer also marks the ring closed and unlinks it */
+void shm_ring_close(struct shm_ring *r);
+
+#endif
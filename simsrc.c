@@ -0,0 +1,84 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "simsrc.h"
+
+#define SIM_AMPLITUDE   4096.0
+#define SIM_NOISE       64
+
+void sim_init(struct sim_source *sim, uint32_t samp_rate, uint32_t frequency, int *samplesPerPacket) {
+    memset(sim, 0, sizeof(*sim));
+
+    sim->samp_rate = samp_rate;
+    sim->frequency = frequency;
+    sim->tone = frequency + SIM_TONE_OFFSET;
+    sim->noise = 0x2545f491;
+    sim->paced = 1;
+    clock_gettime(CLOCK_MONOTONIC, &sim->next);
+
+    *samplesPerPacket = SIM_SAMPLES_PER_PACKET;
+}
+
+void sim_set_rf(struct sim_source *sim, uint32_t frequency) {
+    sim->frequency = frequency;
+}
+
+int sim_read_packet(struct sim_source *sim, short *ibuf, short *qbuf, unsigned int *firstSample) {
+    double step = 2.0 * M_PI * ((double) sim->tone - (double) sim->frequency) / sim->samp_rate;
+    long period = (long) (1e9 * SIM_SAMPLES_PER_PACKET / sim->samp_rate);
+    int i;
+
+    if (sim->paced) {
+        sim->next.tv_nsec += period;
+        while (sim->next.tv_nsec >= 1000000000L) {
+            sim->next.tv_nsec -= 1000000000L;
+            sim->next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &sim->next, NULL);
+    }
+
+    /* carrier out of the simulated 'IF' filter when tuned far away */
+    if (fabs(step) > M_PI)
+        step = 0.0;
+
+    for (i = 0; i < SIM_SAMPLES_PER_PACKET; i++) {
+        int ni, nq;
+
+        sim->noise = sim->noise * 1664525u + 1013904223u;
+        ni = (int) (sim->noise >> 25) - SIM_NOISE;
+        nq = (int) ((sim->noise >> 9) & 0x7f) - SIM_NOISE;
+
+        if (step != 0.0) {
+            ibuf[i] = (short) (SIM_AMPLITUDE * cos(sim->phase) + ni);
+            qbuf[i] = (short) (SIM_AMPLITUDE * sin(sim->phase) + nq);
+            sim->phase += step;
+        } else {
+            ibuf[i] = (short) ni;
+            qbuf[i] = (short) nq;
+        }
+    }
+    sim->phase = fmod(sim->phase, 2.0 * M_PI);
+
+    *firstSample = sim->sample;
+    sim->sample += SIM_SAMPLES_PER_PACKET;
+
+    return 0;
+}
@@ -0,0 +1,50 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  simsrc: a simulated RSP. Produces mir_sdr_ReadPacket style split
+ *  I/Q packets (a carrier plus noise) paced at the sample rate, so the
+ *  servers can be run and tested without hardware.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SIMSRC_H
+#define SIMSRC_H
+
+#include <stdint.h>
+#include <time.h>
+
+#define SIM_SAMPLES_PER_PACKET  336
+#define SIM_TONE_OFFSET         100000  /* carrier sits this far above the first tuned frequency */
+
+struct sim_source {
+    uint32_t samp_rate;
+    uint32_t frequency;
+    uint32_t tone;              /* absolute carrier frequency, Hz */
+    double phase;
+    uint32_t noise;             /* LCG state */
+    unsigned int sample;        /* running sample number, like firstSampleNum */
+    int paced;                  /* 0: run as fast as possible */
+    struct timespec next;
+};
+
+void sim_init(struct sim_source *sim, uint32_t samp_rate, uint32_t frequency, int *samplesPerPacket);
+
+void sim_set_rf(struct sim_source *sim, uint32_t frequency);
+
+/* blocks until the packet is due, same contract as mir_sdr_ReadPacket */
+int sim_read_packet(struct sim_source *sim, short *ibuf, short *qbuf, unsigned int *firstSample);
+
+#endif
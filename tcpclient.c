@@ -0,0 +1,341 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* memfd_create, memmem */
+#endif
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "iqdsp.h"
+#include "rtltcp.h"
+#include "tcpclient.h"
+
+/* the ring twice, the second view starting where the first ends */
+static int ring_map(struct tcp_client *c) {
+    uint8_t *base;
+    int fd;
+
+    fd = memfd_create("tcpclient", 0);
+    if (fd < 0)
+        return -1;
+    if (ftruncate(fd, (off_t) c->size) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    base = mmap(NULL, 2 * c->size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+    if (mmap(base, c->size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+        mmap(base + c->size, c->size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(base, 2 * c->size);
+        close(fd);
+        return -1;
+    }
+
+    close(fd);
+    c->ring = base;
+    return 0;
+}
+
+static int recv_all(int s, uint8_t *buf, int len) {
+    int n;
+
+    while (len > 0) {
+        n = recv(s, buf, len, 0);
+        if (n <= 0)
+            return -1;
+        buf += n;
+        len -= n;
+    }
+
+    return 0;
+}
+
+static int connect_to(const char *addr, int port) {
+    struct addrinfo hints, *res, *ai;
+    char service[16];
+    int s = -1, size = TCP_CLIENT_RCVBUF, one = 1;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    snprintf(service, sizeof(service), "%d", port);
+    if (getaddrinfo(addr, service, &hints, &res) != 0)
+        return -1;
+
+    for (ai = res; ai; ai = ai->ai_next) {
+        s = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (s < 0)
+            continue;
+        /* before connect, so that the window scale is negotiated for it */
+        setsockopt(s, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+        setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        if (connect(s, ai->ai_addr, ai->ai_addrlen) == 0)
+            break;
+        close(s);
+        s = -1;
+    }
+
+    freeaddrinfo(res);
+    return s;
+}
+
+static void span_raw(struct tcp_client *c) {
+    c->span.frame_ns = 0;
+    c->span.gain_bits = 0;
+    c->span.decimation = 1;
+    c->span.frame_start = 0;
+}
+
+int tcp_client_connect(struct tcp_client *c, const char *addr, int port, uint64_t ring_size, int read_size) {
+    dongle_info_t info;
+
+    memset(c, 0, sizeof(c[0]));
+    span_raw(c);
+    c->size = 65536;
+    while (c->size < ring_size)
+        c->size <<= 1;
+
+    c->s = connect_to(addr, port);
+    if (c->s < 0)
+        return -1;
+    if (recv_all(c->s, (uint8_t *) &info, sizeof(info)) != 0 || memcmp(info.magic, "RTL0", 4) != 0 ||
+        ring_map(c) != 0) {
+        close(c->s);
+        c->s = -1;
+        return -1;
+    }
+    c->tuner_type = ntohl(info.tuner_type);
+    c->tuner_gain_count = ntohl(info.tuner_gain_count);
+
+    /* a wake up should leave room for the next one in the ring */
+    if (read_size > (int) (c->size / 4))
+        read_size = (int) (c->size / 4);
+    if (read_size > 1)
+        setsockopt(c->s, SOL_SOCKET, SO_RCVLOWAT, &read_size, sizeof(read_size));
+
+    return 0;
+}
+
+int tcp_client_command(struct tcp_client *c, uint8_t cmd, uint32_t param) {
+    struct command command;
+
+    command.cmd = cmd;
+    command.param = htonl(param);
+    return send(c->s, &command, sizeof(command), MSG_NOSIGNAL) == sizeof(command) ? 0 : -1;
+}
+
+int tcp_client_set_framing(struct tcp_client *c, int mode) {
+    if (tcp_client_command(c, CMD_SET_FRAMING, (uint32_t) mode) != 0)
+        return -1;
+    /* out of sync until the first header: the raw samples still in flight are skipped */
+    c->framing = mode;
+    return 0;
+}
+
+static void skip(struct tcp_client *c, uint64_t len) {
+    c->rd += len;
+    c->stats.skipped += len;
+}
+
+/*
+ * 1 when a frame header was taken at rd, 0 when more data is needed, -1
+ * when there is none and no frames were asked for (raw again).
+ */
+static int take_header(struct tcp_client *c) {
+    const uint8_t *p, *m;
+    uint64_t avail, sample, expect;
+    tcp_frame_t f;
+    uint32_t len, dropped;
+    int gain_bits, decimation;
+
+    for (;;) {
+        avail = c->wr - c->rd;
+        p = c->ring + (c->rd & (c->size - 1));
+
+        if (!c->synced) {
+            m = memmem(p, avail, "RTLF", 4);
+            if (!m) {
+                skip(c, avail > 3 ? avail - 3 : 0);
+                return 0;
+            }
+            skip(c, (uint64_t) (m - p));
+            avail -= m - p;
+            p = m;
+            c->synced = 1;
+        }
+        if (avail < sizeof(f))
+            return 0;
+
+        memcpy(&f, p, sizeof(f));
+        len = ntohl(f.length);
+        gain_bits = ntohs(f.gain_bits);
+        decimation = ntohs(f.decimation);
+        if (memcmp(f.magic, "RTLF", 4) != 0 || len == 0 || (len & 1) || gain_bits > 8 || decimation == 0) {
+            c->synced = 0;
+            if (!c->framing)
+                return -1;
+            /* the pattern was sample data, look further on */
+            skip(c, 1);
+            continue;
+        }
+        break;
+    }
+
+    sample = (uint64_t) ntohl(f.sample_hi) << 32 | ntohl(f.sample_lo);
+    dropped = ntohl(f.dropped);
+    expect = c->next_sample + dropped;
+    if (c->have_next && sample != expect) {
+        c->stats.gaps++;
+        if (sample > expect)
+            c->stats.lost += sample - expect;
+    }
+
+    c->stats.frames++;
+    c->stats.dropped += dropped;
+    c->span.sample = sample;
+    c->span.frame_ns = (uint64_t) ntohl(f.time_sec) * 1000000000ULL + ntohl(f.time_nsec);
+    c->span.gain_bits = gain_bits;
+    c->span.decimation = decimation;
+    c->span.frame_start = 1;
+    c->frame_left = len;
+    c->have_next = 1;
+    c->next_sample = sample + (uint64_t) (len / 2) * decimation;
+    c->rd += sizeof(f);
+    return 1;
+}
+
+/* one recv of as much as the ring takes: 1 on data, 0 on timeout, -1 when closed */
+static int fill(struct tcp_client *c, int timeout_ms) {
+    struct pollfd pfd;
+    uint64_t space = c->size - (c->wr - c->rd);
+    ssize_t n;
+    int r;
+
+    if (space == 0)
+        return 0;
+
+    for (;;) {
+        pfd.fd = c->s;
+        pfd.events = POLLIN;
+        r = poll(&pfd, 1, timeout_ms);
+        if (r == 0 || (r < 0 && errno == EINTR))
+            return 0;
+        if (r < 0)
+            return -1;
+
+        n = recv(c->s, c->ring + (c->wr & (c->size - 1)), space, MSG_DONTWAIT);
+        if (n > 0)
+            break;
+        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+            return -1;
+    }
+
+    c->wr += n;
+    c->stats.bytes += n;
+    c->stats.reads++;
+    return 1;
+}
+
+long tcp_client_read(struct tcp_client *c, const uint8_t **data, struct tcp_client_span *span, int timeout_ms) {
+    uint64_t n;
+    int r;
+
+    for (;;) {
+        r = 1;
+        if (c->frame_left == 0 && (c->framing || c->synced)) {
+            r = take_header(c);
+            if (r > 0)
+                continue;
+            if (r < 0)
+                span_raw(c);
+        }
+
+        if (r != 0) {
+            n = c->wr - c->rd;
+            if (c->frame_left && c->frame_left < n)
+                n = c->frame_left;
+            n &= ~(uint64_t) 1;
+            if (n) {
+                *data = c->ring + (c->rd & (c->size - 1));
+                if (span)
+                    *span = c->span;
+                return (long) n;
+            }
+        }
+
+        if ((r = fill(c, timeout_ms)) <= 0)
+            return r;
+    }
+}
+
+void tcp_client_consume(struct tcp_client *c, size_t len) {
+    uint64_t pairs = len / 2;
+
+    c->rd += len;
+    c->stats.pairs += pairs;
+    c->span.sample += pairs * c->span.decimation;
+    c->span.frame_start = 0;
+    if (c->frame_left) {
+        c->frame_left -= len;
+        if (c->frame_left == 0 && !c->framing)
+            span_raw(c);
+    }
+}
+
+int tcp_client_read_cf32(struct tcp_client *c, float *out, int max_pairs, struct tcp_client_span *span,
+                         int timeout_ms) {
+    const uint8_t *data;
+    struct tcp_client_span local;
+    long n;
+
+    if (!span)
+        span = &local;
+    n = tcp_client_read(c, &data, span, timeout_ms);
+    if (n <= 0)
+        return (int) n;
+    if (n / 2 > max_pairs)
+        n = 2L * max_pairs;
+
+    iq_cs8_to_cf32(data, (int) (n / 2), span->gain_bits, out);
+    tcp_client_consume(c, (size_t) n);
+    return (int) (n / 2);
+}
+
+void tcp_client_close(struct tcp_client *c) {
+    if (c->s >= 0)
+        close(c->s);
+    if (c->ring)
+        munmap(c->ring, 2 * c->size);
+    c->s = -1;
+    c->ring = NULL;
+}
@@ -0,0 +1,114 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  tcpclient: receive side of the play_tcp protocol (rtltcp.h), for
+ *  consumers that should not each write their own socket loop.
+ *
+ *  The stream is read with large recv calls straight into a ring that is
+ *  mapped twice back to back, like shmring, so samples and frame headers
+ *  are always contiguous and handed out in place. In framed mode the
+ *  headers are taken out of the stream: the reader only sees I/Q pairs,
+ *  each run with the frame it belongs to, and the client counts what the
+ *  server dropped and what went missing in the receiver.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TCPCLIENT_H
+#define TCPCLIENT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TCP_CLIENT_RING_DEFAULT (8 * 1024 * 1024)
+#define TCP_CLIENT_RCVBUF       (4 * 1024 * 1024)
+
+/* where the pairs returned by tcp_client_read belong */
+struct tcp_client_span {
+    uint64_t sample;            /* number of the first pair at the server's sample rate (raw: pairs received) */
+    uint64_t frame_ns;          /* wall clock time of the start of its frame, 0 when not framed */
+    int gain_bits;              /* 16 bit samples are the bytes << (8 - gain_bits) */
+    int decimation;             /* each pair stands for that many at the sample rate */
+    int frame_start;            /* the first pair of a frame */
+};
+
+struct tcp_client_stats {
+    uint64_t bytes;             /* received, headers included */
+    uint64_t reads;             /* recv calls that returned data */
+    uint64_t pairs;             /* consumed */
+    uint64_t frames;
+    uint64_t dropped;           /* pairs the server queue discarded, as reported in the frames */
+    uint64_t gaps;              /* frames that do not continue the previous one */
+    uint64_t lost;              /* pairs missing at those, beyond the dropped ones */
+    uint64_t skipped;           /* bytes outside frames: raw samples before the first one, garbage */
+};
+
+struct tcp_client {
+    int s;
+    uint32_t tuner_type;        /* from the greeting */
+    uint32_t tuner_gain_count;
+    int framing;                /* asked for: 0 raw, 1 frames, 2 frames with adaptive scaling */
+
+    uint8_t *ring;              /* size bytes, mapped twice */
+    uint64_t size;
+    uint64_t rd, wr;            /* total bytes consumed / received */
+
+    int synced;                 /* rd is at a frame header or inside a frame */
+    uint64_t frame_left;        /* payload bytes of the current frame not consumed yet */
+    int have_next;
+    uint64_t next_sample;       /* where the next frame should start */
+    struct tcp_client_span span;
+
+    struct tcp_client_stats stats;
+};
+
+/*
+ * Connects and reads the greeting. ring_size is rounded up to a power of
+ * two of at least a page, read_size (0: anything) is how much the socket
+ * should have before a read returns, trading latency for fewer syscalls.
+ * Returns 0 on success.
+ */
+int tcp_client_connect(struct tcp_client *c, const char *addr, int port, uint64_t ring_size, int read_size);
+
+/* sends one command, param in host byte order. Returns 0 on success. */
+int tcp_client_command(struct tcp_client *c, uint8_t cmd, uint32_t param);
+
+/*
+ * Asks for mode 0 (raw), 1 (frames) or 2 (frames, adaptive scaling). Raw
+ * samples still in flight are skipped until the first frame header.
+ */
+int tcp_client_set_framing(struct tcp_client *c, int mode);
+
+/*
+ * Waits up to timeout_ms for samples. Returns the number of bytes of
+ * whole pairs at *data (0 on timeout), all of the frame described in
+ * *span, or -1 once the connection is closed.
+ */
+long tcp_client_read(struct tcp_client *c, const uint8_t **data, struct tcp_client_span *span, int timeout_ms);
+
+/* marks len bytes (whole pairs, at most what tcp_client_read returned) as done */
+void tcp_client_consume(struct tcp_client *c, size_t len);
+
+/*
+ * tcp_client_read, iq_cs8_to_cf32 and tcp_client_consume in one: up to
+ * max_pairs interleaved float pairs to out. Returns the number of pairs,
+ * 0 on timeout, -1 once the connection is closed.
+ */
+int tcp_client_read_cf32(struct tcp_client *c, float *out, int max_pairs, struct tcp_client_span *span,
+                         int timeout_ms);
+
+void tcp_client_close(struct tcp_client *c);
+
+#endif
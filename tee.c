@@ -0,0 +1,340 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "tee.h"
+#include "trace.h"
+
+#define PAIR_BYTES  4   /* the ring holds 16 bit interleaved I/Q */
+
+int tee_add(struct tee *t, const char *spec) {
+    struct tee_sink *s;
+    char *copy, *opt, *save = NULL;
+
+    if (t->nsinks == TEE_MAX_SINKS) {
+        fprintf(stderr, "Too many outputs, at most %d\n", TEE_MAX_SINKS);
+        return -1;
+    }
+    s = &t->sinks[t->nsinks];
+    memset(s, 0, sizeof(*s));
+    s->bits = 8;
+    s->decim = 1;
+    s->listen_fd = s->client_fd = -1;
+
+    copy = strdup(spec);
+    s->target = strdup(strtok_r(copy, ",", &save));
+    while ((opt = strtok_r(NULL, ",", &save)) != NULL) {
+        if (strncmp(opt, "bits=", 5) == 0)
+            s->bits = atoi(opt + 5);
+        else if (strncmp(opt, "decim=", 6) == 0)
+            s->decim = atoi(opt + 6);
+        else
+            s->bits = 0;
+    }
+    free(copy);
+    if ((s->bits != 8 && s->bits != 16) || s->decim < 1) {
+        free(s->target);
+        return -1;
+    }
+
+    if (strcmp(s->target, "-") == 0) {
+        s->kind = TEE_STDOUT;
+        t->uses_stdout = 1;
+    } else if (strncmp(s->target, "tcp:", 4) == 0) {
+        s->kind = TEE_TCP;
+    } else if (strncmp(s->target, "shm:", 4) == 0) {
+        s->kind = TEE_SHM;
+    } else {
+        s->kind = TEE_FILE;
+    }
+
+    t->nsinks++;
+    return 0;
+}
+
+static int open_target(struct tee_sink *s, uint32_t rate, uint32_t frequency) {
+    struct sockaddr_in addr;
+    char *name, *sep;
+    uint64_t size = SHM_RING_DEFAULT_SIZE;
+    int one = 1;
+
+    switch (s->kind) {
+        case TEE_FILE:
+            s->file = fopen(s->target, "wb");
+            break;
+        case TEE_STDOUT:
+            s->file = stdout;
+            break;
+        case TEE_TCP:
+            memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(atoi(s->target + 4));
+            addr.sin_addr.s_addr = htonl(INADDR_ANY);
+            s->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+            setsockopt(s->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            if (bind(s->listen_fd, (struct sockaddr *) &addr, sizeof(addr)) != 0 || listen(s->listen_fd, 1) != 0) {
+                fprintf(stderr, "Failed to listen on %s: %s\n", s->target, strerror(errno));
+                return -1;
+            }
+            /* polled between chunks, the sink keeps reading while nobody is connected */
+            fcntl(s->listen_fd, F_SETFL, O_NONBLOCK);
+            return 0;
+        case TEE_SHM:
+            name = strdup(s->target + 4);
+            sep = strchr(name, ':');
+            if (sep) {
+                *sep = '\0';
+                size = (uint64_t) atoi(sep + 1) * 1024 * 1024;
+            }
+            if (shm_ring_create(&s->out_ring, name, size, rate, s->bits == 8 ? SHM_FMT_CS8 : SHM_FMT_CS16,
+                                frequency) != 0) {
+                free(name);
+                return -1;
+            }
+            free(name);
+            return 0;
+    }
+
+    if (!s->file) {
+        fprintf(stderr, "Failed to open %s\n", s->target);
+        return -1;
+    }
+    return 0;
+}
+
+static void poll_client(struct tee_sink *s) {
+    struct timeval tv = {1, 0};
+    int fd = accept(s->listen_fd, NULL, NULL);
+
+    if (fd < 0)
+        return;
+    if (s->client_fd >= 0)
+        close(s->client_fd);
+    /* a stalled client must not keep the sink from seeing the end */
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    s->client_fd = fd;
+    fprintf(stderr, "[%s] client connected\n", s->target);
+}
+
+static int send_client(struct tee_sink *s, const uint8_t *buf, size_t len) {
+    ssize_t n;
+
+    while (len > 0) {
+        n = send(s->client_fd, buf, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR && !__atomic_load_n(&s->reader.hdr->closed, __ATOMIC_ACQUIRE))
+            continue;
+        /* EAGAIN: nothing went out for the whole SO_SNDTIMEO, the client stopped reading */
+        if (n <= 0) {
+            fprintf(stderr, "[%s] client %s\n", s->target, n < 0 && errno == EAGAIN ? "stalled, dropped" : "gone");
+            close(s->client_fd);
+            s->client_fd = -1;
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+
+    return 0;
+}
+
+static int emit(struct tee_sink *s, const void *buf, size_t len) {
+    switch (s->kind) {
+        case TEE_TCP:
+            if (s->client_fd < 0 || send_client(s, buf, len) != 0)
+                return 0;
+            break;
+        case TEE_SHM:
+            shm_ring_write(&s->out_ring, buf, len);
+            break;
+        default:
+            if (fwrite(buf, 1, len, s->file) != len)
+                return -1;
+            break;
+    }
+    s->written += len;
+
+    return 0;
+}
+
+/* one chunk of interleaved 16 bit pairs in the sink's format */
+static int convert(struct tee_sink *s, const short *iq, int pairs) {
+    uint8_t *o8 = s->out;
+    int k, n;
+
+    if (s->decim > 1) {
+        for (k = 0; k < pairs; k++) {
+            s->i[k] = iq[2 * k];
+            s->q[k] = iq[2 * k + 1];
+        }
+        n = pipeline_run(&s->pipe, s->i, s->q, pairs, s->out);
+        return emit(s, s->out, (size_t) n * (s->bits == 8 ? 2 : 4));
+    }
+
+    if (s->bits == 16)
+        return emit(s, iq, (size_t) pairs * PAIR_BYTES);
+
+    for (k = 0; k < 2 * pairs; k++)
+        o8[k] = (unsigned char) (iq[k] >> 8);
+    return emit(s, o8, (size_t) pairs * 2);
+}
+
+static void *sink_worker(void *arg) {
+    struct tee_sink *s = arg;
+    const uint8_t *data;
+    uint64_t lag, t;
+    long avail;
+    size_t len;
+    int failed = 0;
+
+    while ((avail = shm_ring_wait(&s->reader, &data, 200)) >= 0) {
+        if (s->kind == TEE_TCP && s->client_fd < 0)
+            poll_client(s);
+        if (avail == 0)
+            continue;
+
+        lag = (uint64_t) avail;
+        if (lag > s->max_lag)
+            s->max_lag = lag;
+
+        len = (size_t) avail;
+        if (len > TEE_CHUNK_PAIRS * PAIR_BYTES)
+            len = TEE_CHUNK_PAIRS * PAIR_BYTES;
+
+        t = trace_begin();
+        if (s->kind == TEE_TCP && s->client_fd < 0)
+            s->discarded += len;
+        else if (!failed && convert(s, (const short *) data, (int) (len / PAIR_BYTES)) != 0) {
+            fprintf(stderr, "[%s] short write, this output stops\n", s->target);
+            failed = 1;
+        }
+        trace_end("sink", t, (int64_t) len);
+
+        /* overwritten while we converted it: what went out is torn, count it */
+        if (shm_ring_consume(&s->reader, len) != 0)
+            s->errors++;
+    }
+
+    return NULL;
+}
+
+int tee_start(struct tee *t, uint32_t samp_rate, uint32_t frequency, int max_samples) {
+    struct tee_sink *s;
+    uint64_t size = (uint64_t) samp_rate * PAIR_BYTES * TEE_RING_SECONDS;
+    char name[64], spec[32];
+    uint32_t rate;
+    int k;
+
+    t->samp_rate = samp_rate;
+    t->max_samples = max_samples;
+    t->iq = malloc((size_t) max_samples * PAIR_BYTES);
+    snprintf(name, sizeof(name), "play_sdr-tee-%d", (int) getpid());
+    if (shm_ring_create(&t->ring, name, size > SHM_RING_DEFAULT_SIZE ? size : SHM_RING_DEFAULT_SIZE, samp_rate,
+                        SHM_FMT_CS16, frequency) != 0)
+        return -1;
+
+    for (k = 0; k < t->nsinks; k++) {
+        s = &t->sinks[k];
+        rate = samp_rate / s->decim;
+        if (s->decim > 1) {
+            snprintf(spec, sizeof(spec), "decim:%d", s->decim);
+            if (pipeline_parse(&s->pipe, spec, samp_rate, s->bits) != 0 ||
+                pipeline_prepare(&s->pipe, TEE_CHUNK_PAIRS) != 0)
+                return -1;
+            s->i = malloc(TEE_CHUNK_PAIRS * sizeof(short));
+            s->q = malloc(TEE_CHUNK_PAIRS * sizeof(short));
+        }
+        s->out = malloc(TEE_CHUNK_PAIRS * PAIR_BYTES);
+        if (open_target(s, rate, frequency) != 0 || shm_ring_open(&s->reader, name) != 0)
+            return -1;
+        if (pthread_create(&s->thread, NULL, sink_worker, s) != 0) {
+            fprintf(stderr, "Failed to start the thread of %s\n", s->target);
+            return -1;
+        }
+        fprintf(stderr, "Output %s: %d bit, %u S/s\n", s->target, s->bits, rate);
+    }
+
+    return 0;
+}
+
+void tee_write(struct tee *t, const short *ibuf, const short *qbuf, int n, int flip) {
+    const short *a = flip ? qbuf : ibuf, *b = flip ? ibuf : qbuf;
+    int k;
+
+    for (k = 0; k < n; k++) {
+        t->iq[2 * k] = a[k];
+        t->iq[2 * k + 1] = b[k];
+    }
+    shm_ring_write(&t->ring, t->iq, (size_t) n * PAIR_BYTES);
+}
+
+void tee_close(struct tee *t) {
+    struct tee_sink *s;
+    double rate = (double) t->samp_rate * PAIR_BYTES;
+    int k;
+
+    /* readers see the ring closed once they have read everything in it */
+    shm_ring_close(&t->ring);
+
+    for (k = 0; k < t->nsinks; k++) {
+        s = &t->sinks[k];
+        if (s->thread)
+            pthread_join(s->thread, NULL);
+
+        fprintf(stderr, "[%s] %.1f MB written, lag up to %.0f ms, %llu overruns (%.1f MB lost)", s->target,
+                s->written / 1e6, rate > 0 ? s->max_lag / rate * 1000 : 0.0, (unsigned long long) s->reader.overruns,
+                s->reader.lost / 1e6);
+        if (s->kind == TEE_TCP)
+            fprintf(stderr, ", %.1f MB without a client", s->discarded / 1e6);
+        if (s->errors)
+            fprintf(stderr, ", %llu chunks overwritten while being written", (unsigned long long) s->errors);
+        fprintf(stderr, "\n");
+
+        if (s->reader.hdr)
+            shm_ring_close(&s->reader);
+        if (s->kind == TEE_FILE && s->file)
+            fclose(s->file);
+        else if (s->kind == TEE_STDOUT)
+            fflush(stdout);
+        else if (s->kind == TEE_TCP) {
+            if (s->client_fd >= 0)
+                close(s->client_fd);
+            if (s->listen_fd >= 0)
+                close(s->listen_fd);
+        } else if (s->kind == TEE_SHM)
+            shm_ring_close(&s->out_ring);
+        if (s->decim > 1)
+            pipeline_free(&s->pipe);
+        free(s->i);
+        free(s->q);
+        free(s->out);
+        free(s->target);
+    }
+    free(t->iq);
+}
@@ -0,0 +1,102 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  tee: extra outputs of play_sdr (-o), each fed by its own thread.
+ *
+ *  The capture thread appends every packet, as 16 bit interleaved I/Q, to
+ *  one ring (a shmring private to the process) and goes on; it never waits
+ *  for a sink. Every sink reads the ring through its own cursor, converts
+ *  to its format and decimation and writes to its target:
+ *
+ *    path            a file
+ *    -               stdout
+ *    tcp:port        the raw stream to one client at a time, as rtl_tcp
+ *                    without the header and commands
+ *    shm:name[:MB]   a shared memory ring of its own (see shmring.h)
+ *
+ *  followed by options, e.g. "tcp:1235,bits=16,decim=4". A sink that falls
+ *  more than the ring behind is moved forward by the ring, the samples it
+ *  missed are counted against it alone.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEE_H
+#define TEE_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "pipeline.h"
+#include "shmring.h"
+
+#define TEE_MAX_SINKS       8
+#define TEE_CHUNK_PAIRS     16384   /* I/Q pairs a sink handles at once */
+#define TEE_RING_SECONDS    2       /* ring size at the capture rate, at least SHM_RING_DEFAULT_SIZE */
+
+enum tee_kind {
+    TEE_FILE,
+    TEE_STDOUT,
+    TEE_TCP,
+    TEE_SHM
+};
+
+struct tee_sink {
+    char *target;
+    enum tee_kind kind;
+    int bits;
+    int decim;
+
+    FILE *file;
+    int listen_fd, client_fd;
+    struct shm_ring out_ring;
+
+    struct shm_ring reader;
+    struct pipeline pipe;       /* decim > 1 */
+    short *i, *q;
+    void *out;
+
+    uint64_t written;           /* bytes out */
+    uint64_t discarded;         /* input bytes read while no tcp client was connected */
+    uint64_t max_lag;           /* bytes behind the capture */
+    uint64_t errors;
+    pthread_t thread;
+};
+
+struct tee {
+    struct tee_sink sinks[TEE_MAX_SINKS];
+    int nsinks;
+    int uses_stdout;
+
+    struct shm_ring ring;
+    uint32_t samp_rate;
+    short *iq;
+    int max_samples;
+};
+
+/* parses one -o argument. Returns 0 on success. */
+int tee_add(struct tee *t, const char *spec);
+
+/* creates the ring and starts the sinks. Returns 0 on success. */
+int tee_start(struct tee *t, uint32_t samp_rate, uint32_t frequency, int max_samples);
+
+/* capture thread: appends one packet, swapped when flip is set */
+void tee_write(struct tee *t, const short *ibuf, const short *qbuf, int n, int flip);
+
+/* lets the sinks drain the ring, stops them and prints what each one lost */
+void tee_close(struct tee *t);
+
+#endif
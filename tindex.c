@@ -0,0 +1,197 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tindex.h"
+
+int tindex_open(struct time_index *ti, const char *path, uint32_t samp_rate, int bits, int scaled,
+                double interval_s) {
+    struct tindex_header hdr;
+
+    memset(ti, 0, sizeof(*ti));
+    ti->samp_rate = samp_rate;
+    ti->interval_ns = (int64_t) (interval_s * 1e9);
+    ti->shift = bits == 8 ? 8 : 0;
+
+    ti->file = fopen(path, "wb");
+    if (!ti->file) {
+        fprintf(stderr, "Failed to open time index %s\n", path);
+        return -1;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, "TIDX", 4);
+    hdr.version = TINDEX_VERSION;
+    hdr.entry_size = sizeof(struct tindex_entry);
+    hdr.pair_bytes = bits == 8 ? 2 : 4;
+    hdr.samp_rate = samp_rate;
+    hdr.scaled = scaled ? 1 : 0;
+    if (fwrite(&hdr, sizeof(hdr), 1, ti->file) != 1) {
+        fclose(ti->file);
+        ti->file = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+void tindex_packet(struct time_index *ti, unsigned int first_sample, int device_samples, int samples,
+                   int gr_changed, int rf_changed, int fs_changed, uint32_t frequency, int gain, int shift) {
+    struct tindex_entry e;
+    struct timespec ts;
+    unsigned int lost = 0;
+    int64_t first_ns;
+    uint32_t flags = 0;
+
+    /* the packet is returned once its last sample is in */
+    clock_gettime(CLOCK_REALTIME, &ts);
+    first_ns = (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec - (int64_t) samples * 1000000000 / ti->samp_rate;
+
+    if (ti->samples == 0 && ti->entries == 0) {
+        flags |= TINDEX_START;
+        ti->device_sample = first_sample;
+    } else {
+        lost = first_sample - ti->last_first;
+        if (fs_changed)
+            lost = 0; /* the API restarts its count */
+        else if (lost)
+            flags |= TINDEX_GAP;
+        ti->device_sample += lost;
+    }
+    if (gr_changed)
+        flags |= TINDEX_GAIN;
+    if (rf_changed)
+        flags |= TINDEX_FREQUENCY;
+    if (fs_changed)
+        flags |= TINDEX_SAMPLE_RATE;
+    if (shift != ti->shift)
+        flags |= TINDEX_SCALE;
+    ti->shift = shift;
+    if (first_ns - ti->last_ns >= ti->interval_ns)
+        flags |= TINDEX_PERIODIC;
+
+    if (flags && ti->file) {
+        memset(&e, 0, sizeof(e));
+        e.sample = ti->samples;
+        e.device_sample = ti->device_sample;
+        e.time_ns = first_ns;
+        e.lost = lost;
+        e.frequency = frequency;
+        e.gain = gain;
+        e.flags = flags;
+        e.shift = (uint32_t) shift;
+        if (fwrite(&e, sizeof(e), 1, ti->file) != 1 || fflush(ti->file) != 0) {
+            fprintf(stderr, "Failed to write the time index, no more entries.\n");
+            fclose(ti->file);
+            ti->file = NULL;
+        }
+        ti->entries++;
+        ti->last_ns = first_ns;
+    }
+
+    ti->samples += samples;
+    ti->device_sample += device_samples;
+    ti->last_first = first_sample + device_samples;
+}
+
+void tindex_close(struct time_index *ti) {
+    if (ti->file)
+        fclose(ti->file);
+    ti->file = NULL;
+}
+
+int tindex_map(struct tindex_map *m, const char *path) {
+    struct stat st;
+    void *p;
+    int fd;
+
+    memset(m, 0, sizeof(*m));
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(struct tindex_header)) {
+        fprintf(stderr, "Failed to open time index %s\n", path);
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+
+    p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        fprintf(stderr, "Failed to map time index %s\n", path);
+        return -1;
+    }
+
+    m->hdr = p;
+    m->map_size = st.st_size;
+    if (memcmp(m->hdr->magic, "TIDX", 4) != 0 || m->hdr->entry_size != sizeof(struct tindex_entry)) {
+        fprintf(stderr, "%s is not a time index of this version.\n", path);
+        tindex_unmap(m);
+        return -1;
+    }
+    m->entries = (const struct tindex_entry *) (m->hdr + 1);
+    m->count = (st.st_size - sizeof(struct tindex_header)) / sizeof(struct tindex_entry);
+
+    return 0;
+}
+
+uint64_t tindex_find_time(const struct tindex_map *m, int64_t time_ns) {
+    uint64_t lo = 0, hi = m->count;
+
+    while (hi - lo > 1) {
+        uint64_t mid = (lo + hi) / 2;
+        if (m->entries[mid].time_ns <= time_ns)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+uint64_t tindex_sample_at(const struct tindex_map *m, int64_t time_ns) {
+    const struct tindex_entry *e;
+    uint64_t i, sample;
+
+    if (m->count == 0)
+        return 0;
+
+    i = tindex_find_time(m, time_ns);
+    e = &m->entries[i];
+    if (time_ns <= e->time_ns)
+        return e->sample;
+
+    sample = e->sample + (uint64_t) ((double) (time_ns - e->time_ns) * m->hdr->samp_rate / 1e9);
+    /* inside a gap the next recorded sample is the closest one */
+    if (i + 1 < m->count && sample > m->entries[i + 1].sample)
+        sample = m->entries[i + 1].sample;
+
+    return sample;
+}
+
+void tindex_unmap(struct tindex_map *m) {
+    if (m->hdr)
+        munmap((void *) m->hdr, m->map_size);
+    m->hdr = NULL;
+}
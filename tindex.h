@@ -0,0 +1,119 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  tindex: time index written next to a raw recording (<file>.tidx).
+ *
+ *  Fixed size binary entries map wall-clock time to the position in the
+ *  recording. An entry is written at a fixed cadence and for every event
+ *  reported by mir_sdr_ReadPacket: the first packet, lost samples (a jump
+ *  in firstSample) and gain, frequency or sample rate changes. Entries are
+ *  sorted by sample and time, so a reader maps the file and bisects it.
+ *
+ *  File layout, native byte order:
+ *    header   "TIDX", version, entry size, bytes per I/Q pair, samp_rate, scaled, 2 x reserved
+ *    entries  struct tindex_entry, one per line of the index
+ *
+ *  A recording with adaptive 8 bit scaling (play_sdr -q) has scaled set,
+ *  an entry for every change of the shift and the shift in force in every
+ *  entry: the samples from an entry on are the 16 bit ones >> shift.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TINDEX_H
+#define TINDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define TINDEX_VERSION          1
+
+/* why an entry was written, or'ed */
+#define TINDEX_START            0x01
+#define TINDEX_PERIODIC         0x02
+#define TINDEX_GAP              0x04    /* samples were lost right before this entry */
+#define TINDEX_GAIN             0x08    /* grChanged */
+#define TINDEX_FREQUENCY        0x10    /* rfChanged */
+#define TINDEX_SAMPLE_RATE      0x20    /* fsChanged */
+#define TINDEX_SCALE            0x40    /* the shift of a scaled recording changed */
+
+struct tindex_header {
+    char magic[4];
+    uint32_t version;
+    uint32_t entry_size;
+    uint32_t pair_bytes;
+    uint32_t samp_rate;
+    uint32_t scaled;            /* 1: the 8 bit samples were scaled per block, see shift */
+    uint32_t reserved[2];
+};
+
+struct tindex_entry {
+    uint64_t sample;            /* I/Q pair in the recording */
+    uint64_t device_sample;     /* firstSample as counted by the API, unwrapped */
+    int64_t time_ns;            /* wall clock (CLOCK_REALTIME) of that sample */
+    uint64_t lost;              /* samples lost right before it */
+    uint32_t frequency;
+    int32_t gain;
+    uint32_t flags;
+    uint32_t shift;             /* of a scaled recording, 8 (the top byte) otherwise */
+};
+
+struct time_index {
+    FILE *file;
+    int64_t interval_ns;
+    int64_t last_ns;
+    uint32_t samp_rate;
+    uint64_t samples;           /* I/Q pairs written so far */
+    uint64_t device_sample;
+    unsigned int last_first;
+    uint64_t entries;
+    int shift;
+};
+
+/* interval_s: cadence of the periodic entries, scaled: see the header. Returns 0 on success. */
+int tindex_open(struct time_index *ti, const char *path, uint32_t samp_rate, int bits, int scaled,
+                double interval_s);
+
+/*
+ * Call for every packet about to be written, with the values returned by
+ * mir_sdr_ReadPacket. device_samples were read, samples are written (fewer
+ * when the packet was decimated), shift is that of the packet. Writes an
+ * entry when one is due.
+ */
+void tindex_packet(struct time_index *ti, unsigned int first_sample, int device_samples, int samples,
+                   int gr_changed, int rf_changed, int fs_changed, uint32_t frequency, int gain, int shift);
+
+void tindex_close(struct time_index *ti);
+
+/* read side: the index mapped read-only */
+struct tindex_map {
+    const struct tindex_header *hdr;
+    const struct tindex_entry *entries;
+    uint64_t count;
+    size_t map_size;
+};
+
+int tindex_map(struct tindex_map *m, const char *path);
+
+/* last entry at or before time_ns (0 when time_ns is before the first one) */
+uint64_t tindex_find_time(const struct tindex_map *m, int64_t time_ns);
+
+/* I/Q pair recorded at time_ns, interpolated from the nearest entries */
+uint64_t tindex_sample_at(const struct tindex_map *m, int64_t time_ns);
+
+void tindex_unmap(struct tindex_map *m);
+
+#endif
@@ -0,0 +1,272 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+#define TRACE_MASK  (TRACE_EVENTS - 1)
+
+struct trace_event {
+    uint64_t ts, dur;
+    const char *name;
+    int64_t arg;
+    char ph;
+};
+
+struct trace_buf {
+    struct trace_event ev[TRACE_EVENTS];
+    uint32_t head;              /* written by the thread */
+    uint32_t tail;              /* written by the flusher */
+    uint64_t lost;
+    int tid;
+    char name[16];
+    int named;                  /* thread name written to the file */
+    int retired;                /* the thread exited, free once drained */
+};
+
+int trace_on = 0;
+
+static struct trace_buf *slots[TRACE_MAX_THREADS];
+static pthread_mutex_t slots_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t buf_key;
+static __thread struct trace_buf *my_buf;
+static int no_slot;             /* a thread found no free slot, reported once */
+
+static FILE *trace_file;
+static const char *trace_path;
+static uint64_t trace_start, trace_until;
+static uint64_t written, lost;
+static int pid, flusher_stop;
+static pthread_t flusher;
+
+uint64_t trace_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void retire(void *arg) {
+    __atomic_store_n(&((struct trace_buf *) arg)->retired, 1, __ATOMIC_RELEASE);
+}
+
+static struct trace_buf *register_thread(void) {
+    struct trace_buf *b = NULL;
+    int k;
+
+    pthread_mutex_lock(&slots_lock);
+    for (k = 0; k < TRACE_MAX_THREADS && slots[k]; k++);
+    if (k < TRACE_MAX_THREADS)
+        b = calloc(1, sizeof(struct trace_buf));
+    if (b) {
+        b->tid = (int) syscall(SYS_gettid);
+#ifdef __linux__
+        pthread_getname_np(pthread_self(), b->name, sizeof(b->name));
+#endif
+        if (!b->name[0])
+            snprintf(b->name, sizeof(b->name), "thread %d", b->tid);
+        slots[k] = b;
+        pthread_setspecific(buf_key, b);
+    } else if (!no_slot) {
+        no_slot = 1;
+        fprintf(stderr, "trace: more than %d threads, the rest are not traced\n", TRACE_MAX_THREADS);
+    }
+    pthread_mutex_unlock(&slots_lock);
+
+    /* not traced, do not try again on every event */
+    my_buf = b ? b : (struct trace_buf *) -1;
+    return b;
+}
+
+void trace_record(char ph, const char *name, uint64_t ts, uint64_t dur, int64_t arg) {
+    struct trace_buf *b = my_buf;
+    struct trace_event *e;
+    uint32_t h;
+
+    if (!b)
+        b = register_thread();
+    if (!b || b == (struct trace_buf *) -1)
+        return;
+
+    h = b->head;
+    if (h - __atomic_load_n(&b->tail, __ATOMIC_ACQUIRE) == TRACE_EVENTS) {
+        __atomic_add_fetch(&b->lost, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    e = &b->ev[h & TRACE_MASK];
+    e->ph = ph;
+    e->name = name;
+    e->ts = ts;
+    e->dur = dur;
+    e->arg = arg;
+    __atomic_store_n(&b->head, h + 1, __ATOMIC_RELEASE);
+}
+
+static void write_event(const struct trace_buf *b, const struct trace_event *e) {
+    fprintf(trace_file, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f", e->name, e->ph, pid,
+            b->tid, (e->ts - trace_start) / 1e3);
+    if (e->ph == 'X')
+        fprintf(trace_file, ",\"dur\":%.3f", e->dur / 1e3);
+    else
+        fprintf(trace_file, ",\"s\":\"t\"");
+    if (e->arg)
+        fprintf(trace_file, ",\"args\":{\"n\":%lld}", (long long) e->arg);
+    fprintf(trace_file, "}");
+}
+
+static void drain(struct trace_buf *b) {
+    uint32_t t = b->tail, h = __atomic_load_n(&b->head, __ATOMIC_ACQUIRE);
+
+    if (!b->named) {
+        fprintf(trace_file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                pid, b->tid, b->name);
+        b->named = 1;
+    }
+    for (; t != h; t++)
+        write_event(b, &b->ev[t & TRACE_MASK]);
+    written += h - b->tail;
+    __atomic_store_n(&b->tail, t, __ATOMIC_RELEASE);
+}
+
+static void drain_all(void) {
+    struct trace_buf *bufs[TRACE_MAX_THREADS];
+    int k;
+
+    pthread_mutex_lock(&slots_lock);
+    memcpy(bufs, slots, sizeof(bufs));
+    pthread_mutex_unlock(&slots_lock);
+
+    for (k = 0; k < TRACE_MAX_THREADS; k++) {
+        if (!bufs[k])
+            continue;
+        drain(bufs[k]);
+        /* its thread is gone, nothing more will come: give the slot to a new one */
+        if (__atomic_load_n(&bufs[k]->retired, __ATOMIC_ACQUIRE) &&
+            bufs[k]->tail == __atomic_load_n(&bufs[k]->head, __ATOMIC_ACQUIRE)) {
+            pthread_mutex_lock(&slots_lock);
+            slots[k] = NULL;
+            pthread_mutex_unlock(&slots_lock);
+            lost += bufs[k]->lost;
+            free(bufs[k]);
+        }
+    }
+    fflush(trace_file);
+}
+
+static void finish(void) {
+    struct timespec wait = {0, TRACE_FLUSH_MS * 1000000L};
+    int k;
+
+    trace_on = 0;
+    /* events being recorded right now */
+    nanosleep(&wait, NULL);
+    drain_all();
+
+    pthread_mutex_lock(&slots_lock);
+    for (k = 0; k < TRACE_MAX_THREADS; k++) {
+        if (slots[k])
+            lost += __atomic_load_n(&slots[k]->lost, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&slots_lock);
+
+    fprintf(trace_file, "\n]\n");
+    fclose(trace_file);
+    trace_file = NULL;
+    fprintf(stderr, "trace: %llu events written to %s, %llu lost (ring full)\n", (unsigned long long) written,
+            trace_path, (unsigned long long) lost);
+}
+
+static void *flush_worker(void *arg) {
+    struct timespec wait = {0, TRACE_FLUSH_MS * 1000000L};
+
+    (void) arg;
+    while (!__atomic_load_n(&flusher_stop, __ATOMIC_ACQUIRE)) {
+        nanosleep(&wait, NULL);
+        if (trace_until && trace_now() >= trace_until)
+            break;
+        drain_all();
+    }
+    finish();
+
+    return NULL;
+}
+
+int trace_open(const char *spec) {
+    char *path = strdup(spec), *sep = strrchr(path, ':');
+    double seconds = 0;
+
+    if (sep) {
+        *sep = '\0';
+        seconds = atof(sep + 1);
+        if (seconds <= 0) {
+            free(path);
+            return -1;
+        }
+    }
+
+    trace_file = fopen(path, "w");
+    if (!trace_file) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        free(path);
+        return -1;
+    }
+    trace_path = path;
+    pid = (int) getpid();
+    trace_start = trace_now();
+    trace_until = seconds > 0 ? trace_start + (uint64_t) (seconds * 1e9) : 0;
+    pthread_key_create(&buf_key, retire);
+
+    /* the JSON array form, readable even when the process dies before the closing bracket */
+    fprintf(trace_file, "[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"%s\"}}", pid,
+            program_invocation_short_name);
+
+    trace_on = 1;
+    if (pthread_create(&flusher, NULL, flush_worker, NULL) != 0) {
+        trace_on = 0;
+        fclose(trace_file);
+        trace_file = NULL;
+        return -1;
+    }
+    if (seconds > 0)
+        fprintf(stderr, "Tracing to %s for %.0f s\n", path, seconds);
+    else
+        fprintf(stderr, "Tracing to %s\n", path);
+
+    return 0;
+}
+
+void trace_close(void) {
+    if (!trace_path)
+        return;
+    __atomic_store_n(&flusher_stop, 1, __ATOMIC_RELEASE);
+    pthread_join(flusher, NULL);
+    free((char *) trace_path);
+    trace_path = NULL;
+}
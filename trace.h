@@ -0,0 +1,71 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  trace: opt-in timeline of what every thread spends its time on, written
+ *  as Chrome trace JSON (chrome://tracing, ui.perfetto.dev).
+ *
+ *  A thread records into its own ring of events, registered on its first
+ *  event and named after the thread (see rt_apply_thread). Recording is a
+ *  clock read and a few stores, no lock and no system call; when the ring
+ *  is full the event is counted as lost rather than waiting. A background
+ *  thread drains the rings every TRACE_FLUSH_MS and appends them to the
+ *  file. While tracing is off each call is a single load and branch.
+ *
+ *  Event names must be string literals, only the pointer is recorded.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+#define TRACE_EVENTS        16384   /* per thread ring, a power of two */
+#define TRACE_MAX_THREADS   128
+#define TRACE_FLUSH_MS      100
+
+extern int trace_on;
+
+/* "file.json" or "file.json:seconds" to stop after that long. Returns 0 on success. */
+int trace_open(const char *spec);
+
+/* stops recording, writes what is left and closes the file */
+void trace_close(void);
+
+uint64_t trace_now(void);
+
+void trace_record(char ph, const char *name, uint64_t ts, uint64_t dur, int64_t arg);
+
+/* start of a span, 0 while tracing is off */
+static inline uint64_t trace_begin(void) {
+    return trace_on ? trace_now() : 0;
+}
+
+/* a span from begin to now; arg, e.g. a byte count, is shown unless 0 */
+static inline void trace_end(const char *name, uint64_t begin, int64_t arg) {
+    if (begin && trace_on) {
+        uint64_t now = trace_now();
+        trace_record('X', name, begin, now - begin, arg);
+    }
+}
+
+/* a point in time: a retune, a drop */
+static inline void trace_instant(const char *name, int64_t arg) {
+    if (trace_on)
+        trace_record('i', name, trace_now(), 0, arg);
+}
+
+#endif
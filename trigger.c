@@ -0,0 +1,145 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "iqdsp.h"
+#include "rt.h"
+#include "trigger.h"
+
+static int ms_to_packets(int ms, uint32_t samp_rate, int samples_per_packet) {
+    uint64_t samples = (uint64_t) ms * samp_rate / 1000;
+
+    return (int) ((samples + samples_per_packet - 1) / samples_per_packet);
+}
+
+int trigger_init(struct trigger *t, double threshold_dbfs, double hysteresis_db,
+                 int preroll_ms, int postroll_ms, uint32_t samp_rate,
+                 int samples_per_packet, size_t slot_size,
+                 const char *index_path, trigger_write_fn write, void *write_ctx) {
+    memset(t, 0, sizeof(*t));
+
+    t->on_power = iq_dbfs_to_power(threshold_dbfs);
+    t->off_power = iq_dbfs_to_power(threshold_dbfs - hysteresis_db);
+    t->preroll = ms_to_packets(preroll_ms, samp_rate, samples_per_packet);
+    t->postroll = ms_to_packets(postroll_ms, samp_rate, samples_per_packet);
+    t->samples_per_packet = samples_per_packet;
+    t->slot_size = slot_size;
+    t->write = write;
+    t->write_ctx = write_ctx;
+
+    if (t->preroll > 0) {
+        t->ring = rt_alloc(t->preroll * slot_size);
+        if (!t->ring) {
+            fprintf(stderr, "Failed to allocate pre-roll buffer.\n");
+            return -1;
+        }
+    }
+
+    if (index_path) {
+        t->index = fopen(index_path, "w");
+        if (!t->index) {
+            fprintf(stderr, "Failed to open segment index %s\n", index_path);
+            rt_free(t->ring, t->preroll * t->slot_size);
+            t->ring = NULL;
+            return -1;
+        }
+        fprintf(t->index, "# play_sdr segment index, samp_rate %u, threshold %.1f dBFS, hysteresis %.1f dB\n"
+                        "# start_sample num_samples file_offset\n",
+                samp_rate, threshold_dbfs, hysteresis_db);
+    }
+
+    return 0;
+}
+
+static int trigger_emit(struct trigger *t, const void *packet) {
+    if (t->write(t->write_ctx, packet, t->slot_size) != 0)
+        return -1;
+
+    t->bytes_written += t->slot_size;
+    t->seg_samples += t->samples_per_packet;
+    t->samples_written += t->samples_per_packet;
+    return 0;
+}
+
+static void trigger_end_segment(struct trigger *t) {
+    if (t->index) {
+        fprintf(t->index, "%" PRIu64 " %" PRIu64 " %" PRIu64 "\n", t->seg_start, t->seg_samples, t->seg_offset);
+        fflush(t->index);
+    }
+    t->active = 0;
+    t->segments++;
+}
+
+int trigger_feed(struct trigger *t, double power, const void *packet) {
+    int i;
+
+    if (!t->active) {
+        if (power < t->on_power) {
+            if (t->preroll > 0) {
+                memcpy(t->ring + (size_t) t->ring_head * t->slot_size, packet, t->slot_size);
+                t->ring_head = (t->ring_head + 1) % t->preroll;
+                if (t->ring_count < t->preroll)
+                    t->ring_count++;
+            }
+            t->samples_seen += t->samples_per_packet;
+            return 0;
+        }
+
+        /* open a segment, oldest pre-roll packet first */
+        t->active = 1;
+        t->seg_offset = t->bytes_written;
+        t->seg_samples = 0;
+        t->seg_start = t->samples_seen - (uint64_t) t->ring_count * t->samples_per_packet;
+
+        for (i = t->ring_count; i > 0; i--) {
+            int slot = (t->ring_head - i + t->preroll) % t->preroll;
+            if (trigger_emit(t, t->ring + (size_t) slot * t->slot_size) != 0)
+                return -1;
+        }
+        t->ring_count = 0;
+        t->hold = t->postroll;
+    } else if (power >= t->off_power) {
+        t->hold = t->postroll;
+    } else if (t->hold-- <= 0) {
+        trigger_end_segment(t);
+        return trigger_feed(t, power, packet);
+    }
+
+    t->samples_seen += t->samples_per_packet;
+    return trigger_emit(t, packet);
+}
+
+void trigger_close(struct trigger *t, int verbose) {
+    if (t->active)
+        trigger_end_segment(t);
+
+    if (verbose == 1) {
+        fprintf(stderr, "[DEBUG] trigger: %u segments, %" PRIu64 " of %" PRIu64 " samples written (%.1f%%)\n",
+                t->segments, t->samples_written, t->samples_seen,
+                t->samples_seen ? 100.0 * t->samples_written / t->samples_seen : 0.0);
+    }
+
+    if (t->index)
+        fclose(t->index);
+    rt_free(t->ring, t->preroll * t->slot_size);
+    t->index = NULL;
+    t->ring = NULL;
+}
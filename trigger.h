@@ -0,0 +1,79 @@
+/*
+ *  SDRPlayPorts
+ *  Ports of some parts of rtl-sdr for the SDRPlay (original: git://git.osmocom.org/rtl-sdr.git /)
+ *
+ *  trigger: energy triggered segment recording. Packets are only passed
+ *  to the writer while the band is active, with pre-roll, post-roll and
+ *  hysteresis, and every written segment is logged to an index file.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRIGGER_H
+#define TRIGGER_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* returns 0 when all len bytes were written */
+typedef int (*trigger_write_fn)(void *ctx, const void *buf, size_t len);
+
+struct trigger {
+    double on_power;        /* segment opens at or above this block power */
+    double off_power;       /* ... and closes after post-roll below this one */
+
+    int preroll;            /* in packets */
+    int postroll;           /* in packets */
+    int hold;               /* packets of post-roll left */
+    int active;
+
+    size_t slot_size;       /* bytes of one converted packet */
+    int samples_per_packet;
+    uint8_t *ring;          /* pre-roll, preroll slots */
+    int ring_head;
+    int ring_count;
+
+    uint64_t seg_start;     /* first sample of the open segment */
+    uint64_t seg_samples;
+    uint64_t seg_offset;    /* byte offset of the open segment in the output */
+    uint64_t bytes_written;
+    uint64_t samples_seen;
+    uint64_t samples_written;
+    unsigned int segments;
+
+    FILE *index;
+    trigger_write_fn write;
+    void *write_ctx;
+};
+
+/*
+ * threshold_dbfs / hysteresis_db set the open / close levels, pre and
+ * post roll are given in ms and rounded up to whole packets.
+ * Returns 0 on success.
+ */
+int trigger_init(struct trigger *t, double threshold_dbfs, double hysteresis_db,
+                 int preroll_ms, int postroll_ms, uint32_t samp_rate,
+                 int samples_per_packet, size_t slot_size,
+                 const char *index_path, trigger_write_fn write, void *write_ctx);
+
+/*
+ * Feed one converted packet together with the power of the raw samples
+ * it came from. Returns 0, or -1 when the writer failed.
+ */
+int trigger_feed(struct trigger *t, double power, const void *packet);
+
+/* closes an open segment and the index, prints a summary when verbose */
+void trigger_close(struct trigger *t, int verbose);
+
+#endif